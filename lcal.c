@@ -113,6 +113,14 @@ static char VERSION_STRING[] = "@(#)lcal v2.1.0 - generate full-year Postscript
 #include <unistd.h>
 #endif
 
+/* Headers needed for writing layout variants and running jobs in parallel
+   (cf. '-V', '-J') */
+#ifdef BUILD_ENV_UNIX
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/mman.h>
+#endif
+
 /*
  * Lcal-specific definitions:
  */
@@ -124,6 +132,28 @@ static char VERSION_STRING[] = "@(#)lcal v2.1.0 - generate full-year Postscript
 
    */
 
+/* the options which a job may change (cf. save_options()) */
+typedef struct {
+   int rotate;
+   char dayfont[STRSIZ], titlefont[STRSIZ], outfile[STRSIZ];
+   char x_offset[STRSIZ], y_offset[STRSIZ];
+   int draw_day_of_week_inside_moon;
+   char shading[STRSIZ], time_zone[STRSIZ], variant_list[STRSIZ];
+   char date_range[STRSIZ];
+   int query_mode, mark_eclipses, eclipse_mode, rise_set, moon_sizes;
+   double latitude, longitude;
+   char query_time[STRSIZ], eclipse_years[STRSIZ], phase_engine[STRSIZ];
+   char ephemeris_file[STRSIZ], gen_ephemeris_file[STRSIZ];
+   int reproducible, compressed_singlepage, odd_days_singlepage;
+   int init_month, num_months, async_output;
+} options_str_typ;
+
+/* a calendar being assembled in memory (cf. membuf_sink()) */
+typedef struct {
+   char *data;
+   size_t len, size;
+} membuf_str_typ;
+
 /* ---------------------------------------------------------------------------
 
    Constant Declarations
@@ -151,7 +181,14 @@ char *days[7] = {
    "Sunday", "Monday", "Tuesday", "Wednesday", "Thursday", "Friday", "Saturday"
 };
 
-static int init_year;
+int init_year;
+int init_month = JAN;
+int num_months = NUM_MONTHS;
+static int in_job = FALSE;   /* TRUE while parsing a job line (cf. run_job()) */
+#ifndef LCAL_LIBRARY
+static int phase_grid_used = FALSE;   /* cf. use_phase_grid() */
+static char ephemeris_id[STRSIZ + 48] = "";   /* file used, if any (cf. use_ephemeris()) */
+#endif
 
 char *words[MAXWORD];   /* maximum number of words per date file line */
 char lbuf[LINSIZ];   /* date file source line buffer */
@@ -193,6 +230,33 @@ flag_usage_str_typ flag_tbl[] = {
    
    { F_TIMEZONE, TRUE },
    
+   { F_DATE_RANGE, TRUE },
+   
+   { F_QUERY, TRUE },
+   
+   { F_ECLIPSES, FALSE },
+   { F_LIST_ECLIPSES, TRUE },
+   
+   { F_LOCATION, TRUE },
+   
+   { F_MOON_SIZES, FALSE },
+   
+   { F_VARIANTS, TRUE },
+   
+   { F_ENGINE, TRUE },
+   
+   { F_EPHEMERIS, TRUE },
+   { F_GEN_EPHEMERIS, TRUE },
+   
+   { F_REPRODUCIBLE, FALSE },
+   
+   { F_JOBS, TRUE },
+   { F_WORKERS, TRUE },
+   
+   { F_ASYNC, FALSE },
+   
+   { F_STATS, TRUE },
+   
    { F_COMPR_1PAGE, FALSE },
    
    { F_ODD_DAYS_1PAGE, FALSE },
@@ -232,7 +296,49 @@ flag_msg_str_typ flag_msg[] = {
 	{ ' ',		NULL,		" ",							DEFAULT_SHADING },
 	{ END_GROUP },
 
-	{ F_TIMEZONE,	W_VALUE,	"specify alternate time zone",				TIMEZONE },
+	{ F_TIMEZONE,	W_VALUE,	"specify alternate time zone(s) (hours west of UTC or name)",	TIMEZONE },
+	{ END_GROUP },
+
+	{ F_DATE_RANGE,	W_RANGE,	"specify first{-last} month to print",			NULL },
+	{ GROUP_DEFAULT,									"Jan-Dec of year YY" },
+	{ END_GROUP },
+
+	{ F_QUERY,	W_TIME,		"print moon phase at Unix time (or JD<date>) only",	"now" },
+	{ END_GROUP },
+
+	{ F_ECLIPSES,	NULL,		"mark eclipses of the sun and moon",			NULL },
+	{ F_LIST_ECLIPSES,	W_YEARS,	"list eclipses of given years only",		"months shown" },
+	{ END_GROUP },
+
+	{ F_LOCATION,	W_LOCATION,	"show moonrise/moonset at given place",		"none" },
+	{ END_GROUP },
+
+	{ F_MOON_SIZES,	NULL,		"draw moons to scale, ringing perigee full moons",	NULL },
+	{ END_GROUP },
+
+	{ F_VARIANTS,	W_VARIANTS,	"generate each layout variant (flags " VARIANT_FLAGS ")",	NULL },
+	{ END_GROUP },
+
+	{ F_ENGINE,	W_ENGINE,	"select phase engine (" PHASE_ENGINES ")",		DEFAULT_ENGINE },
+	{ END_GROUP },
+
+	{ F_EPHEMERIS,	W_FILE,		"calculate moon phases from Chebyshev ephemeris file",	NULL },
+	{ F_GEN_EPHEMERIS,	W_FILE,	"generate Chebyshev ephemeris file only",		NULL },
+	{ END_GROUP },
+
+	{ F_REPRODUCIBLE,	NULL,	"generate reproducible output (cached in $" LCAL_CACHE_ENV ")",	NULL },
+	{ END_GROUP },
+
+	{ F_JOBS,	W_FILE,		"run each job (line of flags) in file (or stdin if -)",	NULL },
+	{ END_GROUP },
+
+	{ F_WORKERS,	W_NUMBER,	"specify number of parallel job workers",		"1 per CPU" },
+	{ END_GROUP },
+
+	{ F_ASYNC,	NULL,		"write output files asynchronously (io_uring)",		NULL },
+	{ END_GROUP },
+
+	{ F_STATS,	W_FILE,		"report statistics of the run (as JSON to file, if any)",	"stderr" },
 	{ END_GROUP },
 
 	{ F_COMPR_1PAGE,	NULL,	"compress output to fit on single page",		NULL },
@@ -287,6 +393,45 @@ char shading[STRSIZ] = DEFAULT_SHADING;   /* -s */
 
 char time_zone[STRSIZ] = TIMEZONE;   /* -z */
 
+char *zones[MAX_ZONES];   /* -z (split into list) */
+int num_zones = 0;
+
+char variant_list[STRSIZ] = "";   /* -V */
+char *variants[MAX_VARIANTS];
+int num_variants = 0;
+
+char date_range[STRSIZ] = "";   /* -r */
+
+int query_mode = FALSE;   /* -q */
+char query_time[STRSIZ] = "";
+
+int mark_eclipses = FALSE;   /* -e */
+int eclipse_mode = FALSE;   /* -L */
+char eclipse_years[STRSIZ] = "";
+
+int rise_set = FALSE;   /* -g */
+double latitude = 0.0, longitude = 0.0;
+
+int moon_sizes = FALSE;   /* -m */
+
+char phase_engine[STRSIZ] = DEFAULT_ENGINE;   /* -P */
+
+char ephemeris_file[STRSIZ] = "";   /* -E */
+char gen_ephemeris_file[STRSIZ] = "";   /* -G */
+
+int reproducible = FALSE;   /* -R (or SOURCE_DATE_EPOCH) */
+char *source_date = NULL;
+
+char jobs_file[STRSIZ] = "";   /* -J */
+int num_workers = 0;   /* -j (0 = one per processor) */
+
+int async_output = FALSE;   /* -A */
+#ifndef LCAL_LIBRARY
+static char *async_failed = NULL;   /* set TRUE if a file can't be written */
+#endif
+
+char stats_file[STRSIZ] = "";   /* -T (or LCAL_STATS; "" = stderr) */
+
 int compressed_singlepage = FALSE;   /* -S */
 int odd_days_singlepage = FALSE;   /* -O */
 
@@ -504,9 +649,14 @@ char * set_rgb (char *s)
    
    /* single value is gray scale; assume anything else is [r g b] */
    if (n > 1) {
-      sprintf(buf, "%.3f %.3f %.3f setrgbcolor", val[0], val[1], val[2]);
+      p1 = fmt_fixed(buf, val[0], 3);
+      *p1++ = ' ';
+      p1 = fmt_fixed(p1, val[1], 3);
+      *p1++ = ' ';
+      p1 = fmt_fixed(p1, val[2], 3);
+      strcpy(p1, " setrgbcolor");
    }
-   else sprintf(buf, "%.3f setgray", val[0]);
+   else strcpy(fmt_fixed(buf, val[0], 3), " setgray");
    
    return buf; 
 }
@@ -588,12 +738,14 @@ void define_shading (char *orig_shading, char *new_shading, char *dflt_shading)
 
       This routine returns the weekday (0-6) of mm/dd/yy (mm: 1-12).
 
-      This utility routine was borrowed from 'pcal'.
+      This utility routine was borrowed from 'pcal'.  It now looks up the
+      weekday of the 1st of the month in the table of year descriptors (cf.
+      lcaldate.c).
 
 */
 int calc_weekday (int mm, int dd, int yy)
 {
-   return (yy + (yy-1)/4 - (yy-1)/100 + (yy-1)/400 + OFFSET_OF(mm, yy) + (dd-1)) % 7;
+   return (FIRST_OF(mm, yy) + (dd-1)) % 7;
 }
 
 /* ---------------------------------------------------------------------------
@@ -670,250 +822,144 @@ int loadwords (char **words, char *buf)
 
 /* ---------------------------------------------------------------------------
 
-   The following suite of routines ('julday()', 'kepler()', and
-   'calc_phase()') are used to calculate the phase of the moon for a given
-   month, day, year.  They compute the phase of the moon for noon (UT) on the
-   day requested, the start of the Julian day.
- 
-   Revision history:
- 
- 	1.2	AWR	01/25/00	fix calculation of default year
- 
- 	1.0	AWR	01/26/92	from Pcal v4.4
-
-   -------------------------------------------------------
-
-   Routines to accurately calculate the phase of the moon
- 
-   Originally adapted from "moontool.c" by John Walker, Release 2.0.
- 
-       This routine (calc_phase) and its support routines were adapted from
-       phase.c (v 1.2 88/08/26 22:29:42 jef) in the program "xphoon" (v 1.9
-       88/08/26 22:29:47 jef) by Jef Poskanzer and Craig Leres.  The necessary
-       notice follows...
- 
-       Copyright (C) 1988 by Jef Poskanzer and Craig Leres.
- 
-       Permission to use, copy, modify, and distribute this software and its
-       documentation for any purpose and without fee is hereby granted,
-       provided that the above copyright notice appear in all copies and that
-       both that copyright notice and this permission notice appear in
-       supporting documentation.  This software is provided "as is" without
-       express or implied warranty.
- 
-       These were added to "pcal" by RLD on 19-MAR-1991
- 
-*/
-
-/*  Astronomical constants. */
+   init_names
 
-#define epoch   2444238.5   /* 1980 January 0.0 */
-
-/*  Constants defining the Sun's apparent orbit. */
-
-#define elonge   278.833540   /* ecliptic longitude of the Sun at epoch 1980.0 */
-#define elongp   282.596403   /* ecliptic longitude of the Sun at perigee */
-#define eccent   0.016718   /* eccentricity of Earth's orbit */
-
-/*  Elements of the Moon's orbit, epoch 1980.0. */
+   Notes:
 
-#define mmlong   64.975464   /* moon's mean lonigitude at the epoch */
-#define mmlongp   349.383063   /* mean longitude of the perigee at the
-                                        epoch */
-#define mlnode   151.950429   /* mean longitude of the node at the epoch */
-#define synmonth   29.53058868   /* synodic month (new Moon to new Moon) */
+      This routine sets the program name (for messages) from 'argv0', and
+      the version (for use in PostScript comments) from VERSION_STRING.
 
+*/
+void init_names (char *argv0)
+{
+   char *p, tmp[STRSIZ];
 
-/*  Handy mathematical functions. */
+   /* extract root program name and program path */
+   
+   strcpy(progname, *argv0 ? argv0 : "lcal");
+   
+   if ((p = strrchr(progname, END_PATH)) != NULL) memmove(progname, p + 1, strlen(p + 1) + 1);
+   if ((p = strchr(progname, '.')) != NULL) *p = '\0';
 
-#define sgn(x) (((x) < 0) ? -1 : ((x) > 0 ? 1 : 0))   /* extract sign */
-#ifndef abs
-#define abs(x) ((x) < 0 ? (-(x)) : (x))   /* absolute val */
-#endif
-#define fixangle(a) ((a) - 360.0 * (floor((a) / 360.0)))  /* fix angle */
-#define torad(d) ((d) * (M_PI / 180.0))   /* deg->rad */
-#define todeg(d) ((d) * (180.0 / M_PI))   /* rad->deg */
-#define dsin(x) (sin(torad((x))))   /* sin from deg */
-#define dcos(x) (cos(torad((x))))   /* cos from deg */
-#define FNITG(x) (sgn (x) * floor (abs (x)))
+   /* get version from VERSION_STRING (for use in PostScript comment) */
+   strcpy(tmp, VERSION_STRING + 4);
+   p = strchr(tmp, ' ') + 1;   /* skip program name */
+   *strchr(p, ' ') = '\0';   /* terminate after version */
+   strcpy(version, p);
+   return;
+}
 
 /* ---------------------------------------------------------------------------
 
-   julday
+   calc_phase_table
 
    Notes:
 
-      This routine calculates the julian date from input month, day, year
-
-      N.B. - The Julian date is computed for noon UT.
+      This routine fills in the table of moon phases for 'nmonths'
+      consecutive months, beginning with 'month'/'year'.
 
-      This utility routine was borrowed from 'pcal'.
+      Only the days which actually appear on the calendar are computed; the
+      remaining slots (e.g. February 30) are set to -1.
 
-      Adopted from Peter Duffett-Smith's book `Astronomy With Your Personal
-      Computer' by Rick Dyson 18-MAR-1991
+      With '-m', the moon's distance on each day is filled in as well, in
+      the same evaluation as the phase (cf. calc_phase_dist()).
 
 */
-static double julday (int month, int day, int year)
+void calc_phase_table (phase_table_str_typ *tbl, int month, int year, int nmonths)
 {
-   int mn1, yr1;
-   double a, b, c, d, djd;
-   
-   mn1 = month;
-   yr1 = year;
-   if ( yr1 < 0 ) yr1 = yr1 + 1;
-   if ( month < 3 ) {
-      mn1 = month + 12;
-      yr1 = yr1 - 1;
-   }
-   if (( year < 1582 ) ||
-       ( year == 1582  && month < 10 ) ||
-       ( year == 1582  && month == 10 && day < 15.0 )) {
-      b = 0;
-   }
-   else {
-      a = floor (yr1 / 100.0);
-      b = 2 - a + floor (a / 4);
-   }
-   if ( yr1 >= 0 ) c = floor (365.25 * yr1) - 694025;
-   else c = FNITG ((365.25 * yr1) - 0.75) - 694025;
+   cal_month_str_typ *pm;
+   int i, day;
+
+   tbl->nmonths = nmonths;
+
+   for (i = 0; i < nmonths; i++) {
+      pm = &tbl->month[i];
+      pm->month = month;
+      pm->year = year;
+      pm->startday = FIRST_OF(month, year);
+      pm->length = LENGTH_OF(month, year);
+
+      for (day = 1; day <= 31; day++) {
+         tbl->dist[day-1][i] = -1.0;
+         tbl->phase[day-1][i] = day <= pm->length ?
+            calc_phase_dist(month, day, year, moon_sizes ? &tbl->dist[day-1][i] : NULL) : -1.0;
+      }
 
-   d = floor (30.6001 * (mn1 + 1));
-   djd = b + c + d + day + 2415020.0;
-   return djd;
+      if (++month > DEC) {
+         month = JAN;
+         year++;
+      }
+   }
+   return;
 }
 
 /* ---------------------------------------------------------------------------
 
-   kepler
+   day_phase
 
    Notes:
 
-      This routine solves the equation of Kepler.
-
-      This utility routine was borrowed from 'pcal'.
+      This routine returns the phase of the moon on 'day' of the 'i'th month
+      of 'tbl', where 'day' may also be the last day of the previous month
+      (0) or the first of the next (its length + 1) -- from 'tbl' if it has
+      that month, or else as calculated.
 
 */
-static double kepler (double m, double ecc)
+static double day_phase (phase_table_str_typ *tbl, int i, int day)
 {
-   double e, delta;
-#define EPSILON 1E-6
-   
-   e = m = torad(m);
-   do {
-      delta = e - ecc * sin(e) - m;
-      e -= delta / (1 - ecc * cos(e));
-   } while (abs(delta) > EPSILON);
-   return e;
+   cal_month_str_typ *pm = &tbl->month[i];
+   int month = pm->month, year = pm->year;
+
+   if (day < 1) {
+      if (i > 0) return tbl->phase[tbl->month[i-1].length - 1][i-1];
+      if (--month < JAN) {
+         month = DEC;
+         year--;
+      }
+      return year < MIN_YR ? tbl->phase[0][i] : calc_phase(month, LENGTH_OF(month, year), year);
+   }
+   if (day > pm->length) {
+      if (i < tbl->nmonths - 1) return tbl->phase[0][i+1];
+      if (++month > DEC) {
+         month = JAN;
+         year++;
+      }
+      return year > MAX_YR ? tbl->phase[pm->length - 1][i] : calc_phase(month, 1, year);
+   }
+   return tbl->phase[day-1][i];
 }
 
 /* ---------------------------------------------------------------------------
 
-   calc_phase
+   calc_supermoons
 
    Notes:
 
-      This routine calculates the phase of moon as a fraction.
+      This routine fills in 'super' (as the phases in 'tbl', by day and
+      month) with 1 on the day of each full moon nearer than SUPERMOON_DIST
+      (cf. '-m'), and 0 on every other day.
 
-      This utility routine was borrowed from 'pcal'.
+      The full moon falls on the day whose phase at midnight, estimated as
+      the mean of the phases at noon either side, passes 0.5 during it.
 
-      The argument is the time for which the phase is requested, expressed as
-      the month, day, and year.  It returns the phase of the moon (0.0 ->
-      0.99) with the ordering as New Moon, First Quarter, Full Moon, and Last
-      Quarter.
-      
-      Converted from the subroutine phase.c used by "xphoon.c" (see above
-      disclaimer) into calc_phase() for use in "moonphas.c" by Rick Dyson
-      18-MAR-1991
-      
 */
-double calc_phase (int month, int inday, int year)
+static void calc_supermoons (phase_table_str_typ *tbl, char super[31][MAX_MONTHS])
 {
-   double Day, N, M, Ec, Lambdasun, ml, MM;
-   double Ev, Ae, A3, MmP, mEc, A4, lP, V, lPP, MoonAge, pdate, moon_phase;
-   static int first = TRUE;
-   static double utc_offset_days;
-   
-   /* Get the UTC offset on the first pass. 
-
-      The original code used to normalize the UTC offset to +/- 12 hours.  But
-      it was bug-ridden and also failed to take into account that some parts
-      of the world have offsets from UTC greater than 12 hours!  Therefore,
-      beginning with v2.0.0, we don't attempt to normalize the user-specified
-      UTC timezone offset at all.
-   */
-   if (first) {
+   double phase;
+   int i, day;
 
-      utc_offset_days = atof(time_zone) / 24.0;
+   memset(super, 0, 31 * MAX_MONTHS);
 
-      /* fprintf(stderr, "time_zone='%s'  utc_offset_days = %.5lf\n", time_zone, utc_offset_days); */
+   for (i = 0; i < tbl->nmonths; i++) {
+      for (day = 1; day <= tbl->month[i].length; day++) {
+         phase = tbl->phase[day-1][i];
+         if (phase < 0.4 || phase > 0.6 || tbl->dist[day-1][i] >= SUPERMOON_DIST) continue;
 
-      first = FALSE;
+         if ((day_phase(tbl, i, day - 1) + phase) / 2 < 0.5 &&
+             (phase + day_phase(tbl, i, day + 1)) / 2 >= 0.5) super[day-1][i] = 1;
+      }
    }
-
-   /*  need to convert month, day, year into a Julian pdate */
-   pdate = julday(month, inday, year) + utc_offset_days;
-   
-   /*  Calculation of the Sun's position. */
-
-   Day = pdate - epoch;   /* date within epoch */
-   N = fixangle((360 / 365.2422) * Day);   /* mean anomaly of the Sun */
-   M = fixangle(N + elonge - elongp);      /* convert from perigee
-                                              co-ordinates to epoch 1980.0 */
-   Ec = kepler(M, eccent);   /* solve equation of Kepler */
-   Ec = sqrt((1 + eccent) / (1 - eccent)) * tan(Ec / 2);
-   Ec = 2 * todeg(atan(Ec));   /* true anomaly */
-   Lambdasun = fixangle(Ec + elongp);   /* Sun's geocentric ecliptic longitude */
-
-   /*  Calculation of the Moon's position. */
-   
-   /*  Moon's mean longitude. */
-   ml = fixangle(13.1763966 * Day + mmlong);
-   
-   /*  Moon's mean anomaly. */
-   MM = fixangle(ml - 0.1114041 * Day - mmlongp);
-   
-   /*  Moon's ascending node mean longitude. */
-   /*  Not used -- commented out. */
-   /* MN = fixangle(mlnode - 0.0529539 * Day); */
-   
-   /*  Evection. */
-   Ev = 1.2739 * sin(torad(2 * (ml - Lambdasun) - MM));
-   
-   /*  Annual equation. */
-   Ae = 0.1858 * sin(torad(M));
-   
-   /*  Correction term. */
-   A3 = 0.37 * sin(torad(M));
-   
-   /*  Corrected anomaly. */
-   MmP = MM + Ev - Ae - A3;
-   
-   /*  Correction for the equation of the centre. */
-   mEc = 6.2886 * sin(torad(MmP));
-   
-   /*  Another correction term. */
-   A4 = 0.214 * sin(torad(2 * MmP));
-   
-   /*  Corrected longitude. */
-   lP = ml + Ev + mEc - Ae + A4;
-   
-   /*  Variation. */
-   V = 0.6583 * sin(torad(2 * (lP - Lambdasun)));
-   
-   /*  True longitude. */
-   lPP = lP + V;
-   
-   /*  Calculation of the phase of the Moon. */
-   
-   /*  Age of the Moon in degrees. */
-   MoonAge = lPP - Lambdasun;
-
-   moon_phase = fixangle(MoonAge) / 360.0;
-   if (moon_phase < 0.0) moon_phase += 1.0;
-
-   /* fprintf(stderr, "Moon phase on %04d-%02d-%02d: %.5lf\n", year, month, inday, moon_phase); */
-
-   return (moon_phase);
+   return;
 }
 
 /* ---------------------------------------------------------------------------
@@ -922,9 +968,11 @@ double calc_phase (int month, int inday, int year)
 
    Notes:
 
-      This routine writes the PostScript code to 'stdout'.
+      This routine writes the PostScript code to 'stdout' (or to the sink
+      set by 'set_ps_sink()', cf. lcalfmt.c).
 
-      The parameter is the year for which the calendar should be generated.
+      The parameter is the table of moon phases (and the months they belong
+      to) for which the calendar should be generated.
 
       The actual output of the PostScript code is straightforward.  This
       routine writes a PostScript header followed by declarations of all the
@@ -933,115 +981,151 @@ double calc_phase (int month, int inday, int year)
       finally prints the moon phase information for the year.
 
 */
-void write_psfile (int year)
+void write_psfile (phase_table_str_typ *tbl)
 {
-   int month, day, fudge1, fudge2;
+   int i, day, fudge1, fudge2, nmonths = tbl->nmonths;
+   int first_year = tbl->month[0].year, last_year = tbl->month[nmonths-1].year;
    double phase;
-   char *off, *p, *p2, *p3, *p4, tmp[STRSIZ];
+   char *off, *p, *p2, *p3, *p4, tmp[STRSIZ], title[STRSIZ], line[LINSIZ];
    static char *cond[2] = {"false", "true"};
-   char time_str[50];
+   char time_str[50], eclipses[31][MAX_MONTHS];
+   short rise[31][MAX_MONTHS], set[31][MAX_MONTHS];
+   char supermoons[31][MAX_MONTHS];
    time_t curr_tyme;
+   struct tm *p_tm;
+   double t0;
 
 #if defined (BUILD_ENV_UNIX) || defined (BUILD_ENV_DJGPP)
    struct passwd *pw;
 #endif
 
+   /* The title is the year, or the first and last years if the range of
+      months spans a year boundary (e.g. "2026-27") */
+   t0 = STATS_CLOCK();
+   if (first_year == last_year) sprintf(title, "%d", first_year);
+   else sprintf(title, "%d-%02d", first_year, last_year % 100);
+
    /*
     * Write out PostScript prolog
     */
    
    /* comment block at top */
    
-   printf("%%!%s\n", PS_RELEASE);   /* PostScript release */
+   ps_printf("%%!%s\n", PS_RELEASE);   /* PostScript release */
    
    /* Get the current date/time so that we can write it into the output file
-      as a timestamp...  */
-   time(&curr_tyme);
+      as a timestamp...  In reproducible mode, use the (UTC) time given by
+      SOURCE_DATE_EPOCH instead, or omit the timestamp if there is none. */
+   if (!reproducible) {
+      time(&curr_tyme);
+      p_tm = localtime(&curr_tyme);
+   }
+   else if (source_date) {
+      curr_tyme = (time_t) atol(source_date);
+      p_tm = gmtime(&curr_tyme);
+   }
+   else p_tm = NULL;
 
    /* It seems that neither MS-DOS (Borland C) nor DOS+DJGPP support the '%P'
       (lowercase 'am'/'pm') specifier, so we'll use '%p' (uppercase 'AM'/'PM')
       instead. */
+   if (p_tm) {
 #if defined (BUILD_ENV_MSDOS) || defined (BUILD_ENV_DJGPP)
-   strftime(time_str, sizeof(time_str), "%d %b %Y (%a) %I:%M:%S%p", localtime(&curr_tyme));
+      strftime(time_str, sizeof(time_str), "%d %b %Y (%a) %I:%M:%S%p", p_tm);
 #else
-   strftime(time_str, sizeof(time_str), "%d %b %Y (%a) %I:%M:%S%P", localtime(&curr_tyme));
+      strftime(time_str, sizeof(time_str), "%d %b %Y (%a) %I:%M:%S%P", p_tm);
 #endif
+      ps_printf("%%%%CreationDate: %s\n", time_str);
+   }
    
-   printf("%%%%CreationDate: %s\n", time_str);
-   
-   printf("%%%%Creator: Generated by %s %s (%s)\n", progname, version, LCAL_WEBSITE);
+   ps_printf("%%%%Creator: Generated by %s %s (%s)\n", progname, version, LCAL_WEBSITE);
 
-   /* Generate "For" and "Routing" comments if user name is known... */
+   /* Generate "For" and "Routing" comments if user name is known (except
+      in reproducible mode, where it would make the output depend on the
+      user and cost a passwd lookup)... */
 
 #if defined (BUILD_ENV_UNIX) || defined (BUILD_ENV_DJGPP)
-   if ((pw = getpwuid(getuid())) != NULL && strcmp(pw->pw_name, "nobody" /* anonymous account */) != 0) {
-      printf("%%%%For: %s\n", pw->pw_name);
+   STATS_ADD(STAGE_PROLOG, t0);
+   t0 = STATS_CLOCK();
+   pw = reproducible ? NULL : getpwuid(getuid());
+   STATS_ADD(STAGE_GETPWUID, t0);
+   t0 = STATS_CLOCK();
+   if (pw != NULL && strcmp(pw->pw_name, "nobody" /* anonymous account */) != 0) {
+      ps_printf("%%%%For: %s\n", pw->pw_name);
 #ifdef BUILD_ENV_UNIX
       /* The 'pw->pw_gecos' element ('real' user name) is not available in
          MS-DOS or DOS+DJGPP build environments... */
       strcpy(tmp, pw->pw_gecos);
       if ((p = strchr(tmp, ',')) != NULL) *p = '\0';
-      printf("%%%%Routing: %s\n", tmp);
+      ps_printf("%%%%Routing: %s\n", tmp);
 #endif
    }
 #endif
 
    /* Miscellaneous other identification */
    
-   printf("%%%%Title: Lunar phase calendar for %d\n", init_year);
-   printf("%%%%Pages: %d\n", (compressed_singlepage || odd_days_singlepage) ? 1 : 2);
-   printf("%%%%PageOrder: Ascend\n");
-   printf("%%%%Orientation: %s\n", rotate == LANDSCAPE ? "Landscape" : "Portrait");
-   printf("%%%%BoundingBox: 0 0 612 792\n");
-   printf("%%%%ProofMode: NotifyMe\n");
-   printf("%%%%EndComments\n");
+   if (tbl->month[0].month == JAN && nmonths == NUM_MONTHS) {
+      ps_printf("%%%%Title: Lunar phase calendar for %d\n", first_year);
+   }
+   else {
+      ps_printf("%%%%Title: Lunar phase calendar for %s %d - %s %d\n",
+                months[tbl->month[0].month-JAN], first_year,
+                months[tbl->month[nmonths-1].month-JAN], last_year);
+   }
+   ps_printf("%%%%Pages: %d\n", (compressed_singlepage || odd_days_singlepage) ? 1 : 2);
+   ps_printf("%%%%PageOrder: Ascend\n");
+   ps_printf("%%%%Orientation: %s\n", rotate == LANDSCAPE ? "Landscape" : "Portrait");
+   ps_printf("%%%%BoundingBox: 0 0 612 792\n");
+   ps_printf("%%%%ProofMode: NotifyMe\n");
+   ps_printf("%%%%EndComments\n");
    
    /* advertisement for original inspiration */
    
-   printf("%%\n");
-   printf("%% Lcal was inspired by \"Moonlight 1996\", a 16\" x 36\" full-color (silver\n");
-   printf("%% moons against a midnight blue background) lunar phase calendar marketed\n");
-   printf("%% by Celestial Products, Inc., P.O. Box 801, Middleburg VA  22117.  Send\n");
-   printf("%% for their catalog to see (and, hopefully, order) this as well as some\n");
-   printf("%% even more amazing stuff - particularly \"21st Century Luna\", a lunar\n");
-   printf("%% phase calendar for *every day* of the upcoming century.\n");
-   printf("%%\n");
-   printf("%% Or visit Celestial Products' site:\n");
-   printf("%%\n");
-   printf("%%   http://www.celestialproducts.com\n");
-   printf("%%\n\n");
+   ps_printf("%%\n");
+   ps_printf("%% Lcal was inspired by \"Moonlight 1996\", a 16\" x 36\" full-color (silver\n");
+   ps_printf("%% moons against a midnight blue background) lunar phase calendar marketed\n");
+   ps_printf("%% by Celestial Products, Inc., P.O. Box 801, Middleburg VA  22117.  Send\n");
+   ps_printf("%% for their catalog to see (and, hopefully, order) this as well as some\n");
+   ps_printf("%% even more amazing stuff - particularly \"21st Century Luna\", a lunar\n");
+   ps_printf("%% phase calendar for *every day* of the upcoming century.\n");
+   ps_printf("%%\n");
+   ps_printf("%% Or visit Celestial Products' site:\n");
+   ps_printf("%%\n");
+   ps_printf("%%   http://www.celestialproducts.com\n");
+   ps_printf("%%\n\n");
 
    /* font names and sizes */
    
-   printf("/titlefont /%s def\n/dayfont /%s def\n", titlefont, dayfont);
+   ps_printf("/titlefont /%s def\n/dayfont /%s def\n", titlefont, dayfont);
    
-   printf("/titlefontsize %d def\n", 
-          odd_days_singlepage ? TITLEFONTSIZE_ODD_DAYS : TITLEFONTSIZE_NORMAL);
+   ps_printf("/titlefontsize %d def\n", 
+             odd_days_singlepage ? TITLEFONTSIZE_ODD_DAYS : TITLEFONTSIZE_NORMAL);
 
-   printf("/datefontsize  %d def\n", compressed_singlepage ? DATEFONTSIZE_S : DATEFONTSIZE);
-   printf("/monthfontsize %d def\n", compressed_singlepage ? MONTHFONTSIZE_S : MONTHFONTSIZE);
-   printf("/weekdayfontsize     %d def\n", WKDFONTSIZE);
-   printf("/sm_weekdayfontsize  %d def\n", compressed_singlepage ? SMWKDFONTSIZE_S : SMWKDFONTSIZE);
+   ps_printf("/datefontsize  %d def\n", compressed_singlepage ? DATEFONTSIZE_S : DATEFONTSIZE);
+   ps_printf("/monthfontsize %d def\n", compressed_singlepage ? MONTHFONTSIZE_S : MONTHFONTSIZE);
+   ps_printf("/weekdayfontsize     %d def\n", WKDFONTSIZE);
+   ps_printf("/sm_weekdayfontsize  %d def\n", compressed_singlepage ? SMWKDFONTSIZE_S : SMWKDFONTSIZE);
+   if (rise_set) ps_printf("/timefontsize  %d def\n", TIMEFONTSIZE);
 
    /* month names */
    
-   printf("/month_names [");
-   for (month = JAN; month <= DEC; month++) {
-      printf(" (%-3.3s)", months[month-JAN]);
+   ps_printf("/month_names [");
+   for (i = 0; i < nmonths; i++) {
+      ps_printf(" (%-3.3s)", months[tbl->month[i].month-JAN]);
    }
-   printf(" ] def\n");
+   ps_printf(" ] def\n");
    
    /* day names - abbreviate if printing entire year on page */
    
-   printf("/day_names [");
+   ps_printf("/day_names [");
    for (day = SUN; day <= SAT; day++) {
-      printf(" (%-2.2s)", days[day-SUN]);
+      ps_printf(" (%-2.2s)", days[day-SUN]);
    }
-   printf(" ] def\n");
+   ps_printf(" ] def\n");
    
    /* weekday flag */
 
-   printf("/inmoon_labels %s def\n", cond[draw_day_of_week_inside_moon]);
+   ps_printf("/inmoon_labels %s def\n", cond[draw_day_of_week_inside_moon]);
    
    /* fudge factors for X origin (landscape), Y origin (portrait) -
     * theoretically unnecessary, but useful if your printer isn't aligned
@@ -1050,13 +1134,13 @@ void write_psfile (int year)
    off = rotate == LANDSCAPE ? x_offset : y_offset;
    fudge1 = atoi(off);
    fudge2 = (p = strchr(off, '/')) ? atoi(++p) : fudge1;
-   printf("/fudge1 %d def\n", compressed_singlepage ? 0 : fudge1);
-   printf("/fudge2 %d def\n", compressed_singlepage ? 0 : fudge2);
+   ps_printf("/fudge1 %d def\n", compressed_singlepage ? 0 : fudge1);
+   ps_printf("/fudge2 %d def\n", compressed_singlepage ? 0 : fudge2);
    
    /* misc. constants */
-   printf("/xsval %.1f def\n", compressed_singlepage ? HALF_SIZE : FULL_SIZE);
-   printf("/ysval %.1f def\n", compressed_singlepage ? HALF_SIZE : FULL_SIZE);
-   printf("/pagebreak %d def\n", compressed_singlepage ? PAGEBREAK_S : PAGEBREAK);
+   ps_printf("/xsval %.1f def\n", compressed_singlepage ? HALF_SIZE : FULL_SIZE);
+   ps_printf("/ysval %.1f def\n", compressed_singlepage ? HALF_SIZE : FULL_SIZE);
+   ps_printf("/pagebreak %d def\n", compressed_singlepage ? PAGEBREAK_S : PAGEBREAK);
    
    /* background and foreground colors */
    
@@ -1064,16 +1148,16 @@ void write_psfile (int year)
    *(p2 = strchr(tmp, '/')) = '\0'; p2++;
    *(p3 = strchr(p2, '/')) = '\0'; p3++;
    *(p4 = strchr(p3, '/')) = '\0'; p4++;
-   printf("/setforeground { %s } def\n", set_rgb(tmp));
-   printf("/setbackground { %s } def\n", set_rgb(p2));
-   printf("/setmoondark { %s } def\n", set_rgb(p3));
-   printf("/setmoonlight { %s } def\n", set_rgb(p4));
+   ps_printf("/setforeground { %s } def\n", set_rgb(tmp));
+   ps_printf("/setbackground { %s } def\n", set_rgb(p2));
+   ps_printf("/setmoondark { %s } def\n", set_rgb(p3));
+   ps_printf("/setmoonlight { %s } def\n", set_rgb(p4));
 
    /* disable duplex mode (if supported) */
    
-   printf("statusdict (duplexmode) known {\n");
-   printf("statusdict begin false setduplexmode end\n");
-   printf("} if\n");
+   ps_printf("statusdict (duplexmode) known {\n");
+   ps_printf("statusdict begin false setduplexmode end\n");
+   ps_printf("} if\n");
    
    /* PostScript boilerplate */
 
@@ -1111,66 +1195,67 @@ void write_psfile (int year)
     * 
     */
 
-   printf("\n");
-   printf("/width 43 def\n");
-   printf("/height 43 def\n");
-   printf("/negwidth width neg def\n");
-   printf("/negheight height neg def\n");
-   printf("/halfwidth width 2 div def\n");
-   printf("/halfheight height 2 div def\n");
-   printf("/neghalfwidth halfwidth neg def\n");
-   printf("/neghalfheight halfheight neg def\n");
+   ps_printf("\n");
+   ps_printf("/width 43 def\n");
+   ps_printf("/height 43 def\n");
+   ps_printf("/negwidth width neg def\n");
+   ps_printf("/negheight height neg def\n");
+   ps_printf("/halfwidth width 2 div def\n");
+   ps_printf("/halfheight height 2 div def\n");
+   ps_printf("/neghalfwidth halfwidth neg def\n");
+   ps_printf("/neghalfheight halfheight neg def\n");
    
-   printf("/%s 612 def\n", 
-          rotate == PORTRAIT ? "pagewidth" : "pageheight");
+   ps_printf("/%s 612 def\n", 
+             rotate == PORTRAIT ? "pagewidth" : "pageheight");
 
-   printf("/%s 792 %s div dup 1584 gt { pop 1584 } if def\n", 
-          rotate == PORTRAIT ? "pageheight" : "pagewidth",
-          rotate == PORTRAIT ? "ysval" : "xsval");
+   ps_printf("/%s 792 %s div dup 1584 gt { pop 1584 } if def\n", 
+             rotate == PORTRAIT ? "pageheight" : "pagewidth",
+             rotate == PORTRAIT ? "ysval" : "xsval");
    
    
-   printf("/margin %s 12 mul sub 2 div def\n",
-          rotate == PORTRAIT ? "pagewidth width" : "pageheight height");
+   ps_printf("/margin %s %d mul sub 2 div def\n",
+             rotate == PORTRAIT ? "pagewidth width" : "pageheight height", nmonths);
    
-   printf("/%s pagebreak ",
-          rotate == PORTRAIT ? "topmargin pageheight height" : "leftmargin pagewidth width");
+   ps_printf("/%s pagebreak ",
+             rotate == PORTRAIT ? "topmargin pageheight height" : "leftmargin pagewidth width");
    /* Move the left margin to the left (for landscape) and the top margin up
       (for portrait) whenever we're doing odd-days-only, 1-page output... */
-   printf("%s ",
-          odd_days_singlepage ? "1.7 add" : "");
-   printf("mul sub def\n");
-   
-   printf("/Xnext %s def\n",
-          rotate == PORTRAIT ? "width" : "0");
-   
-   printf("/Ynext %s def\n",
-          rotate == PORTRAIT ? "0" : "negheight");
-   
-   printf("/rval %s def\n",
-          rotate == PORTRAIT ? "0" : "90");
-   
-   printf("/halfperiod 0.5 def\n");
-   printf("/quartperiod 0.25 def\n");
-   printf("/radius 15 def\n");
-   printf("/rect radius 2 sqrt mul quartperiod div def\n");
-   printf("\n");
-   printf("/center {\n");
-   printf("  /wid exch def\n");
-   printf("  /str exch def\n");
-   printf("  wid str stringwidth pop sub 2 div 0 rmoveto str\n");
-   printf("} def\n");
-   printf("\n");
-
-   printf("%% \n");
-   printf("%% This routine draws the year of the calendar as a 'title' of sorts.\n");
-   printf("%% \n");
-   printf("/drawtitle {\n");
-   printf("  titlefont findfont titlefontsize scalefont setfont\n");
-   printf("  /yearstring year 10 string cvs def\n");
+   ps_printf("%s ",
+             odd_days_singlepage ? "1.7 add" : "");
+   ps_printf("mul sub def\n");
+   
+   ps_printf("/Xnext %s def\n",
+             rotate == PORTRAIT ? "width" : "0");
+   
+   ps_printf("/Ynext %s def\n",
+             rotate == PORTRAIT ? "0" : "negheight");
+   
+   ps_printf("/rval %s def\n",
+             rotate == PORTRAIT ? "0" : "90");
+   
+   ps_printf("/halfperiod 0.5 def\n");
+   ps_printf("/quartperiod 0.25 def\n");
+   ps_printf("/radius 15 def\n");
+   if (moon_sizes) ps_printf("/mean_diameter %.2f def\n", 60 * moon_diameter(MOON_MEAN_DIST));
+   ps_printf("/rect radius 2 sqrt mul quartperiod div def\n");
+   ps_printf("\n");
+   ps_printf("/center {\n");
+   ps_printf("  /wid exch def\n");
+   ps_printf("  /str exch def\n");
+   ps_printf("  wid str stringwidth pop sub 2 div 0 rmoveto str\n");
+   ps_printf("} def\n");
+   ps_printf("\n");
+
+   ps_printf("%% \n");
+   ps_printf("%% This routine draws the year of the calendar as a 'title' of sorts.\n");
+   ps_printf("%% \n");
+   ps_printf("/drawtitle {\n");
+   ps_printf("  titlefont findfont titlefontsize scalefont setfont\n");
+   ps_printf("  /yearstring year 10 string cvs def\n");
    
    if (rotate == PORTRAIT) {
-      printf("  margin neg 40 moveto\n");
-      printf("  yearstring pagewidth center show\n");
+      ps_printf("  margin neg 40 moveto\n");
+      ps_printf("  yearstring pagewidth center show\n");
    }
    else {
       /* The odd-days-only 1-page calendar in landscape orientation is a bit
@@ -1178,341 +1263,430 @@ void write_psfile (int year)
          where it normall goes, so we move it to the upper left corner
          instead... */
       if (odd_days_singlepage) {
-         printf("  radius width 1.2 mul sub neghalfwidth titlefontsize 1.3 mul add moveto\n");
-         printf("  yearstring show\n");
+         ps_printf("  radius width 1.2 mul sub neghalfwidth titlefontsize 1.3 mul add moveto\n");
+         ps_printf("  yearstring show\n");
       }
       else {
          /* This code handles landscape orientation for the normal 2-page
             setup and for the compressed 1-page setup... */
-         printf("  /w titlefontsize 0.6 mul def\n");
-         printf("  leftmargin neg margin add\n");
-         printf("  margin pageheight titlefontsize 2.25 mul sub 2 div sub moveto\n");
-         printf("  1 1 4 {\n");
-         printf("    /i exch def\n");
-         printf("    /c yearstring i 1 sub 1 getinterval def\n");
-         printf("    gsave\n");
-         printf("    c w center show\n");
-         printf("    grestore\n");
-         printf("    0 titlefontsize neg rmoveto\n");
-         printf("  } for\n");
+         ps_printf("  /w titlefontsize 0.6 mul def\n");
+         ps_printf("  leftmargin neg margin add\n");
+         ps_printf("  margin pageheight titlefontsize %.2f mul sub 2 div sub moveto\n",
+                   strlen(title) - 1.75);
+         ps_printf("  1 1 %d {\n", (int) strlen(title));
+         ps_printf("    /i exch def\n");
+         ps_printf("    /c yearstring i 1 sub 1 getinterval def\n");
+         ps_printf("    gsave\n");
+         ps_printf("    c w center show\n");
+         ps_printf("    grestore\n");
+         ps_printf("    0 titlefontsize neg rmoveto\n");
+         ps_printf("  } for\n");
       }
    }
    
-   printf("} def\n");
-   printf("\n");
+   ps_printf("} def\n");
+   ps_printf("\n");
    
-   printf("%% \n");
-   printf("%% This routine draws the abbreviated names of all 12 months.\n");
-   printf("%% \n");
-   printf("%% It takes a single parameter ('R','L', or 'C') to indicate\n");
-   printf("%% the text justification -- Right, Left, or Center.\n");
-   printf("%% \n");
-   printf("/drawmonths {\n");
+   ps_printf("%% \n");
+   ps_printf("%% This routine draws the abbreviated names of all %d months.\n", nmonths);
+   ps_printf("%% \n");
+   ps_printf("%% It takes a single parameter ('R','L', or 'C') to indicate\n");
+   ps_printf("%% the text justification -- Right, Left, or Center.\n");
+   ps_printf("%% \n");
+   ps_printf("/drawmonths {\n");
    
    if (rotate == LANDSCAPE) {
-      printf("  /justify exch def\n");
+      ps_printf("  /justify exch def\n");
    }
    
-   printf("  titlefont findfont monthfontsize scalefont setfont\n");
-   printf("  0 1 11 {\n");
-   printf("    /i exch def\n");
-   printf("    gsave\n");
+   ps_printf("  titlefont findfont monthfontsize scalefont setfont\n");
+   ps_printf("  0 1 %d {\n", nmonths - 1);
+   ps_printf("    /i exch def\n");
+   ps_printf("    gsave\n");
    
-   printf("    month_names i get %s\n",
-          rotate == PORTRAIT ? "width center show" : "");
+   ps_printf("    month_names i get %s\n",
+             rotate == PORTRAIT ? "width center show" : "");
    
    if (rotate == LANDSCAPE) {
-      printf("    justify (R) eq {\n");
-      printf("      dup stringwidth pop neg 0 rmoveto\n");
-      printf("    } if\n");
-      printf("    justify (C) eq {\n");
-      printf("      dup stringwidth pop neg 2 div 0 rmoveto\n");
-      printf("    } if\n");
-      printf("    show\n");
+      ps_printf("    justify (R) eq {\n");
+      ps_printf("      dup stringwidth pop neg 0 rmoveto\n");
+      ps_printf("    } if\n");
+      ps_printf("    justify (C) eq {\n");
+      ps_printf("      dup stringwidth pop neg 2 div 0 rmoveto\n");
+      ps_printf("    } if\n");
+      ps_printf("    show\n");
    }
    
-   printf("    grestore\n");
-   
-   printf("    %s rmoveto\n",
-          rotate == PORTRAIT ? "width 0" : "Xnext Ynext");
-   
-   printf("  } for\n");
-   printf("} def\n");
-   printf("\n");
-   printf("/startpage {\n");
-   
-   printf("  /xtval %s add def\n",
-          rotate == PORTRAIT ? "pagewidth 1 xsval sub mul margin" : "leftmargin fudge");
-   
-   printf("  /ytval pageheight %s def\n",
-          rotate == PORTRAIT ? "topmargin sub fudge add" : "1 ysval sub mul margin add neg");
-   
-   printf("  rval rotate\n");
-   printf("  xsval ysval scale\n");
-   printf("  xtval ytval translate\n");
-   printf("  newpath\n");
-   
-   printf("  %s neg %s fudge sub %s moveto\n",
-          rotate == PORTRAIT ? "margin" : "leftmargin",
-          rotate == PORTRAIT ? "topmargin" : "",
-          rotate == PORTRAIT ? "" : "margin");
-   
-   printf("  pagewidth 0 rlineto\n");
-   printf("  0 pageheight neg rlineto\n");
-   printf("  pagewidth neg 0 rlineto closepath clip\n");
-   printf("  0.1 setlinewidth\n");
-   printf("  clippath setbackground fill\n");
-   printf("  setforeground\n");
-   printf("} def\n");
-   printf("\n");
-   
+   ps_printf("    grestore\n");
+   
+   ps_printf("    %s rmoveto\n",
+             rotate == PORTRAIT ? "width 0" : "Xnext Ynext");
+   
+   ps_printf("  } for\n");
+   ps_printf("} def\n");
+   ps_printf("\n");
+   ps_printf("/startpage {\n");
+   
+   ps_printf("  /xtval %s add def\n",
+             rotate == PORTRAIT ? "pagewidth 1 xsval sub mul margin" : "leftmargin fudge");
+   
+   ps_printf("  /ytval pageheight %s def\n",
+             rotate == PORTRAIT ? "topmargin sub fudge add" : "1 ysval sub mul margin add neg");
+   
+   ps_printf("  rval rotate\n");
+   ps_printf("  xsval ysval scale\n");
+   ps_printf("  xtval ytval translate\n");
+   ps_printf("  newpath\n");
+   
+   ps_printf("  %s neg %s fudge sub %s moveto\n",
+             rotate == PORTRAIT ? "margin" : "leftmargin",
+             rotate == PORTRAIT ? "topmargin" : "",
+             rotate == PORTRAIT ? "" : "margin");
+   
+   ps_printf("  pagewidth 0 rlineto\n");
+   ps_printf("  0 pageheight neg rlineto\n");
+   ps_printf("  pagewidth neg 0 rlineto closepath clip\n");
+   ps_printf("  0.1 setlinewidth\n");
+   ps_printf("  clippath setbackground fill\n");
+   ps_printf("  setforeground\n");
+   ps_printf("} def\n");
+   ps_printf("\n");
+   
+
+   ps_printf("%% \n");
+   ps_printf("%% This routine draws a single number which represents the day of the month.\n");
+   ps_printf("%% \n");
+   ps_printf("/drawdate {\n");
+   ps_printf("  /daystr day 3 string cvs def\n");
+   
+   ps_printf("  /%s margin halfwidth add radius sub %s def\n",
+             rotate == PORTRAIT ? "w" : "h",
+             rotate == PORTRAIT ? "" : "2 div");
+   
+   ps_printf("  /y datefontsize 0.375 mul neg def\n");
+   ps_printf("  titlefont findfont datefontsize scalefont setfont\n");
+   ps_printf("  gsave\n");
+   
+   ps_printf("  neghalfwidth %s rmoveto\n",
+             rotate == PORTRAIT ? "margin sub y" : "radius h add y add");
+   
+   ps_printf("  daystr %s center show\n",
+             rotate == PORTRAIT ? "w" : "width");
+   
+   ps_printf("  grestore\n");
+   ps_printf("  gsave\n");
+   
+   ps_printf("  %s %d mul radius %s rmoveto\n",
+             rotate == PORTRAIT ? "width" : "neghalfwidth negheight", nmonths - 1,
+             rotate == PORTRAIT ? "add y" : "sub h sub y add");
+   
+   ps_printf("  daystr %s center show\n",
+             rotate == PORTRAIT ? "w" : "width");
+   
+   ps_printf("  grestore\n");
+   ps_printf("} def\n");
+   ps_printf("\n");
+   
+   ps_printf("%% \n");
+   ps_printf("%% This routine draws %d abbreviated day-of-week names, inside the graphical\n", nmonths);
+   ps_printf("%% moons, 1 for each month, for the day-of-month currently being processed.\n");
+   ps_printf("%% \n");
+   ps_printf("/draw_inmoon_weekdays {\n");
+   ps_printf("  dayfont findfont weekdayfontsize scalefont setfont\n");
+   ps_printf("  /n day 1 sub %d mul def\n", nmonths);
+   ps_printf("  gsave\n");
+   ps_printf("  neghalfwidth weekdayfontsize 0.375 mul neg rmoveto\n");
+   ps_printf("  0 1 %d {\n", nmonths - 1);
+   ps_printf("    /month exch def\n");
+   ps_printf("    /phase moon_phases n get def\n");
+   ps_printf("    phase 0 ge {\n");
+   ps_printf("      /wkd startday month get day 1 sub add 7 mod def\n");
+   ps_printf("      gsave\n");
+   ps_printf("      day_names wkd get width center\n");
+   ps_printf("      phase .35 ge phase .65 le and {\n");
+   ps_printf("        setforeground show\n");
+   ps_printf("      } {\n");
+   ps_printf("        phase .85 gt phase .15 lt or {\n");
+   ps_printf("          setbackground show\n");
+   ps_printf("        } {\n");
+   ps_printf("          true charpath gsave setbackground\n");
+   ps_printf("          fill grestore stroke\n");
+   ps_printf("        } ifelse\n");
+   ps_printf("      } ifelse\n");
+   ps_printf("      grestore\n");
+   ps_printf("    } if\n");
+   ps_printf("    /n n 1 add def\n");
+   ps_printf("    Xnext Ynext rmoveto\n");
+   ps_printf("  } for\n");
+   ps_printf("  grestore\n");
+   ps_printf("} def\n");
+   ps_printf("\n");
+
+   ps_printf("%% \n");
+   ps_printf("%% This routine draws %d abbreviated day-of-week names, to the lower left of\n", nmonths);
+   ps_printf("%% the graphical moons, 1 for each month, for the day-of-month\n");
+   ps_printf("%% currently being processed.\n");
+   ps_printf("%% \n");
+   ps_printf("/draw_outmoon_weekdays {\n");
+   ps_printf("  dayfont findfont sm_weekdayfontsize scalefont setfont\n");
+   ps_printf("  /n day 1 sub %d mul def\n", nmonths);
+   ps_printf("  gsave\n");
+   ps_printf("  negwidth 0.27 mul negheight 0.27 mul sm_weekdayfontsize 0.75 mul sub rmoveto\n");
+   ps_printf("  0 1 %d {\n", nmonths - 1);
+   ps_printf("    /month exch def\n");
+   ps_printf("    /phase moon_phases n get def\n");
+   ps_printf("    phase 0 ge {\n");
+   ps_printf("      /wkd startday month get day 1 sub add 7 mod def\n");
+   ps_printf("      gsave\n");
+   ps_printf("      day_names wkd get\n");
+   ps_printf("      dup stringwidth pop neg 0 rmoveto\n");
+   ps_printf("      show\n");
+   ps_printf("      grestore\n");
+   ps_printf("    } if\n");
+   ps_printf("    /n n 1 add def\n");
+   ps_printf("    Xnext Ynext rmoveto\n");
+   ps_printf("  } for\n");
+   ps_printf("  grestore\n");
+   ps_printf("} def\n");
+   ps_printf("\n");
+   ps_printf("/domoon {\n");
+   ps_printf("  /phase exch def\n");
+   ps_printf("  gsave\n");
+   ps_printf("  currentpoint translate\n");
+   ps_printf("  newpath\n");
+
+   ps_printf("  setmoonlight\n");
+   ps_printf("  0 0 radius\n");
+   ps_printf("  0 360 arc fill\n");
+   ps_printf("  setmoondark\n");
+
+   ps_printf("  phase halfperiod .01 sub ge phase halfperiod .01 add le and {\n");
+   ps_printf("    0 0 radius\n");
+   ps_printf("    0 360 arc stroke\n");
+   ps_printf("  } {\n");
+   ps_printf("    0 0 radius\n");
+   ps_printf("    0 0 radius\n");
+   ps_printf("    phase halfperiod lt {\n");
+   ps_printf("      270 90 arc stroke\n");
+   ps_printf("      0 radius neg moveto\n");
+   ps_printf("      270 90 arcn\n");
+   ps_printf("    } {\n");
+   ps_printf("      90 270 arc stroke\n");
+   ps_printf("      0 radius neg moveto\n");
+   ps_printf("      270 90 arc\n");
+   ps_printf("      /phase phase halfperiod sub def\n");
+   ps_printf("    } ifelse\n");
+   ps_printf("    /x1 quartperiod phase sub rect mul def\n");
+   ps_printf("    /y1 x1 abs 2 sqrt div def\n");
+   ps_printf("    x1\n");
+   ps_printf("    y1\n");
+   ps_printf("    x1\n");
+   ps_printf("    y1 neg\n");
+   ps_printf("    0\n");
+   ps_printf("    radius neg\n");
+   ps_printf("    curveto\n");
+   ps_printf("    fill\n");
+   ps_printf("  } ifelse\n");
+   ps_printf("  grestore\n");
+   ps_printf("} def\n");
+   ps_printf("\n");
+
+   /* With '-e', each eclipse is marked by a ring around that day's moon
+      (cf. ECL_NONE etc.), as this routine draws... */
+   if (mark_eclipses) {
+      ps_printf("%% \n");
+      ps_printf("%% This routine marks an eclipse (of the type given by its parameter, if\n");
+      ps_printf("%% any) with a ring around the moon at the current point: solid for a\n");
+      ps_printf("%% lunar eclipse, dashed for a solar one, and heavier if total (or annular).\n");
+      ps_printf("%% \n");
+      ps_printf("/eclipse_widths [0 0.5 1 1.6 0.5 1.6 1.6 1.6] def\n");
+      ps_printf("/draweclipse {\n");
+      ps_printf("  /etype exch def\n");
+      ps_printf("  etype 0 gt {\n");
+      ps_printf("    gsave\n");
+      ps_printf("    currentpoint translate\n");
+      ps_printf("    newpath\n");
+      ps_printf("    setforeground\n");
+      ps_printf("    eclipse_widths etype get setlinewidth\n");
+      ps_printf("    etype %d ge { [2 1.5] 0 setdash } if\n", ECL_PARTIAL_SOLAR);
+      ps_printf("    0 0 radius 3 add 0 360 arc stroke\n");
+      ps_printf("    grestore\n");
+      ps_printf("  } if\n");
+      ps_printf("} def\n");
+      ps_printf("\n");
+   }
 
-   printf("%% \n");
-   printf("%% This routine draws a single number which represents the day of the month.\n");
-   printf("%% \n");
-   printf("/drawdate {\n");
-   printf("  /daystr day 3 string cvs def\n");
-   
-   printf("  /%s margin halfwidth add radius sub %s def\n",
-          rotate == PORTRAIT ? "w" : "h",
-          rotate == PORTRAIT ? "" : "2 div");
-   
-   printf("  /y datefontsize 0.375 mul neg def\n");
-   printf("  titlefont findfont datefontsize scalefont setfont\n");
-   printf("  gsave\n");
-   
-   printf("  neghalfwidth %s rmoveto\n",
-          rotate == PORTRAIT ? "margin sub y" : "radius h add y add");
-   
-   printf("  daystr %s center show\n",
-          rotate == PORTRAIT ? "w" : "width");
-   
-   printf("  grestore\n");
-   printf("  gsave\n");
-   
-   printf("  %s 11 mul radius %s rmoveto\n",
-          rotate == PORTRAIT ? "width" : "neghalfwidth negheight",
-          rotate == PORTRAIT ? "add y" : "sub h sub y add");
-   
-   printf("  daystr %s center show\n",
-          rotate == PORTRAIT ? "w" : "width");
-   
-   printf("  grestore\n");
-   printf("} def\n");
-   printf("\n");
-   
-   printf("%% \n");
-   printf("%% This routine draws 12 abbreviated day-of-week names, inside the graphical\n");
-   printf("%% moons, 1 for each month, for the day-of-month currently being processed.\n");
-   printf("%% \n");
-   printf("/draw_inmoon_weekdays {\n");
-   printf("  dayfont findfont weekdayfontsize scalefont setfont\n");
-   printf("  /n day 1 sub 12 mul def\n");
-   printf("  gsave\n");
-   printf("  neghalfwidth weekdayfontsize 0.375 mul neg rmoveto\n");
-   printf("  0 1 11 {\n");
-   printf("    /month exch def\n");
-   printf("    /phase moon_phases n get def\n");
-   printf("    phase 0 ge {\n");
-   printf("      /wkd startday month get day 1 sub add 7 mod def\n");
-   printf("      gsave\n");
-   printf("      day_names wkd get width center\n");
-   printf("      phase .35 ge phase .65 le and {\n");
-   printf("        setforeground show\n");
-   printf("      } {\n");
-   printf("        phase .85 gt phase .15 lt or {\n");
-   printf("          setbackground show\n");
-   printf("        } {\n");
-   printf("          true charpath gsave setbackground\n");
-   printf("          fill grestore stroke\n");
-   printf("        } ifelse\n");
-   printf("      } ifelse\n");
-   printf("      grestore\n");
-   printf("    } if\n");
-   printf("    /n n 1 add def\n");
-   printf("    Xnext Ynext rmoveto\n");
-   printf("  } for\n");
-   printf("  grestore\n");
-   printf("} def\n");
-   printf("\n");
+   /* With '-g', the times of moonrise and moonset are written beneath
+      each moon, as this routine draws... */
+   if (rise_set) {
+      ps_printf("%% \n");
+      ps_printf("%% This routine writes %d pairs of moonrise and moonset times, 1 for each\n", nmonths);
+      ps_printf("%% month, beneath the graphical moons for the day-of-month currently being\n");
+      ps_printf("%% processed.\n");
+      ps_printf("%% \n");
+      ps_printf("/drawtimes {\n");
+      ps_printf("  dayfont findfont timefontsize scalefont setfont\n");
+      ps_printf("  /n day 1 sub %d mul def\n", nmonths);
+      ps_printf("  gsave\n");
+      ps_printf("  0 1 %d {\n", nmonths - 1);
+      ps_printf("    moon_phases n get 0 ge {\n");
+      ps_printf("      gsave\n");
+      ps_printf("      setforeground\n");
+      ps_printf("      /times moon_times n get def\n");
+      ps_printf("      times stringwidth pop 2 div neg radius timefontsize add neg rmoveto\n");
+      ps_printf("      times show\n");
+      ps_printf("      grestore\n");
+      ps_printf("    } if\n");
+      ps_printf("    /n n 1 add def\n");
+      ps_printf("    pop\n");
+      ps_printf("    %s rmoveto\n",
+                rotate == PORTRAIT ? "width 0" : "Xnext Ynext");
+      ps_printf("  } for\n");
+      ps_printf("  grestore\n");
+      ps_printf("} def\n");
+      ps_printf("\n");
+   }
 
-   printf("%% \n");
-   printf("%% This routine draws 12 abbreviated day-of-week names, to the lower left of\n");
-   printf("%% the graphical moons, 1 for each month, for the day-of-month\n");
-   printf("%% currently being processed.\n");
-   printf("%% \n");
-   printf("/draw_outmoon_weekdays {\n");
-   printf("  dayfont findfont sm_weekdayfontsize scalefont setfont\n");
-   printf("  /n day 1 sub 12 mul def\n");
-   printf("  gsave\n");
-   printf("  negwidth 0.27 mul negheight 0.27 mul sm_weekdayfontsize 0.75 mul sub rmoveto\n");
-   printf("  0 1 11 {\n");
-   printf("    /month exch def\n");
-   printf("    /phase moon_phases n get def\n");
-   printf("    phase 0 ge {\n");
-   printf("      /wkd startday month get day 1 sub add 7 mod def\n");
-   printf("      gsave\n");
-   printf("      day_names wkd get\n");
-   printf("      dup stringwidth pop neg 0 rmoveto\n");
-   printf("      show\n");
-   printf("      grestore\n");
-   printf("    } if\n");
-   printf("    /n n 1 add def\n");
-   printf("    Xnext Ynext rmoveto\n");
-   printf("  } for\n");
-   printf("  grestore\n");
-   printf("} def\n");
-   printf("\n");
-   printf("/domoon {\n");
-   printf("  /phase exch def\n");
-   printf("  gsave\n");
-   printf("  currentpoint translate\n");
-   printf("  newpath\n");
-
-   printf("  setmoonlight\n");
-   printf("  0 0 radius\n");
-   printf("  0 360 arc fill\n");
-   printf("  setmoondark\n");
-
-   printf("  phase halfperiod .01 sub ge phase halfperiod .01 add le and {\n");
-   printf("    0 0 radius\n");
-   printf("    0 360 arc stroke\n");
-   printf("  } {\n");
-   printf("    0 0 radius\n");
-   printf("    0 0 radius\n");
-   printf("    phase halfperiod lt {\n");
-   printf("      270 90 arc stroke\n");
-   printf("      0 radius neg moveto\n");
-   printf("      270 90 arcn\n");
-   printf("    } {\n");
-   printf("      90 270 arc stroke\n");
-   printf("      0 radius neg moveto\n");
-   printf("      270 90 arc\n");
-   printf("      /phase phase halfperiod sub def\n");
-   printf("    } ifelse\n");
-   printf("    /x1 quartperiod phase sub rect mul def\n");
-   printf("    /y1 x1 abs 2 sqrt div def\n");
-   printf("    x1\n");
-   printf("    y1\n");
-   printf("    x1\n");
-   printf("    y1 neg\n");
-   printf("    0\n");
-   printf("    radius neg\n");
-   printf("    curveto\n");
-   printf("    fill\n");
-   printf("  } ifelse\n");
-   printf("  grestore\n");
-   printf("} def\n");
-   printf("\n");
+   /* With '-m', each moon is drawn to the scale of its apparent diameter,
+      and a full moon near perigee is ringed, as this routine draws... */
+   if (moon_sizes) {
+      ps_printf("%% \n");
+      ps_printf("%% This routine rings a full moon near perigee (if its parameter is 1) at\n");
+      ps_printf("%% the current point.\n");
+      ps_printf("%% \n");
+      ps_printf("/drawsupermoon {\n");
+      ps_printf("  1 eq {\n");
+      ps_printf("    gsave\n");
+      ps_printf("    currentpoint translate\n");
+      ps_printf("    newpath\n");
+      ps_printf("    setforeground\n");
+      ps_printf("    1.2 setlinewidth\n");
+      ps_printf("    0 0 radius 1.5 add 0 360 arc stroke\n");
+      ps_printf("    grestore\n");
+      ps_printf("  } if\n");
+      ps_printf("} def\n");
+      ps_printf("\n");
+   }
 
-   printf("%% \n");
-   printf("%% This routine draws 12 graphical moons, 1 for each month, for the\n");
-   printf("%% day-of-month currently being processed.\n");
-   printf("%% \n");
-   printf("/drawmoons {\n");
-   printf("  /n day 1 sub 12 mul def\n");
-   printf("  gsave\n");
-   printf("  0 1 11 {\n");
-   printf("    /phase moon_phases n get def\n");
-   printf("    phase 0 ge {\n");
-   printf("      phase domoon\n");
-   printf("    } if\n");
-   printf("    /n n 1 add def\n");
-   printf("    pop\n");
-
-   printf("    %s rmoveto\n",
-          rotate == PORTRAIT ? "width 0" : "Xnext Ynext");
-
-   printf("  } for\n");
-   printf("  grestore\n");
-   printf("} def\n");
-   printf("\n");
+   ps_printf("%% \n");
+   ps_printf("%% This routine draws %d graphical moons, 1 for each month, for the\n", nmonths);
+   ps_printf("%% day-of-month currently being processed.\n");
+   ps_printf("%% \n");
+   ps_printf("/drawmoons {\n");
+   ps_printf("  /n day 1 sub %d mul def\n", nmonths);
+   ps_printf("  gsave\n");
+   ps_printf("  0 1 %d {\n", nmonths - 1);
+   ps_printf("    /phase moon_phases n get def\n");
+   ps_printf("    phase 0 ge {\n");
+   if (moon_sizes) {
+      ps_printf("      gsave\n");
+      ps_printf("      currentpoint translate\n");
+      ps_printf("      moon_diameters n get mean_diameter div dup scale\n");
+   }
+   ps_printf("      phase domoon\n");
+   if (mark_eclipses) ps_printf("      eclipses n get draweclipse\n");
+   if (moon_sizes) {
+      ps_printf("      supermoons n get drawsupermoon\n");
+      ps_printf("      grestore\n");
+   }
+   ps_printf("    } if\n");
+   ps_printf("    /n n 1 add def\n");
+   ps_printf("    pop\n");
 
+   ps_printf("    %s rmoveto\n",
+             rotate == PORTRAIT ? "width 0" : "Xnext Ynext");
+
+   ps_printf("  } for\n");
+   ps_printf("  grestore\n");
+   ps_printf("} def\n");
+   ps_printf("\n");
+
+
+   ps_printf("%% \n");
+   ps_printf("%% This routine does everything needed to process a single day of the month,\n");
+   ps_printf("%% for all months at once.\n");
+   ps_printf("%% \n");
+   ps_printf("/process_one_day {\n");
+   ps_printf("  /day exch def\n");
+
+   ps_printf("    %s ",
+             rotate == PORTRAIT ? "halfwidth Y0 day 1 sub negheight" : "X0 day 1 sub width");
+   ps_printf("%s ",
+             odd_days_singlepage ? "0.5 mul" : "");
+   ps_printf("%s moveto\n",
+             rotate == PORTRAIT ? "mul add" : "mul add neghalfheight");
 
-   printf("%% \n");
-   printf("%% This routine does everything needed to process a single day of the month,\n");
-   printf("%% for all months at once.\n");
-   printf("%% \n");
-   printf("/process_one_day {\n");
-   printf("  /day exch def\n");
-
-   printf("    %s ",
-          rotate == PORTRAIT ? "halfwidth Y0 day 1 sub negheight" : "X0 day 1 sub width");
-   printf("%s ",
-          odd_days_singlepage ? "0.5 mul" : "");
-   printf("%s moveto\n",
-          rotate == PORTRAIT ? "mul add" : "mul add neghalfheight");
-
-
-   printf("  drawdate\n");
-   printf("  drawmoons\n");
-   printf("  inmoon_labels {\n");
-   printf("    draw_inmoon_weekdays\n");
-   printf("  } {\n");
-   printf("    draw_outmoon_weekdays\n");
-   printf("  } ifelse\n");
-   printf("} def\n");
-   printf("\n");
 
-   printf("/draw_page_1 {\n");
-   printf("  /fudge fudge1 def\n");
-   printf("  startpage\n");
-   printf("  drawtitle\n");
+   ps_printf("  drawdate\n");
+   ps_printf("  drawmoons\n");
+   if (rise_set) ps_printf("  drawtimes\n");
+   ps_printf("  inmoon_labels {\n");
+   ps_printf("    draw_inmoon_weekdays\n");
+   ps_printf("  } {\n");
+   ps_printf("    draw_outmoon_weekdays\n");
+   ps_printf("  } ifelse\n");
+   ps_printf("} def\n");
+   ps_printf("\n");
 
+   ps_printf("/draw_page_1 {\n");
+   ps_printf("  /fudge fudge1 def\n");
+   ps_printf("  startpage\n");
+   ps_printf("  drawtitle\n");
 
-   printf("  %s moveto\n",
-          rotate == PORTRAIT ? "0 10" : "radius halfwidth sub neghalfwidth monthfontsize 0.375 mul sub");
 
-   printf("  %sdrawmonths\n",
-          rotate == PORTRAIT ? "" : "(R)");
+   ps_printf("  %s moveto\n",
+             rotate == PORTRAIT ? "0 10" : "radius halfwidth sub neghalfwidth monthfontsize 0.375 mul sub");
 
-   printf("  /%s def\n",
-          rotate == PORTRAIT ? "Y0 neghalfheight" : "X0 halfwidth");
+   ps_printf("  %sdrawmonths\n",
+             rotate == PORTRAIT ? "" : "(R)");
+
+   ps_printf("  /%s def\n",
+             rotate == PORTRAIT ? "Y0 neghalfheight" : "X0 halfwidth");
 
    /* If odd-days-only output to a single page ('-O') has been requested,
       process all 31 days on 1 page, but increment the days by 2 instead of by
       1.  If output to a single page ('-S' or '-O') has been requested,
       process all 31 days on 1 page... */
-   printf("  1 %d %d {\n", 
-          odd_days_singlepage ? 2 : 1,
-          (odd_days_singlepage || compressed_singlepage) ? 31 : 15);
+   ps_printf("  1 %d %d {\n", 
+             odd_days_singlepage ? 2 : 1,
+             (odd_days_singlepage || compressed_singlepage) ? 31 : 15);
 
-   printf("    process_one_day \n");
-   printf("  } for\n");
-   printf("} def\n");
-   printf("\n");
+   ps_printf("    process_one_day \n");
+   ps_printf("  } for\n");
+   ps_printf("} def\n");
+   ps_printf("\n");
 
    /* If this is not a single-page calendar, create the routine to draw the
       2nd page... */
 
    if (!(compressed_singlepage || odd_days_singlepage)) {
-      printf("/draw_page_2 {\n");
-      printf("  /fudge fudge2 def\n");
-      printf("  startpage\n");
+      ps_printf("/draw_page_2 {\n");
+      ps_printf("  /fudge fudge2 def\n");
+      ps_printf("  startpage\n");
       
       if (rotate == PORTRAIT) {
-         printf("      /Y0 neghalfheight pageheight add def\n");
+         ps_printf("      /Y0 neghalfheight pageheight add def\n");
       }
       else {
-         printf("      /X0 halfwidth pagewidth sub def\n");
+         ps_printf("      /X0 halfwidth pagewidth sub def\n");
       }
       
-      printf("  16 1 31 {\n");
-      printf("    process_one_day \n");
-      printf("  } for\n");
+      ps_printf("  16 1 31 {\n");
+      ps_printf("    process_one_day \n");
+      ps_printf("  } for\n");
       
       if (rotate == PORTRAIT) {
-         printf("  0 Y0 31 negheight mul add moveto\n");
+         ps_printf("  0 Y0 31 negheight mul add moveto\n");
       }
       else {
-         printf("  X0 31 width mul add radius sub neghalfwidth monthfontsize 0.375 mul sub moveto\n");
+         ps_printf("  X0 31 width mul add radius sub neghalfwidth monthfontsize 0.375 mul sub moveto\n");
       }
       
-      printf("  %sdrawmonths\n",
-             rotate == PORTRAIT ? "" : "(L)");
+      ps_printf("  %sdrawmonths\n",
+                rotate == PORTRAIT ? "" : "(L)");
       
-      printf("} def\n");
-      printf("\n");
+      ps_printf("} def\n");
+      ps_printf("\n");
    }
 
    
@@ -1520,106 +1694,468 @@ void write_psfile (int year)
     * Write out PostScript code to print lunar calendar
     */
    
-   printf("/year %d def\n", year);
-   printf("/startday [");
+   STATS_ADD(STAGE_PROLOG, t0);
+   t0 = STATS_CLOCK();
 
-   for (month = JAN; month <= DEC; month++) {
-      printf("%2d", FIRST_OF(month, year));
+   if (first_year == last_year) ps_printf("/year %d def\n", first_year);
+   else ps_printf("/year (%s) def\n", title);
+   p = line;
+   for (i = 0; i < nmonths; i++) {
+      p = fmt_int_w(p, tbl->month[i].startday, 2);
    }
+   *p = '\0';
+   ps_printf("/startday [%s ] def\n", line);
 
-   printf(" ] def\n");
-
-   printf("/moon_phases [\n");
+   /* (each line of phases is assembled by the routines in lcalfmt.c,
+      which are much faster than ps_printf() and give the same output) */
+      ps_printf("/moon_phases [\n");
    for (day = 1; day <= 31; day++) {
-      for (month = JAN; month <= DEC; month++) {
-         phase = calc_phase(month, day, year);
-         if (day <= LENGTH_OF(month, year)) {
-            /* make sure printf() doesn't round "phase" up to 1.0 when printing it */
-            printf("%.3f ", ((phase) >= 0.9995 ? 0.0 : (phase)));
+      p = line;
+      for (i = 0; i < nmonths; i++) {
+         phase = tbl->phase[day-1][i];
+         if (phase >= 0.0) {
+            /* (fmt_phase() doesn't round "phase" up to 1.0) */
+            p = fmt_phase(p, phase);
+            *p++ = ' ';
+         }
+         else {
+            memcpy(p, " -1   ", 6);
+            p += 6;
+         }
+      }
+      *p++ = '\n';
+      ps_write(line, p - line);
+   }
+   ps_printf("] def\n");
+
+   /* ... and the type of eclipse, if any, on each day (cf. '/draweclipse') */
+   if (mark_eclipses) {
+      calc_eclipse_table(tbl, eclipses);
+      ps_printf("/eclipses [\n");
+      for (day = 1; day <= 31; day++) {
+         p = line;
+         for (i = 0; i < nmonths; i++) {
+            p = fmt_int_w(p, eclipses[day-1][i], 2);
          }
-         else printf(" -1   ");
+         *p++ = '\n';
+         ps_write(line, p - line);
       }
-      printf("\n");
+      ps_printf("] def\n");
+   }
+
+   /* ... and the apparent diameter of the moon (in minutes of arc), and
+      which full moons are near perigee, on each day (cf. '/drawsupermoon') */
+   if (moon_sizes) {
+      calc_supermoons(tbl, supermoons);
+      ps_printf("/moon_diameters [\n");
+      for (day = 1; day <= 31; day++) {
+         p = line;
+         for (i = 0; i < nmonths; i++) {
+            *p++ = ' ';
+            p = tbl->dist[day-1][i] > 0.0 ? fmt_fixed(p, 60 * moon_diameter(tbl->dist[day-1][i]), 2) :
+               fmt_int(p, -1);
+         }
+         *p++ = '\n';
+         ps_write(line, p - line);
+      }
+      ps_printf("] def\n");
+
+      ps_printf("/supermoons [\n");
+      for (day = 1; day <= 31; day++) {
+         p = line;
+         for (i = 0; i < nmonths; i++) {
+            p = fmt_int_w(p, supermoons[day-1][i], 2);
+         }
+         *p++ = '\n';
+         ps_write(line, p - line);
+      }
+      ps_printf("] def\n");
+   }
+
+   /* ... and the times of moonrise and moonset (cf. '/drawtimes') */
+   if (rise_set) {
+      calc_rise_set_table(tbl, latitude, longitude, rise, set);
+      ps_printf("/moon_times [\n");
+      for (day = 1; day <= 31; day++) {
+         p = line;
+         for (i = 0; i < nmonths; i++) {
+            *p++ = ' ';
+            *p++ = '(';
+            p = fmt_hhmm(p, rise[day-1][i]);
+            *p++ = ' ';
+            p = fmt_hhmm(p, set[day-1][i]);
+            *p++ = ')';
+         }
+         *p++ = '\n';
+         ps_write(line, p - line);
+      }
+      ps_printf("] def\n");
    }
-   printf("] def\n");
    
-   printf("\n");
+   ps_printf("\n");
    
-   printf("%%%%Page: 1st 1\n");
-   printf("draw_page_1\n");
-   printf("showpage\n");
+   ps_printf("%%%%Page: 1st 1\n");
+   ps_printf("draw_page_1\n");
+   ps_printf("showpage\n");
    
    /* If this is not a single-page calendar, draw the 2nd page... */
    if (!(compressed_singlepage || odd_days_singlepage)) {
-      printf("\n");
-      printf("%%%%Page: 2nd 2\n");
-      printf("draw_page_2\n");
-      printf("showpage\n");
+      ps_printf("\n");
+      ps_printf("%%%%Page: 2nd 2\n");
+      ps_printf("draw_page_2\n");
+      ps_printf("showpage\n");
    }
    
+   STATS_ADD(STAGE_TABLE, t0);
    return;
 }
 
+#ifndef LCAL_LIBRARY   /* (not needed by liblcal) */
+
 /* ---------------------------------------------------------------------------
 
-   get_args
+   query_phase
 
    Notes:
 
-      This routine walks the argument list.
-
-      This utility routine was borrowed from 'pcal'.
+      This routine prints the phase, illuminated fraction, and age of the
+      moon at the instant specified via '-q' (a Unix time, optionally
+      preceded by '@', or a Julian date preceded by "JD"; the default is the
+      current time).  No PostScript is generated.
 
-      char **argv;        argument list 
-      int curr_pass;      current pass 
-      char *where;        for error messages 
+      It returns 'TRUE' if the time is valid (i.e. within the years MIN_YR ..
+      MAX_YR) and 'FALSE' otherwise.
 
 */
-int get_args (char **argv, int curr_pass, char *where)
+static int query_phase (char *when)
 {
-   char *parg, *opt;
-   flag_usage_str_typ *pflag;
-   int flag;
-   time_t curr_tyme;   /* for getting current month/year */
+   moon_info_str_typ info;
+   double jd;
+   time_t t;
    struct tm *p_tm;
-   int badopt = FALSE;   /* flag set if bad param   */
-   int nargs = 0;   /* count of non-flag args  */
-   int numargs[MAXARGS];   /* non-flag (numeric) args */
-   FILE *fp = stdout;   /* for piping "help" message */
+   char *p, time_str[50];
 
-/*
- * If argument follows flag (immediately or as next parameter), return
- * pointer to it (and bump argv if necessary); else return NULL
- */
-#define GETARG() (*(*argv + 2) ? *argv + 2 : \
-                  (*(argv+1) && **(argv+1) != '-' ? *++argv : NULL))
+   if (*when == '\0') {
+      jd = UNIX_TO_JD((double) time(NULL));
+   }
+   else if (strncmp(when, "JD", 2) == 0 || strncmp(when, "jd", 2) == 0) {
+      jd = strtod(when + 2, &p);
+      if (p == when + 2 || *p) jd = -1;
+   }
+   else {
+      jd = UNIX_TO_JD(strtod(when + (*when == '@'), &p));
+      if (p == when + (*when == '@') || *p) jd = -1;
+   }
 
-   /* Walk argument list, ignoring first element (program name) */
+   if (!(jd >= JD_MIN_YR && jd < JD_MAX_YR)) {   /* (also catches NaN) */
+      fprintf(stderr, E_ILL_TIME, progname, when, MIN_YR, MAX_YR);
+      return FALSE;
+   }
 
-   while ((opt = *++argv) != NULL) {
+   calc_moon_info(jd, &info);
 
-      /* Assume that any non-flag argument is a numeric argument */
-      if (*opt != '-') {
-         if (curr_pass == P_CMD1 && nargs < MAXARGS) {
-            if (! IS_NUMERIC(opt)) goto bad_par;
-            numargs[nargs++] = atoi(opt);
-         }
-         continue;
-      }
+   t = (time_t) floor(JD_TO_UNIX(jd));
+   if ((p_tm = gmtime(&t)) != NULL) {
+      strftime(time_str, sizeof(time_str), "%Y-%m-%d %H:%M:%S UTC", p_tm);
+   }
+   else strcpy(time_str, "(beyond time_t)");
 
-      /* Check that flag is legal */
+   printf("%s  JD %.5f  phase %.4f  illuminated %.4f  age %.3f days",
+          time_str, jd, info.phase, info.illum, info.age);
+   if (moon_sizes) printf("  distance %.0f km  diameter %.4f deg", info.dist, info.diam);
+   printf("\n");
 
-      if (! (pflag = get_flag(flag = opt[1])) ) goto bad_par;
-      
-      /* get optional argument */
-      
-      parg = pflag->has_arg ? GETARG() : NULL;
-      
-      switch (flag) {
-         
-      case F_COMPR_1PAGE:
-         compressed_singlepage = TRUE;
-         break;
+   return TRUE;
+}
+
+/* ---------------------------------------------------------------------------
+
+   list_eclipses
+
+   Notes:
+
+      This routine prints the time (UTC, to the minute) and type of each
+      eclipse of the sun and moon in the years specified via '-L' ("first"
+      or "first-last"; by default, the months the calendar would show), with
+      its 'gamma' and magnitude (cf. lcalecl.c).  No PostScript is
+      generated.
+
+      It returns 'TRUE' if the years are valid and 'FALSE' otherwise.
+
+*/
+static int list_eclipses (char *years)
+{
+   eclipse_str_typ ecl[MAX_ECLIPSES];
+   double jd0, jd1, jd_end;
+   int first, last, i, n;
+   time_t t;
+   struct tm *p_tm;
+   char *p, time_str[50];
+
+   if (*years == '\0') {
+      jd0 = (double) jdn(init_month, 1, init_year) - 0.5;
+      jd_end = (double) jdn((init_month - 1 + num_months) % 12 + 1, 1,
+                            init_year + (init_month - 1 + num_months) / 12) - 0.5;
+   }
+   else {
+      first = last = (int) strtol(years, &p, 10);
+      if (*p == '-') last = (int) strtol(p + 1, &p, 10);
+      if (*p || first < MIN_YR || last > MAX_YR || first > last) {
+         fprintf(stderr, E_ILL_YEARS, progname, years, MIN_YR, MAX_YR);
+         return FALSE;
+      }
+      jd0 = (double) jdn(JAN, 1, first) - 0.5;
+      jd_end = (double) jdn(JAN, 1, last + 1) - 0.5;
+   }
+
+   /* (a year at a time, which has fewer than MAX_ECLIPSES) */
+   for (; jd0 < jd_end; jd0 = jd1) {
+      jd1 = jd0 + 366.0 < jd_end ? jd0 + 366.0 : jd_end;
+      n = find_eclipses(jd0, jd1, ecl, MAX_ECLIPSES);
+
+      for (i = 0; i < n; i++) {
+         t = (time_t) floor(JD_TO_UNIX(ecl[i].jd) + 30.0);
+         if ((p_tm = gmtime(&t)) != NULL) {
+            strftime(time_str, sizeof(time_str), "%Y-%m-%d %H:%M UTC", p_tm);
+         }
+         else sprintf(time_str, "JD %.4f", ecl[i].jd);   /* (beyond time_t) */
+         printf("%s  %-16s gamma %7.4f", time_str, eclipse_name(ecl[i].type), ecl[i].gamma);
+         if (ecl[i].mag >= 0.0) printf("  magnitude %.3f", ecl[i].mag);
+         printf("\n");
+      }
+   }
+
+   return TRUE;
+}
+
+#endif   /* LCAL_LIBRARY */
+
+/* ---------------------------------------------------------------------------
+
+   split_list
+
+   Notes:
+
+      This routine splits a copy of the 'sep'-separated list 'list' into the
+      array 'items' (of at most 'max' entries), using 'buf' for storage.  It
+      returns the number of items, or -1 if there are too many or any is
+      empty (e.g. "0,,5").
+
+*/
+static int split_list (char *list, int sep, char *buf, char **items, int max)
+{
+   char *p;
+   int n = 0, i;
+
+   strcpy(buf, list);
+   for (p = buf; p; p = strchr(p, sep) ? strchr(p, sep) + 1 : NULL) {
+      if (n == max) return -1;
+      items[n++] = p;
+   }
+   for (p = buf; (p = strchr(p, sep)) != NULL; ) *p++ = '\0';
+
+   for (i = 0; i < n; i++) {
+      if (*items[i] == '\0') return -1;
+   }
+   return n;
+}
+
+/* ---------------------------------------------------------------------------
+
+   parse_location
+
+   Notes:
+
+      This routine sets 'latitude' and 'longitude' from the place 'loc'
+      given via '-g', "<lat>/<lon>" in degrees (north and east positive,
+      e.g. "40.71/-74.01" for New York).
+
+      It returns 'TRUE' if the place is valid and 'FALSE' otherwise.
+
+*/
+static int parse_location (char *loc)
+{
+   double lat, lon;
+   char *p;
+
+   lat = strtod(loc, &p);
+   if (p == loc || *p != '/') return FALSE;
+   lon = strtod(loc = p + 1, &p);
+   if (p == loc || *p || fabs(lat) > 90.0 || fabs(lon) > 180.0) return FALSE;
+
+   latitude = lat;
+   longitude = lon;
+   return TRUE;
+}
+
+#ifndef LCAL_LIBRARY   /* (not needed by liblcal) */
+
+/* ---------------------------------------------------------------------------
+
+   expand_filename
+
+   Notes:
+
+      This routine copies the output file name 'pattern' to 'name' (of
+      'size' characters), replacing each "%z" with the time zone 'zone' (with
+      any directory separators replaced by '_', since it may be e.g.
+      "Europe/Berlin"), each "%v" with the layout variant 'variant', and each
+      "%%" with "%".
+
+      It returns FALSE if the expanded name doesn't fit in 'name'.
+
+*/
+static int expand_filename (char *name, int size, char *pattern, char *zone, char *variant)
+{
+   char *p, *v;
+   int len = 0;
+
+   for (p = pattern; *p; p++) {
+      if (*p == '%' && (p[1] == 'z' || p[1] == 'v')) {
+         v = p[1] == 'z' ? zone : variant;
+         if (len + (int) strlen(v) >= size) return FALSE;
+         for ( ; *v; v++) {
+            name[len++] = *v == END_PATH ? '_' : *v;
+         }
+         p++;
+      }
+      else {
+         if (*p == '%' && p[1] == '%') p++;
+         if (len + 1 >= size) return FALSE;
+         name[len++] = *p;
+      }
+   }
+   name[len] = '\0';
+   return TRUE;
+}
+
+#endif   /* LCAL_LIBRARY */
+
+/* ---------------------------------------------------------------------------
+
+   get_range
+
+   Notes:
+
+      This routine parses a range of months of the form "mm{/yy}{-mm{/yy}}"
+      (cf. '-r') and sets 'init_month', 'init_year', and 'num_months'
+      accordingly.
+
+      A missing starting year defaults to 'init_year'.  A missing ending
+      month means 12 months in total; a missing ending year selects the
+      first occurrence of that month at or after the starting month.  As with
+      the year parameter, 2-digit years are taken to be in the current
+      century.
+
+      It returns 'TRUE' if the range is valid and 'FALSE' otherwise.
+
+*/
+static int get_range (char *range, int century)
+{
+   int m1, y1, m2, y2, n;
+   char *p = range;
+
+   m1 = (int) strtol(p, &p, 10);
+   y1 = *p == '/' ? (int) strtol(p + 1, &p, 10) : init_year;
+   if (y1 > 0 && y1 < 100) y1 += century;
+
+   if (*p == '-') {
+      m2 = (int) strtol(p + 1, &p, 10);
+      if (*p == '/') {
+         y2 = (int) strtol(p + 1, &p, 10);
+         if (y2 > 0 && y2 < 100) y2 += century;
+      }
+      else y2 = m2 >= m1 ? y1 : y1 + 1;
+   }
+   else {
+      m2 = m1 == JAN ? DEC : m1 - 1;
+      y2 = m1 == JAN ? y1 : y1 + 1;
+   }
+
+   n = (y2 - y1) * 12 + (m2 - m1) + 1;
+
+   if (*p || m1 < JAN || m1 > DEC || m2 < JAN || m2 > DEC ||
+       n < 1 || n > MAX_MONTHS) {
+      fprintf(stderr, E_ILL_RANGE, progname, range, MAX_MONTHS);
+      return FALSE;
+   }
+
+   init_month = m1;
+   init_year = y1;
+   num_months = n;
+
+   /* the year of the last month must be valid too */
+   if (y2 > MAX_YR) {
+      fprintf(stderr, E_ILL_YEAR, progname, y2, MIN_YR, MAX_YR);
+      return FALSE;
+   }
+
+   return TRUE;
+}
+
+/* ---------------------------------------------------------------------------
+
+   get_args
+
+   Notes:
+
+      This routine walks the argument list.
+
+      This utility routine was borrowed from 'pcal'.
+
+      char **argv;        argument list 
+      int curr_pass;      current pass 
+      char *where;        for error messages 
+
+*/
+int get_args (char **argv, int curr_pass, char *where)
+{
+   char *parg, *opt;
+   flag_usage_str_typ *pflag;
+   int flag;
+   time_t curr_tyme;   /* for getting current month/year */
+   struct tm *p_tm;
+   int badopt = FALSE;   /* flag set if bad param   */
+   int nargs = 0;   /* count of non-flag args  */
+   int numargs[MAXARGS];   /* non-flag (numeric) args */
+   FILE *fp = stdout;   /* for piping "help" message */
+   static char zone_buf[STRSIZ];   /* storage for 'zones[]' */
+   static char variant_buf[STRSIZ];   /* storage for 'variants[]' */
+   int i;
+
+/*
+ * If argument follows flag (immediately or as next parameter), return
+ * pointer to it (and bump argv if necessary); else return NULL
+ */
+#define GETARG() (*(*argv + 2) ? *argv + 2 : \
+                  (*(argv+1) && **(argv+1) != '-' ? *++argv : NULL))
+
+   /* Walk argument list, ignoring first element (program name) */
+
+   while ((opt = *++argv) != NULL) {
+
+      /* Assume that any non-flag argument is a numeric argument */
+      if (*opt != '-') {
+         if (curr_pass == P_CMD1 && nargs < MAXARGS) {
+            if (! IS_NUMERIC(opt)) goto bad_par;
+            numargs[nargs++] = atoi(opt);
+         }
+         continue;
+      }
+
+      /* Check that flag is legal */
+
+      if (! (pflag = get_flag(flag = opt[1])) ) goto bad_par;
+      
+      /* get optional argument */
+      
+      parg = pflag->has_arg ? GETARG() : NULL;
+      
+      switch (flag) {
+         
+      case F_COMPR_1PAGE:
+         compressed_singlepage = TRUE;
+         break;
 
       case F_ODD_DAYS_1PAGE:
          odd_days_singlepage = TRUE;
@@ -1656,6 +2192,12 @@ int get_args (char **argv, int curr_pass, char *where)
       case F_HELP:   /* request "help" message */
       case F_USAGE:   /* request "usage" message */
       case F_VERSION:   /* request version stamp */
+         /* these would end the whole run, not just the job */
+         if (in_job) {
+            fprintf(stderr, E_JOB_FLAG, progname, flag, where);
+            badopt = TRUE;
+            break;
+         }
          /* PAGER_ENV (cf. lcaldefs.h) defines the name of an
           * environment variable which, if set, points to the
           * appropriate pager (e.g., "more", "less", "pg")
@@ -1697,6 +2239,83 @@ int get_args (char **argv, int curr_pass, char *where)
          strcpy(time_zone, parg ? parg : TIMEZONE);
          break;
          
+      case F_DATE_RANGE:   /* range of months */
+         strcpy(date_range, parg ? parg : "");
+         break;
+         
+      case F_VARIANTS:   /* generate several layout variants */
+         strcpy(variant_list, parg ? parg : "");
+         break;
+         
+      case F_QUERY:   /* print phase at given instant */
+         query_mode = TRUE;
+         strcpy(query_time, parg ? parg : "");
+         break;
+         
+      case F_ECLIPSES:   /* mark eclipses */
+         mark_eclipses = TRUE;
+         break;
+         
+      case F_LIST_ECLIPSES:   /* list eclipses of given years */
+         eclipse_mode = TRUE;
+         strcpy(eclipse_years, parg ? parg : "");
+         break;
+         
+      case F_LOCATION:   /* moonrise/moonset at given place */
+         if (!parg) rise_set = FALSE;
+         else if (!parse_location(parg)) {
+            fprintf(stderr, E_ILL_LOCATION, progname, parg);
+            badopt = TRUE;
+         }
+         else rise_set = TRUE;
+         break;
+         
+      case F_MOON_SIZES:   /* draw moons to scale */
+         moon_sizes = TRUE;
+         break;
+         
+      case F_ENGINE:   /* select phase engine */
+         strcpy(phase_engine, parg ? parg : DEFAULT_ENGINE);
+         break;
+         
+      case F_EPHEMERIS:   /* use Chebyshev ephemeris file */
+         strcpy(ephemeris_file, parg ? parg : "");
+         break;
+         
+      case F_GEN_EPHEMERIS:   /* generate Chebyshev ephemeris file */
+         strcpy(gen_ephemeris_file, parg ? parg : "");
+         break;
+         
+      case F_REPRODUCIBLE:   /* reproducible output */
+         reproducible = TRUE;
+         break;
+         
+      case F_JOBS:   /* run jobs from file */
+         strcpy(jobs_file, parg ? parg : "-");
+         break;
+         
+      case F_WORKERS:   /* number of job workers */
+         if (!parg || !IS_NUMERIC(parg) || atoi(parg) > MAX_WORKERS) {
+            fprintf(stderr, E_ILL_WORKERS, progname, parg ? parg : "");
+            badopt = TRUE;
+         }
+         else num_workers = atoi(parg);
+         break;
+         
+      case F_ASYNC:   /* asynchronous output */
+         async_output = TRUE;
+         break;
+         
+      case F_STATS:   /* statistics of the run */
+         /* a number following the flag is the year, not the file */
+         if (parg && parg == *argv && IS_NUMERIC(parg)) {
+            argv--;
+            parg = NULL;
+         }
+         stats_on = TRUE;
+         strcpy(stats_file, parg ? parg : "");
+         break;
+         
       case '-' :   /* accept - and -- as dummy flags */
       case '\0':
          break;
@@ -1734,14 +2353,826 @@ int get_args (char **argv, int curr_pass, char *where)
       init_year += 100 * ((CENTURY + p_tm->tm_year) / 100);
    }
    
+   /* a range of months overrides the year parameter */
+   if (*date_range &&
+       !get_range(date_range, 100 * ((CENTURY + p_tm->tm_year) / 100))) {
+      badopt = TRUE;
+   }
+   
    if (init_year < MIN_YR || init_year > MAX_YR) {
       fprintf(stderr, E_ILL_YEAR, progname, init_year, MIN_YR, MAX_YR);
       badopt = TRUE;
    }
    
+   /* several time zones may be given, for one calendar each */
+   if ((num_zones = split_list(time_zone, ZONE_SEP, zone_buf, zones, MAX_ZONES)) < 0) {
+      fprintf(stderr, E_ILL_ZONE, progname, time_zone);
+      badopt = TRUE;
+      num_zones = 0;
+   }
+   for (i = 0; i < num_zones; i++) {
+      if (!valid_zone(zones[i])) {
+         fprintf(stderr, E_ILL_ZONE, progname, zones[i]);
+         badopt = TRUE;
+      }
+   }
+   if (num_zones > 1 && !query_mode && !eclipse_mode && !strstr(outfile, "%z")) {
+      fprintf(stderr, E_NEED_PATTERN, progname, F_OUT_FILE, 'z', "time zone");
+      badopt = TRUE;
+   }
+   
+   /* ... and several layout variants, for one calendar each */
+   num_variants = 0;
+   if (*variant_list) {
+      if ((num_variants = split_list(variant_list, ',', variant_buf, variants, MAX_VARIANTS)) < 0) {
+         fprintf(stderr, E_ILL_VARIANT, progname, variant_list, VARIANT_FLAGS);
+         badopt = TRUE;
+         num_variants = 0;
+      }
+      for (i = 0; i < num_variants; i++) {
+         if (variants[i][strspn(variants[i], VARIANT_FLAGS)] != '\0') {
+            fprintf(stderr, E_ILL_VARIANT, progname, variants[i], VARIANT_FLAGS);
+            badopt = TRUE;
+         }
+      }
+   }
+   if (num_variants > 1 && !query_mode && !eclipse_mode && !strstr(outfile, "%v")) {
+      fprintf(stderr, E_NEED_PATTERN, progname, F_OUT_FILE, 'v', "layout variant");
+      badopt = TRUE;
+   }
+   
+   /* select the phase engine */
+   if (!set_phase_engine(phase_engine)) {
+      fprintf(stderr, E_ILL_ENGINE, progname, phase_engine, PHASE_ENGINES);
+      badopt = TRUE;
+   }
+   
    return !badopt;   /* return TRUE if OK, FALSE if error */
 }
 
+#ifndef LCAL_LIBRARY   /* (the rest is the 'lcal' program itself) */
+
+/* ---------------------------------------------------------------------------
+
+   zone_offsets
+
+   Notes:
+
+      This routine stores in 'buf' (of ZONE_OFFSETS_SIZE characters) and
+      returns the offsets from UTC (in seconds, cf. utc_offset_days()) of
+      the current time zone on the days of the months requested: the offset
+      on the first day, then "@<n>:<offset>" for each day 'n' (counting from
+      0) on which it changes.
+
+      This identifies the zone in the cache keys by its offsets rather than
+      its name, so that when the time zone database changes a zone's rules,
+      its calendars are calculated afresh rather than fetched.
+
+*/
+static char * zone_offsets (char *buf)
+{
+   char *p = buf;
+   long offset, last = 0;
+   int month = init_month, year = init_year, day, i, n = 0;
+
+   for (i = 0; i < num_months; i++) {
+      for (day = 1; day <= LENGTH_OF(month, year); day++, n++) {
+         offset = (long) floor(utc_offset_days(time_zone, month, day, year) * SECS_PER_DAY + 0.5);
+         if (n == 0) p += sprintf(p, "%ld", offset);
+         else if (offset != last) p += sprintf(p, "@%d:%ld", n, offset);
+         last = offset;
+      }
+      if (++month > DEC) {
+         month = JAN;
+         year++;
+      }
+   }
+   return buf;
+}
+
+/* ---------------------------------------------------------------------------
+
+   cache_options
+
+   Notes:
+
+      This routine stores in 'buf' (and returns) a canonical string of every
+      option which affects the calendar currently requested, for use as a
+      cache key (cf. lcalcache.c).  The time zone is given by its offsets
+      (cf. zone_offsets()), and the ephemeris file (if any) by its name,
+      size, and time of modification.
+
+*/
+static char * cache_options (char *buf)
+{
+   char offsets[ZONE_OFFSETS_SIZE];
+
+   sprintf(buf, "%s %s|%s|%s|%d|%s|%s|%s|%s|%d|%d|%d|%d/%d+%d|%s.%d.%s|%.20s%s",
+           progname, version, dayfont, titlefont, rotate, shading, zone_offsets(offsets),
+           x_offset, y_offset, draw_day_of_week_inside_moon,
+           compressed_singlepage, odd_days_singlepage, init_month, init_year,
+           num_months, phase_engine, phase_grid_used, ephemeris_id,
+           source_date ? source_date : "", mark_eclipses ? "|e" : "");
+   if (rise_set) sprintf(buf + strlen(buf), "|g%.6f/%.6f", latitude, longitude);
+   if (moon_sizes) strcat(buf, "|m");
+   return buf;
+}
+
+/* ---------------------------------------------------------------------------
+
+   get_phase_table
+
+   Notes:
+
+      This routine fills in the phase table 'tbl' for the requested months
+      in the current time zone, from the phase table cache if possible (cf.
+      lcalcache.c), and otherwise by calculating it (and caching it).
+
+      The time zone is keyed by its offsets (cf. zone_offsets()), and the
+      ephemeris file as for cache_options(); should the key not fit (e.g.
+      offsets changing very often), the table is simply not cached.
+
+*/
+static void get_phase_table (phase_table_str_typ *tbl)
+{
+   char key[PHASE_KEY_SIZE + ZONE_OFFSETS_SIZE], offsets[ZONE_OFFSETS_SIZE];
+   double t0 = STATS_CLOCK();
+
+   sprintf(key, "%d/%d+%d|%s|%d.%s.%d.%s.%d", init_month, init_year, num_months,
+           zone_offsets(offsets), PHASE_ALGO_VERSION, phase_engine, phase_grid_used,
+           ephemeris_id, moon_sizes);
+
+   if (!phase_cache_fetch(tbl, key)) {
+      calc_phase_table(tbl, init_month, init_year, num_months);
+      phase_cache_store(tbl, key);
+   }
+   STATS_ADD(STAGE_PHASES, t0);
+   return;
+}
+
+/* ---------------------------------------------------------------------------
+
+   membuf_sink
+
+   Notes:
+
+      This routine is the PostScript output sink (cf. set_ps_sink()) which
+      appends the output to the memory buffer 'ctx', growing it as needed.
+
+*/
+static int membuf_sink (void *ctx, const char *data, size_t len)
+{
+   membuf_str_typ *pm = (membuf_str_typ *) ctx;
+   char *p;
+   size_t size;
+
+   if (pm->len + len > pm->size) {
+      for (size = pm->size ? pm->size : 64 * 1024; size < pm->len + len; size *= 2)
+         ;
+      if ((p = (char *) realloc(pm->data, size)) == NULL) return 1;
+      pm->data = p;
+      pm->size = size;
+   }
+   memcpy(pm->data + pm->len, data, len);
+   pm->len += len;
+   return 0;
+}
+
+/* ---------------------------------------------------------------------------
+
+   write_calendar
+
+   Notes:
+
+      This routine writes the calendar for the phase table 'tbl' to the file
+      'fname' (or to the current output if 'fname' is NULL).  The phase table
+      is calculated here if it has not been already ('tbl->nmonths' is 0).
+
+      In reproducible mode, the calendar is copied from the cache if it is
+      there, and otherwise is written to the cache first and copied from it.
+
+      With '-A', a calendar written to a file is generated in memory and
+      then queued to be written asynchronously (cf. lcalaio.c), so that the
+      next calendar can be generated meanwhile; should the write fail later,
+      '*async_failed' is set TRUE (if not NULL) and async_flush() fails.
+
+      It returns TRUE if the calendar was written successfully.
+
+*/
+static int write_calendar (phase_table_str_typ *tbl, char *fname)
+{
+   char path[LINSIZ], options[10 * STRSIZ + ZONE_OFFSETS_SIZE];
+   membuf_str_typ mem;
+   double t0;
+   int ok;
+
+   if (reproducible && cache_path(path, cache_options(options))) {
+      t0 = STATS_CLOCK();
+      ok = cache_fetch(path, fname);
+      STATS_ADD(STAGE_FLUSH, t0);
+      if (ok) return TRUE;
+
+      if (cache_begin(path)) {
+         if (tbl->nmonths == 0) get_phase_table(tbl);
+         write_psfile(tbl);
+         t0 = STATS_CLOCK();
+         ok = fflush(stdout) == 0 && !ferror(stdout);
+         cache_end(path, ok);
+         ok = ok && cache_fetch(path, fname);
+         STATS_ADD(STAGE_FLUSH, t0);
+         if (ok) return TRUE;
+      }
+      /* no luck with the cache - just write the calendar as usual */
+   }
+
+   if (fname && async_output) {
+      if (tbl->nmonths == 0) get_phase_table(tbl);
+      memset(&mem, 0, sizeof(mem));
+      set_ps_sink(membuf_sink, &mem);
+      write_psfile(tbl);
+      ok = !ps_sink_error();
+      set_ps_sink(NULL, NULL);
+      if (!ok) {
+         free(mem.data);
+         fprintf(stderr, E_ALLOC_ERR, progname);
+         return FALSE;
+      }
+      t0 = STATS_CLOCK();
+      ok = async_write_file(fname, mem.data, mem.len, async_failed);
+      STATS_ADD(STAGE_FLUSH, t0);
+      return ok;
+   }
+
+   if (fname && freopen(fname, "w", stdout) == (FILE *) NULL) {
+      fprintf(stderr, E_FOPEN_ERR, progname, fname);
+      return FALSE;
+   }
+   if (tbl->nmonths == 0) get_phase_table(tbl);
+   write_psfile(tbl);
+   t0 = STATS_CLOCK();
+   ok = fflush(stdout) == 0 && !ferror(stdout);
+   STATS_ADD(STAGE_FLUSH, t0);
+   return ok;
+}
+
+/* ---------------------------------------------------------------------------
+
+   write_variants
+
+   Notes:
+
+      This routine writes the calendar for the phase table 'tbl' in each of
+      the layout variants requested via '-V' (or just once, as specified by
+      the other options, if there are none).  Each variant is a string of
+      layout flags (cf. VARIANT_FLAGS) applied on top of the other options.
+
+      If 'to_file' is TRUE, each calendar is written to the output file name
+      pattern (cf. expand_filename()) for time zone 'zone' and its variant.
+
+      Under Unix, the variants are written in parallel by child processes,
+      all sharing the phase table calculated by the parent.
+
+      It returns TRUE if all the calendars were written successfully.
+
+*/
+static int write_variants (phase_table_str_typ *tbl, char *zone, int to_file)
+{
+   static char *no_variants[1] = { "" };
+   char **vlist = num_variants ? variants : no_variants;
+   int nv = num_variants ? num_variants : 1;
+   int save_rotate = rotate;
+   int save_compressed = compressed_singlepage;
+   int save_odd_days = odd_days_singlepage;
+   int save_weekdays = draw_day_of_week_inside_moon;
+   char fname[LINSIZ], *p;
+   int i, ok = TRUE;
+#ifdef BUILD_ENV_UNIX
+   pid_t pid;
+   int status, nchildren = 0;
+   double t0, t1;
+#endif
+
+   /* calculate the phase table once for all the variants (a single calendar
+      may not need it at all, if it comes from the cache) */
+   if (nv > 1 && tbl->nmonths == 0) get_phase_table(tbl);
+
+   for (i = 0; i < nv; i++) {
+
+      /* apply the variant's layout flags, as for get_args() */
+      rotate = save_rotate;
+      compressed_singlepage = save_compressed;
+      odd_days_singlepage = save_odd_days;
+      draw_day_of_week_inside_moon = save_weekdays;
+
+      for (p = vlist[i]; *p; p++) {
+         switch (*p) {
+         case F_LANDSCAPE:
+            rotate = LANDSCAPE;
+            break;
+         case F_PORTRAIT:
+            rotate = PORTRAIT;
+            break;
+         case F_COMPR_1PAGE:
+            compressed_singlepage = TRUE;
+            break;
+         case F_ODD_DAYS_1PAGE:
+            odd_days_singlepage = TRUE;
+            compressed_singlepage = FALSE;
+            break;
+         case F_WEEKDAYS:
+            draw_day_of_week_inside_moon = !(WEEKDAYS);
+            break;
+         }
+      }
+
+      /* (a single output file, written asynchronously, is never a pattern) */
+      if (to_file && num_zones <= 1 && num_variants <= 1) strcpy(fname, outfile);
+      else if (to_file && !expand_filename(fname, sizeof(fname), outfile, zone, vlist[i])) {
+         fprintf(stderr, E_FNAME_TOO_LONG, progname, outfile, (int) sizeof(fname) - 1);
+         ok = FALSE;
+         continue;
+      }
+
+#ifdef BUILD_ENV_UNIX
+      if (nv > 1) {
+         fflush(stdout);
+         stats_merge();   /* (so the child starts from nothing) */
+         trace_flush();
+         if ((pid = fork()) == 0) {
+            trace_thread("variant");
+            t0 = STATS_CLOCK();
+            ok = write_calendar(tbl, to_file ? fname : NULL);
+            t1 = STATS_CLOCK();
+            if (!async_flush()) ok = FALSE;
+            STATS_ADD(STAGE_FLUSH, t1);
+            if (trace_on) trace_span("variant", t0, stats_clock(), vlist[i]);
+            stats_merge();
+            trace_flush();
+            exit(ok ? EXIT_SUCCESS : EXIT_FAILURE);
+         }
+         if (pid > 0) {
+            nchildren++;
+            continue;
+         }
+         /* couldn't fork - write this variant ourselves */
+      }
+#endif
+      if (!write_calendar(tbl, to_file ? fname : NULL)) ok = FALSE;
+   }
+
+#ifdef BUILD_ENV_UNIX
+   while (nchildren-- > 0) {
+      if (wait(&status) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS) {
+         ok = FALSE;
+      }
+   }
+#endif
+
+   rotate = save_rotate;
+   compressed_singlepage = save_compressed;
+   odd_days_singlepage = save_odd_days;
+   draw_day_of_week_inside_moon = save_weekdays;
+
+   return ok;
+}
+
+/* ---------------------------------------------------------------------------
+
+   generate
+
+   Notes:
+
+      This routine does whatever the options parsed by 'get_args()' ask
+      for: it generates the calendar(s), or the phase at a given instant, or
+      the eclipses of given years, or the ephemeris file.
+
+      It returns TRUE if everything was written successfully.
+
+*/
+static int generate (void)
+{
+   static phase_table_str_typ phase_tbl;
+   static ephemeris_str_typ ephemeris;
+   static char eph_loaded[2 * STRSIZ] = "";
+   phase_grid_str_typ phase_grid;
+   char eph_id[2 * STRSIZ];
+   int i, one_file, async_file, ok = TRUE;
+   double t0;
+
+   /* done with the arguments and flags - try to open the output file
+      (unless there is one per time zone or layout variant, or the calendar
+      is to be written to it asynchronously) */
+   
+   one_file = num_zones <= 1 && num_variants <= 1;
+   async_file = async_output && *outfile && one_file && !query_mode && !eclipse_mode &&
+      !*gen_ephemeris_file;
+   
+   if (*outfile && one_file && !async_file && freopen(outfile, "w", stdout) == (FILE *) NULL) {
+      fprintf(stderr, E_FOPEN_ERR, progname, outfile);
+      return FALSE;
+   }
+   
+   /* generate the Chebyshev ephemeris file if requested (and nothing else) */
+   if (*gen_ephemeris_file) {
+      if (!write_ephemeris(gen_ephemeris_file)) {
+         fprintf(stderr, E_FOPEN_ERR, progname, gen_ephemeris_file);
+         return FALSE;
+      }
+      return fflush(stdout) == 0;
+   }
+   
+   /* calculate the moon's age from the Chebyshev ephemeris file if given
+      (loading it only once for any number of jobs using it) */
+   use_ephemeris(NULL);
+   *ephemeris_id = '\0';
+   if (*ephemeris_file) {
+      sprintf(eph_id, "%s|%s", ephemeris_file, phase_engine_name());
+      if (strcmp(eph_id, eph_loaded) != 0) {
+         if (!load_ephemeris(&ephemeris, ephemeris_file)) {
+            fprintf(stderr, E_ILL_EPHEM, progname, ephemeris_file);
+            *eph_loaded = '\0';
+            return FALSE;
+         }
+         strcpy(eph_loaded, eph_id);
+      }
+      use_ephemeris(&ephemeris);
+      sprintf(ephemeris_id, "%s:%lld:%lld", ephemeris_file, ephemeris.file_size,
+              ephemeris.file_mtime);
+   }
+   
+   /* if only the phase at a given instant was requested, skip all the
+      PostScript setup */
+   if (query_mode) {
+      ok = query_phase(query_time);
+      return fflush(stdout) == 0 && ok;
+   }
+   
+   /* ... or only the eclipses */
+   if (eclipse_mode) {
+      ok = list_eclipses(eclipse_years);
+      return fflush(stdout) == 0 && ok;
+   }
+   
+   /* with several time zones, calculate the moon's position once on a fine
+      grid and just interpolate it for each zone (but not with '-m', which
+      needs the moon's distance each day anyway) */
+   phase_grid_used = FALSE;
+   t0 = STATS_CLOCK();
+   if (num_zones > PHASE_GRID_MIN && !moon_sizes &&
+       calc_phase_grid(&phase_grid, init_month, init_year, num_months)) {
+      use_phase_grid(&phase_grid);
+      phase_grid_used = TRUE;
+   }
+   STATS_ADD(STAGE_PHASES, t0);
+   
+   /* calculate the moon phases and generate the PostScript code (in each
+      layout variant) for each time zone in turn */
+   for (i = 0; i < num_zones; i++) {
+      strcpy(time_zone, zones[i]);
+      phase_tbl.nmonths = 0;   /* calculated when first needed */
+      if (!write_variants(&phase_tbl, zones[i], !one_file || async_file)) ok = FALSE;
+   }
+   
+   if (phase_grid_used) {
+      use_phase_grid(NULL);
+      free(phase_grid.age);
+   }
+
+   return ok;
+}
+
+/* ---------------------------------------------------------------------------
+
+   save_options, restore_options
+
+   Notes:
+
+      These routines save the options which a job may change into 'po', and
+      restore them from it, so that each job (cf. run_jobs()) starts with
+      the options given on the command line.
+
+*/
+static void save_options (options_str_typ *po)
+{
+   po->rotate = rotate;
+   strcpy(po->dayfont, dayfont);
+   strcpy(po->titlefont, titlefont);
+   strcpy(po->outfile, outfile);
+   strcpy(po->x_offset, x_offset);
+   strcpy(po->y_offset, y_offset);
+   po->draw_day_of_week_inside_moon = draw_day_of_week_inside_moon;
+   strcpy(po->shading, shading);
+   strcpy(po->time_zone, time_zone);
+   strcpy(po->variant_list, variant_list);
+   strcpy(po->date_range, date_range);
+   po->query_mode = query_mode;
+   strcpy(po->query_time, query_time);
+   po->mark_eclipses = mark_eclipses;
+   po->eclipse_mode = eclipse_mode;
+   strcpy(po->eclipse_years, eclipse_years);
+   po->rise_set = rise_set;
+   po->moon_sizes = moon_sizes;
+   po->latitude = latitude;
+   po->longitude = longitude;
+   strcpy(po->phase_engine, phase_engine);
+   strcpy(po->ephemeris_file, ephemeris_file);
+   strcpy(po->gen_ephemeris_file, gen_ephemeris_file);
+   po->reproducible = reproducible;
+   po->async_output = async_output;
+   po->compressed_singlepage = compressed_singlepage;
+   po->odd_days_singlepage = odd_days_singlepage;
+   po->init_month = init_month;
+   po->num_months = num_months;
+   return;
+}
+
+static void restore_options (options_str_typ *po)
+{
+   rotate = po->rotate;
+   strcpy(dayfont, po->dayfont);
+   strcpy(titlefont, po->titlefont);
+   strcpy(outfile, po->outfile);
+   strcpy(x_offset, po->x_offset);
+   strcpy(y_offset, po->y_offset);
+   draw_day_of_week_inside_moon = po->draw_day_of_week_inside_moon;
+   strcpy(shading, po->shading);
+   strcpy(time_zone, po->time_zone);
+   strcpy(variant_list, po->variant_list);
+   strcpy(date_range, po->date_range);
+   query_mode = po->query_mode;
+   strcpy(query_time, po->query_time);
+   mark_eclipses = po->mark_eclipses;
+   eclipse_mode = po->eclipse_mode;
+   strcpy(eclipse_years, po->eclipse_years);
+   rise_set = po->rise_set;
+   moon_sizes = po->moon_sizes;
+   latitude = po->latitude;
+   longitude = po->longitude;
+   strcpy(phase_engine, po->phase_engine);
+   strcpy(ephemeris_file, po->ephemeris_file);
+   strcpy(gen_ephemeris_file, po->gen_ephemeris_file);
+   reproducible = po->reproducible;
+   async_output = po->async_output;
+   compressed_singlepage = po->compressed_singlepage;
+   odd_days_singlepage = po->odd_days_singlepage;
+   init_month = po->init_month;
+   num_months = po->num_months;
+   return;
+}
+
+/* ---------------------------------------------------------------------------
+
+   run_job
+
+   Notes:
+
+      This routine runs one job, i.e. the line of flags (and year) 'line',
+      with the options 'pdefault' as its defaults.  'where' identifies the
+      line in error messages.
+
+      Every job must name its own output file, as the output of all jobs
+      would otherwise be mixed up on stdout.  The help and version flags
+      are refused, and stdout is restored after the job, so that nothing
+      it writes can end up in the next job's file.
+
+      It returns TRUE if the job ran successfully.
+
+*/
+static int run_job (char *line, options_str_typ *pdefault, char *where)
+{
+   char buf[STRSIZ + LINSIZ], *jwords[LINSIZ / 2 + 2];   /* (enough words for any line) */
+   char save_stats_file[STRSIZ];
+   double t0 = STATS_CLOCK();
+   int save_stats_on = stats_on, ok;
+#ifdef BUILD_ENV_UNIX
+   int save_fd;
+#endif
+
+   restore_options(pdefault);
+   *jobs_file = '\0';
+   strcpy(save_stats_file, stats_file);
+   stats_on = FALSE;
+
+   sprintf(buf, "%s %.*s", progname, LINSIZ - 1, line);
+   (void) loadwords(jwords, buf);
+   in_job = TRUE;
+   ok = get_args(jwords, P_CMD1, where);
+   in_job = FALSE;
+
+   /* '-J' and '-T' apply to the whole run, not to a job */
+   if (ok && *jobs_file) {
+      fprintf(stderr, E_FLAG_IGNORED, progname, F_JOBS, "", where);
+   }
+   if (ok && stats_on) {
+      fprintf(stderr, E_FLAG_IGNORED, progname, F_STATS, "", where);
+   }
+   stats_on = save_stats_on;
+   strcpy(stats_file, save_stats_file);
+   STATS_ADD(STAGE_ARGS, t0);
+   if (!ok) return FALSE;
+   if (!*outfile && !*gen_ephemeris_file) {
+      fprintf(stderr, E_JOB_NO_FILE, progname, F_OUT_FILE, where);
+      return FALSE;
+   }
+
+#ifdef BUILD_ENV_UNIX
+   fflush(stdout);
+   save_fd = dup(STDOUT_FILENO);
+#endif
+   ok = generate();
+#ifdef BUILD_ENV_UNIX
+   fflush(stdout);
+   if (save_fd >= 0) {
+      (void) dup2(save_fd, STDOUT_FILENO);
+      close(save_fd);
+   }
+#endif
+   return ok;
+}
+
+/* ---------------------------------------------------------------------------
+
+   run_jobs
+
+   Notes:
+
+      This routine runs each job listed in the file 'jobs_name' ("-" for
+      stdin): one job per line, written as the flags (and year) of an
+      'lcal' command line.  Blank lines and lines beginning with JOB_COMMENT
+      are skipped.
+
+      The flags given on the command line (and in LCAL_OPTS) apply to every
+      job, unless the job overrides them.
+
+      A status line ("<file>:<line>: ok|FAILED <command>") is written to
+      stdout for each job as it finishes, and a summary of the failures, if
+      any, to stderr at the end.  (With '-A', a job whose output file turns
+      out not to be writable only after its status line is counted in the
+      summary.)
+
+      Under Unix, the jobs are shared among 'num_workers' child processes
+      (by default one per processor), each taking the next job not yet
+      taken as soon as it is free.  A job left unfinished by a worker which
+      crashes counts as failed.
+
+      It returns TRUE if all the jobs ran successfully.
+
+*/
+static int run_jobs (char *jobs_name)
+{
+   options_str_typ defaults;
+   FILE *fp, *status_fp = stdout;
+   double t0;
+   char name[STRSIZ], line[LINSIZ], where[2 * STRSIZ], *p, **jobs = NULL;
+   char *failed, *write_failed;
+   int *lineno = NULL, *next_job, njobs = 0, maxjobs = 0, nfailed, n, i;
+#ifdef BUILD_ENV_UNIX
+   void *shared;
+   int status, nchildren = 0, worker = FALSE, w;
+#endif
+
+   strcpy(name, jobs_name);   /* (each job resets 'jobs_file') */
+
+   if (strcmp(name, "-") == 0) fp = stdin;
+   else if ((fp = fopen(name, "r")) == NULL) {
+      fprintf(stderr, E_FOPEN_ERR, progname, name);
+      return FALSE;
+   }
+
+   /* read all the jobs first (stdin may be a pipe) */
+   for (n = 1; fgets(line, sizeof(line), fp) != NULL; n++) {
+      if ((p = strchr(line, '\n')) != NULL) *p = '\0';
+      else if (!feof(fp)) {   /* (rather than split it into two jobs) */
+         fprintf(stderr, E_JOB_TOO_LONG, progname, name, n, (int) sizeof(line) - 2);
+         if (fp != stdin) fclose(fp);
+         return FALSE;
+      }
+      p = line + strspn(line, WHITESPACE);
+      if (*p == '\0' || *p == JOB_COMMENT) continue;
+
+      if (njobs == maxjobs) {
+         maxjobs = maxjobs ? 2 * maxjobs : 256;
+         if ((jobs = (char **) realloc(jobs, maxjobs * sizeof(char *))) == NULL ||
+             (lineno = (int *) realloc(lineno, maxjobs * sizeof(int))) == NULL) {
+            fprintf(stderr, E_ALLOC_ERR, progname);
+            return FALSE;
+         }
+      }
+      if ((jobs[njobs] = (char *) malloc(strlen(p) + 1)) == NULL) {
+         fprintf(stderr, E_ALLOC_ERR, progname);
+         return FALSE;
+      }
+      strcpy(jobs[njobs], p);
+      lineno[njobs++] = n;
+   }
+   if (fp != stdin) fclose(fp);
+
+   save_options(&defaults);
+
+#ifdef BUILD_ENV_UNIX
+   /* the status lines go to the original stdout, which each job redirects
+      to its own output file */
+   fflush(stdout);
+   if ((i = dup(STDOUT_FILENO)) < 0 || (status_fp = fdopen(i, "w")) == NULL) {
+      status_fp = stderr;
+   }
+   setvbuf(status_fp, NULL, _IOLBF, 0);
+
+   if (num_workers == 0 && (num_workers = (int) sysconf(_SC_NPROCESSORS_ONLN)) < 1) {
+      num_workers = 1;
+   }
+   if (num_workers > njobs) num_workers = njobs;
+
+   /* the index of the next job to run, and the failed jobs (and those
+      whose output could not be written later, cf. '-A'), are shared by all
+      the workers */
+   shared = mmap(NULL, sizeof(int) + 2 * njobs + 1, PROT_READ | PROT_WRITE,
+                 MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+   if (shared == MAP_FAILED) {
+      fprintf(stderr, E_ALLOC_ERR, progname);
+      return FALSE;
+   }
+   next_job = (int *) shared;
+   failed = (char *) shared + sizeof(int);
+#else
+   if ((next_job = (int *) malloc(sizeof(int) + 2 * njobs + 1)) == NULL) {
+      fprintf(stderr, E_ALLOC_ERR, progname);
+      return FALSE;
+   }
+   failed = (char *) (next_job + 1);
+   status_fp = stderr;
+#endif
+
+   write_failed = failed + njobs;
+
+   *next_job = 0;
+   memset(failed, TRUE, njobs);   /* until it has run successfully */
+   memset(write_failed, FALSE, njobs);
+
+#ifdef BUILD_ENV_UNIX
+   stats_merge();   /* (so the workers start from nothing) */
+   trace_flush();
+   for (w = 0; num_workers > 1 && w < num_workers && !worker; w++) {
+      switch (fork()) {
+      case 0:
+         worker = TRUE;
+         trace_thread("worker");
+         break;
+      case -1:
+         break;
+      default:
+         nchildren++;
+         break;
+      }
+   }
+   if (worker || nchildren == 0)
+#endif
+   {
+      /* run jobs until there are none left */
+      for (;;) {
+#ifdef BUILD_ENV_UNIX
+         i = __sync_fetch_and_add(next_job, 1);
+#else
+         i = (*next_job)++;
+#endif
+         if (i >= njobs) break;
+
+         sprintf(where, "%.*s:%d", STRSIZ, name, lineno[i]);
+         async_failed = &write_failed[i];
+         t0 = STATS_CLOCK();
+         failed[i] = !run_job(jobs[i], &defaults, where);
+         if (trace_on) trace_span("job", t0, stats_clock(), jobs[i]);
+         fprintf(status_fp, "%s: %s %s\n", where, failed[i] || write_failed[i] ? "FAILED" : "ok",
+                 jobs[i]);
+      }
+      t0 = STATS_CLOCK();
+      (void) async_flush();   /* (failures are marked in 'write_failed') */
+      STATS_ADD(STAGE_FLUSH, t0);
+#ifdef BUILD_ENV_UNIX
+      if (worker) {
+         fflush(stdout);
+         stats_merge();
+         trace_flush();
+         _exit(EXIT_SUCCESS);
+      }
+#endif
+   }
+
+#ifdef BUILD_ENV_UNIX
+   while (nchildren-- > 0) {
+      (void) wait(&status);
+   }
+#endif
+
+   for (nfailed = i = 0; i < njobs; i++) {
+      if (failed[i] || write_failed[i]) nfailed++;
+   }
+   if (nfailed) {
+      fprintf(stderr, E_JOBS_FAILED, progname, nfailed, njobs);
+   }
+   return nfailed == 0;
+}
+
 /* ---------------------------------------------------------------------------
 
    main
@@ -1760,20 +3191,26 @@ int get_args (char **argv, int curr_pass, char *where)
 */
 int main (int argc GCC_UNUSED, char **argv)
 {
-   char *p, tmp[STRSIZ];
-   
-   /* extract root program name and program path */
-   
-   strcpy(progname, **argv ? *argv : "lcal");
-   
-   if ((p = strrchr(progname, END_PATH)) != NULL) strcpy(progname, ++p);
-   if ((p = strchr(progname, '.')) != NULL) *p = '\0';
+   char *p;
+   double t_start, t0;
+   int ok;
+   
+   t_start = stats_clock();   /* (in case of '-T', which isn't known yet) */
+   init_names(*argv);
+   
+   /* the environment variable LCAL_STATS requests statistics like '-T'
+      (which overrides it) */
+   if ((p = getenv(LCAL_STATS_ENV)) != NULL) {
+      stats_on = TRUE;
+      sprintf(stats_file, "%.*s", STRSIZ - 1, p);
+   }
 
-   /* get version from VERSION_STRING (for use in PostScript comment) */
-   strcpy(tmp, VERSION_STRING + 4);
-   p = strchr(tmp, ' ') + 1;   /* skip program name */
-   *strchr(p, ' ') = '\0';   /* terminate after version */
-   strcpy(version, p);
+   /* the environment variable LCAL_TRACE names a file to write a trace of
+      the run to (cf. lcaltrace.c) */
+   if ((p = getenv(LCAL_TRACE_ENV)) != NULL && *p && !trace_begin(p)) {
+      fprintf(stderr, E_FOPEN_ERR, progname, p);
+      exit(EXIT_FAILURE);
+   }
    
    /*
     * Get the arguments from a) the environment variable, b) the command line
@@ -1791,6 +3228,13 @@ int main (int argc GCC_UNUSED, char **argv)
       }
    }
 
+   /* a SOURCE_DATE_EPOCH timestamp implies reproducible output */
+
+   if ((p = getenv(SOURCE_DATE_ENV)) != NULL && IS_NUMERIC(p) && *p) {
+      source_date = p;
+      reproducible = TRUE;
+   }
+
    /* parse command-line arguments once to find name of moon file, etc. */
    
    if (!get_args(argv, P_CMD1, NULL)) {
@@ -1798,15 +3242,22 @@ int main (int argc GCC_UNUSED, char **argv)
       exit(EXIT_FAILURE);
    }
    
-   /* done with the arguments and flags - try to open the output file */
-   
-   if (*outfile && freopen(outfile, "w", stdout) == (FILE *) NULL) {
-      fprintf(stderr, E_FOPEN_ERR, progname, outfile);
-      exit(EXIT_FAILURE);
+   STATS_ADD(STAGE_ARGS, t_start);
+   if (stats_on) stats_begin(t_start);
+
+   /* run the jobs in the job file, if any, with the options given so far
+      as the defaults for each */
+   if (*jobs_file) ok = run_jobs(jobs_file);
+   else {
+      ok = generate();
+      t0 = STATS_CLOCK();
+      if (!async_flush()) ok = FALSE;   /* (wait for the files being written) */
+      STATS_ADD(STAGE_FLUSH, t0);
    }
-   
-   /* generate the PostScript code */
-   write_psfile(init_year);
-   
-   exit(EXIT_SUCCESS);
+
+   if (stats_on && !stats_report(stats_file)) ok = FALSE;
+   if (!trace_end()) ok = FALSE;
+   exit(ok ? EXIT_SUCCESS : EXIT_FAILURE);
 }
+
+#endif   /* LCAL_LIBRARY */
@@ -0,0 +1,461 @@
+/* ---------------------------------------------------------------------------
+
+   lcalacc.c
+
+   Notes:
+
+      This program measures the accuracy of the moon phases which 'lcal'
+      prints, as calculated by 'calc_phase()' with each phase engine --
+      directly, interpolated from the phase grid (as for several time
+      zones, cf. calc_phase_grid()), and from each Chebyshev ephemeris file
+      given with '-E' -- against the Meeus engine's truncated ELP-2000/82
+      series (cf. lcalmeeus.c), evaluated for the same instants.  That is
+      not an independent ephemeris but one of the engines: it is good to
+      about 0.01 degrees, or some 30 times better than the 3 decimals
+      printed, so the errors of the other engines are measured well enough,
+      but the Meeus engine's own phases (directly or from the grid) would
+      only be compared with themselves, and are left out.  An ephemeris
+      fitted to it is measured, i.e. the error of the fit.  It is built and
+      run by "make accuracy", and is not installed.
+
+      Every day of the years given by '-y' (by default MIN_YR .. MAX_YR) is
+      compared, and for each way of calculating the phases, the maximum,
+      mean, and percentiles of the error are reported (in thousandths of a
+      cycle, i.e. in units of the last digit printed, which is about 42.5
+      minutes), with the day of the maximum, and the number of days on
+      which the calendar would differ: those whose phase is printed
+      differently (cf. fmt_phase()), and those whose moon is drawn as
+      another shape -- a crescent or gibbous moon, waxing or waning, or a
+      full moon (within 0.01 of it; cf. '/domoon' in lcal.c).
+
+      The results are printed as a table and, with '-o', written as JSON
+      (to stdout if "-"), so that the cheapest way of calculating the phases
+      whose calendars are identical (or close enough) can be chosen.
+
+      The phases are calculated for the time zone given by '-z' (as for
+      'lcal'; by default ACC_TIMEZONE, i.e. UTC+5:30).  In a zone whose
+      offset is always a multiple of PHASE_GRID_STEP days (as UTC itself),
+      the days fall on the samples of the phase grid, whose interpolation is
+      then exact, so the phases from the grid are not measured.
+
+      Usage: lcalacc [-o FILE] [-y FIRST[-LAST]] [-z ZONE] [-E EPHEMERIS ...]
+
+      Note that far from the present, the moontool model (which takes no
+      account of Delta T) departs from the reference by up to hours, as
+      the length of the day is extrapolated.
+
+*/
+
+/* ---------------------------------------------------------------------------
+
+   Header Files
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+/*
+ * Lcal-specific definitions:
+ */
+#include "lcaldefs.h"
+
+/* ---------------------------------------------------------------------------
+
+   Constant Declarations
+
+*/
+
+#define MAX_EPHEMERIDES	4	/* -E */
+#define MAX_PATHS	(2 * 3 + MAX_EPHEMERIDES)
+
+#define ERR_UNIT	1E-3	/* errors are reported in thousandths */
+#define FULL_BAND	0.01	/* drawn as a full moon within this (cf. '/domoon') */
+#define SHAPE_FULL	4	/* (cf. shape()) */
+
+#define NUM_PCTS	4	/* cf. pcts[] */
+
+#define ACC_TIMEZONE	"-5.5"	/* (off the phase grid's samples) */
+#define REF_NAME	"Meeus truncated series"
+
+/* ---------------------------------------------------------------------------
+
+   Type, Struct, & Enum Declarations
+
+*/
+
+/* a way of calculating the phases, and its errors */
+typedef struct {
+   char name[STRSIZ];
+   char engine[STRSIZ];
+   int grid;   /* interpolated from the phase grid */
+   char *eph_file;   /* ... or from this ephemeris */
+   double max, mean, pct[NUM_PCTS];
+   long max_day;   /* (index) */
+   long printed, shapes;   /* days changed */
+} acc_path_str_typ;
+
+/* ---------------------------------------------------------------------------
+
+   Data Declarations (including externals)
+
+*/
+
+static char *engine_names[] = { "moontool", "fast", "meeus" };   /* (cf. moonphas.c) */
+#define NUM_ENGINE_NAMES	((int) (sizeof(engine_names) / sizeof(engine_names[0])))
+#define REF_ENGINE	"meeus"
+
+static double pcts[NUM_PCTS] = { 50.0, 90.0, 99.0, 99.9 };
+
+static acc_path_str_typ paths[MAX_PATHS];
+static int num_paths = 0;
+
+static int first_year = MIN_YR, last_year = MAX_YR;   /* -y */
+static char *json_file = NULL;   /* -o */
+
+static long num_days;
+static int on_grid;   /* TRUE if every day falls on a grid sample */
+static double *ref_phase;   /* the reference phase of each day */
+static float *errors;   /* (scratch, for the percentiles) */
+
+/* ---------------------------------------------------------------------------
+
+   shape
+
+   Notes:
+
+      This routine returns the shape in which the moon is drawn for the
+      phase printed as 'printed': 0 .. 3 for a waxing crescent, waxing
+      gibbous, waning gibbous, and waning crescent moon, or SHAPE_FULL.
+
+*/
+static int shape (char *printed)
+{
+   double phase = atof(printed);
+   int q;
+
+   if (phase >= 0.5 - FULL_BAND && phase <= 0.5 + FULL_BAND) return SHAPE_FULL;
+   q = (int) (phase * 4);
+   return q > 3 ? 3 : q;
+}
+
+/* ---------------------------------------------------------------------------
+
+   day_date
+
+   Notes:
+
+      This routine returns the date ("yyyy-mm-dd") of the day with the index
+      'k' (cf. calc_ref()).
+
+*/
+static char * day_date (long k)
+{
+   static char buf[40];
+   int y, m;
+
+   for (y = first_year; k >= YEAR_LEN(y); y++) k -= YEAR_LEN(y);
+   for (m = JAN; k >= LENGTH_OF(m, y); m++) k -= LENGTH_OF(m, y);
+   sprintf(buf, "%04d-%02d-%02ld", y, m, k + 1);
+   return buf;
+}
+
+/* ---------------------------------------------------------------------------
+
+   calc_ref
+
+   Notes:
+
+      This routine calculates the reference phase of every day, for the
+      same instants as calc_phase() (noting whether they all fall on the
+      samples of the phase grid), and returns FALSE if there's not enough
+      memory.
+
+*/
+static int calc_ref (void)
+{
+   double pdate, x;
+   long k;
+   int y, m, d;
+
+   for (num_days = 0, y = first_year; y <= last_year; y++) num_days += YEAR_LEN(y);
+   if ((ref_phase = (double *) malloc(num_days * sizeof(double))) == NULL ||
+       (errors = (float *) malloc(num_days * sizeof(float))) == NULL) {
+      return FALSE;
+   }
+
+   on_grid = TRUE;
+   for (k = 0, y = first_year; y <= last_year; y++) {
+      for (m = JAN; m <= DEC; m++) {
+         for (d = 1; d <= LENGTH_OF(m, y); d++) {
+            pdate = (double) jdn(m, d, y) + utc_offset_days(time_zone, m, d, y);
+            x = pdate / PHASE_GRID_STEP;
+            if (fabs(x - floor(x + 0.5)) > 1E-9) on_grid = FALSE;
+            ref_phase[k++] = fmod(fmod(meeus_age(pdate), 360.0) + 360.0, 360.0) / 360.0;
+         }
+      }
+   }
+   return TRUE;
+}
+
+/* ---------------------------------------------------------------------------
+
+   cmp_float
+
+   Notes:
+
+      This routine compares 2 floats for 'qsort()'.
+
+*/
+static int cmp_float (const void *a, const void *b)
+{
+   float x = *(const float *) a, y = *(const float *) b;
+
+   return x < y ? -1 : x > y;
+}
+
+/* ---------------------------------------------------------------------------
+
+   measure
+
+   Notes:
+
+      This routine calculates the phase of every day as 'pp' says, and
+      fills in its errors.  It returns FALSE if the phase grid or the
+      ephemeris can't be set up.
+
+*/
+static int measure (acc_path_str_typ *pp)
+{
+   static ephemeris_str_typ eph;
+   phase_grid_str_typ grid;
+   char got[16], want[16];
+   double phase, err, total = 0.0;
+   long k;
+   int y, m, d, i;
+
+   set_phase_engine(pp->engine);
+   if (pp->eph_file) {
+      if (!load_ephemeris(&eph, pp->eph_file)) return FALSE;
+      use_ephemeris(&eph);
+   }
+
+   pp->max = 0.0;
+   pp->max_day = 0;
+   pp->printed = pp->shapes = 0;
+
+   for (k = 0, y = first_year; y <= last_year; y++) {
+      if (pp->grid) {
+         if (!calc_phase_grid(&grid, JAN, y, NUM_MONTHS)) return FALSE;
+         use_phase_grid(&grid);
+      }
+
+      for (m = JAN; m <= DEC; m++) {
+         for (d = 1; d <= LENGTH_OF(m, y); d++, k++) {
+            phase = calc_phase(m, d, y);
+
+            /* (the error is taken around the cycle) */
+            err = fabs(phase - ref_phase[k]);
+            if (err > 0.5) err = 1.0 - err;
+            errors[k] = (float) (err / ERR_UNIT);
+            total += err;
+            if (err > pp->max) {
+               pp->max = err;
+               pp->max_day = k;
+            }
+
+            *fmt_phase(got, phase) = '\0';
+            *fmt_phase(want, ref_phase[k]) = '\0';
+            if (strcmp(got, want) != 0) {
+               pp->printed++;
+               if (shape(got) != shape(want)) pp->shapes++;
+            }
+         }
+      }
+
+      if (pp->grid) {
+         use_phase_grid(NULL);
+         free(grid.age);
+      }
+   }
+   use_ephemeris(NULL);
+   set_phase_engine(DEFAULT_ENGINE);
+
+   pp->max /= ERR_UNIT;
+   pp->mean = total / num_days / ERR_UNIT;
+   qsort(errors, num_days, sizeof(float), cmp_float);
+   for (i = 0; i < NUM_PCTS; i++) {
+      pp->pct[i] = errors[(long) floor(pcts[i] / 100.0 * (num_days - 1) + 0.5)];
+   }
+   return TRUE;
+}
+
+/* ---------------------------------------------------------------------------
+
+   add_path
+
+   Notes:
+
+      This routine adds a way of calculating the phases to measure.
+
+*/
+static void add_path (char *engine, int grid, char *eph_file)
+{
+   acc_path_str_typ *pp = &paths[num_paths++];
+
+   strcpy(pp->engine, engine);
+   pp->grid = grid;
+   pp->eph_file = eph_file;
+   if (eph_file) sprintf(pp->name, "%s eph %.*s", engine, STRSIZ / 2, eph_file);
+   else sprintf(pp->name, "%s%s", engine, grid ? " grid" : "");
+   return;
+}
+
+/* ---------------------------------------------------------------------------
+
+   eph_engine
+
+   Notes:
+
+      This routine returns the name of the phase engine the ephemeris file
+      'name' was generated with, or NULL if it can't be loaded.
+
+*/
+static char * eph_engine (char *name)
+{
+   ephemeris_str_typ eph;
+   int e;
+
+   memset(&eph, 0, sizeof(eph));
+   for (e = 0; e < NUM_ENGINE_NAMES; e++) {
+      set_phase_engine(engine_names[e]);
+      if (load_ephemeris(&eph, name)) break;
+   }
+   unload_ephemeris(&eph);
+   set_phase_engine(DEFAULT_ENGINE);
+   return e < NUM_ENGINE_NAMES ? engine_names[e] : NULL;
+}
+
+/* ---------------------------------------------------------------------------
+
+   write_json
+
+   Notes:
+
+      This routine writes the results as JSON to 'fp'.
+
+*/
+static void write_json (FILE *fp)
+{
+   acc_path_str_typ *pp;
+   int i, j;
+
+   fprintf(fp, "{\n  \"program\": \"lcalacc\",\n  \"reference\": \"%s\",\n  \"reference_engine\": \"%s\",\n"
+           "  \"time_zone\": \"%s\",\n  \"first_year\": %d,\n  \"last_year\": %d,\n  \"days\": %ld,\n"
+           "  \"unit\": %g,\n  \"paths\": [", REF_NAME, REF_ENGINE, time_zone, first_year, last_year,
+           num_days, ERR_UNIT);
+   for (i = 0, pp = paths; i < num_paths; i++, pp++) {
+      fprintf(fp, "%s\n    { \"path\": \"%s\", \"engine\": \"%s\", \"grid\": %s, \"max\": %.4f,"
+              " \"max_day\": \"%s\", \"mean\": %.4f,", i ? "," : "", pp->name, pp->engine,
+              pp->grid ? "true" : "false", pp->max, day_date(pp->max_day), pp->mean);
+      for (j = 0; j < NUM_PCTS; j++) fprintf(fp, " \"p%g\": %.4f,", pcts[j], pp->pct[j]);
+      fprintf(fp, " \"printed_changed\": %ld, \"shape_changed\": %ld }", pp->printed, pp->shapes);
+   }
+   fprintf(fp, "\n  ]\n}\n");
+   return;
+}
+
+/* ---------------------------------------------------------------------------
+
+   main
+
+*/
+int main (int argc, char **argv)
+{
+   static char *eph_files[MAX_EPHEMERIDES];
+   acc_path_str_typ *pp;
+   FILE *fp = NULL;
+   char *engine, *p;
+   int num_eph = 0, i, e;
+
+   strcpy(time_zone, ACC_TIMEZONE);
+   for (i = 1; i < argc && argv[i][0] == '-' && argv[i][1]; i++) {
+      if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) json_file = argv[++i];
+      else if (strcmp(argv[i], "-y") == 0 && i + 1 < argc) {
+         first_year = last_year = atoi(argv[++i]);
+         if ((p = strchr(argv[i], '-')) != NULL) last_year = atoi(p + 1);
+         if (first_year < MIN_YR || last_year > MAX_YR || first_year > last_year) break;
+      }
+      else if (strcmp(argv[i], "-z") == 0 && i + 1 < argc) {
+         sprintf(time_zone, "%.*s", STRSIZ - 1, argv[++i]);
+      }
+      else if (strcmp(argv[i], "-E") == 0 && i + 1 < argc && num_eph < MAX_EPHEMERIDES) {
+         eph_files[num_eph++] = argv[++i];
+      }
+      else break;
+   }
+   if (i < argc) {
+      fprintf(stderr, "usage: lcalacc [-o FILE] [-y FIRST[-LAST] (%d .. %d)] [-z ZONE (%s)] [-E EPHEMERIS ...]\n",
+              MIN_YR, MAX_YR, ACC_TIMEZONE);
+      exit(EXIT_FAILURE);
+   }
+
+   if (json_file && (fp = strcmp(json_file, "-") == 0 ? stdout : fopen(json_file, "w")) == NULL) {
+      fprintf(stderr, "lcalacc: can't open file %s\n", json_file);
+      exit(EXIT_FAILURE);
+   }
+
+   init_names("lcalacc");
+
+   if (!calc_ref()) {
+      fprintf(stderr, "lcalacc: out of memory\n");
+      exit(EXIT_FAILURE);
+   }
+
+   /* each engine but the reference, directly and from the grid (unless
+      that is exact here); and each ephemeris */
+   for (e = 0; e < NUM_ENGINE_NAMES; e++) {
+      if (strcmp(engine_names[e], REF_ENGINE) == 0) continue;
+      add_path(engine_names[e], FALSE, NULL);
+      if (!on_grid) add_path(engine_names[e], TRUE, NULL);
+   }
+   for (i = 0; i < num_eph; i++) {
+      if ((engine = eph_engine(eph_files[i])) == NULL) {
+         fprintf(stderr, "lcalacc: can't load ephemeris file %s\n", eph_files[i]);
+         exit(EXIT_FAILURE);
+      }
+      add_path(engine, FALSE, eph_files[i]);
+   }
+
+   printf("vs %s (the %s engine), %d .. %d (%ld days), zone %s; errors in %g cycle (the last digit printed)\n",
+          REF_NAME, REF_ENGINE, first_year, last_year, num_days, time_zone, ERR_UNIT);
+   if (on_grid) printf("(every day falls on a sample of the phase grid here, so it is exact and not measured)\n");
+   printf("%-24s %8s %8s", "phases", "max", "mean");
+   for (i = 0; i < NUM_PCTS; i++) printf(" %7s%-g", "p", pcts[i]);
+   printf(" %10s %8s  %s\n", "printed", "shape", "worst day");
+
+   for (i = 0, pp = paths; i < num_paths; i++, pp++) {
+      if (!measure(pp)) {
+         fprintf(stderr, "lcalacc: can't set up the phases for %s\n", pp->name);
+         exit(EXIT_FAILURE);
+      }
+      printf("%-24s %8.3f %8.4f", pp->name, pp->max, pp->mean);
+      for (e = 0; e < NUM_PCTS; e++) printf(" %8.4f", pp->pct[e]);
+      printf(" %10ld %8ld  %s\n", pp->printed, pp->shapes, day_date(pp->max_day));
+      fflush(stdout);
+   }
+
+   if (fp) {
+      write_json(fp);
+      if (fp != stdout && fclose(fp) != 0) {
+         fprintf(stderr, "lcalacc: can't write file %s\n", json_file);
+         exit(EXIT_FAILURE);
+      }
+   }
+
+   free(ref_phase);
+   free(errors);
+   exit(EXIT_SUCCESS);
+}
@@ -0,0 +1,704 @@
+/* ---------------------------------------------------------------------------
+
+   lcalaio.c
+
+   Notes:
+
+      This file contains routines to write finished calendars to their
+      output files asynchronously (cf. '-A'), so that generating the next
+      calendar overlaps with opening, writing, and closing the files of the
+      previous ones -- which matters on network filesystems, where each of
+      these may block for milliseconds.
+
+      Under Linux, each file is written by a chain of 3 linked io_uring
+      operations (open into a 'direct' descriptor, write, close), issued
+      with plain system calls, so no library is needed.  At most AIO_SLOTS
+      files are in flight at a time; when all the slots are busy, queueing
+      another file waits for the oldest to complete.  Should a chain fail
+      for any reason, the file is simply written again synchronously, which
+      also reports the error, if any.
+
+      Where io_uring is not available (kernels before 5.15, which can't
+      open files as direct descriptors, or kernels or containers which
+      forbid io_uring, or systems other than Linux), each file is written
+      at once with plain 'open()'/'write()'/'close()'.
+
+      Each process uses its own ring: a process forked after the ring was
+      set up (cf. write_variants(), run_jobs()) sets up another as needed.
+
+*/
+
+/* ---------------------------------------------------------------------------
+
+   Header Files
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef BUILD_ENV_UNIX
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#endif
+#endif
+
+/*
+ * Lcal-specific definitions:
+ */
+#include "lcaldefs.h"
+
+#if defined (BUILD_ENV_UNIX) && defined (__linux__) && defined (__NR_io_uring_setup)
+#define HAVE_IO_URING
+#endif
+
+/* ---------------------------------------------------------------------------
+
+   Type, Struct, & Enum Declarations
+
+*/
+
+#ifdef HAVE_IO_URING
+
+/* a file being written */
+typedef struct {
+   int busy;
+   char *name;   /* (copies, freed when the file is done) */
+   char *data;
+   size_t len;
+   char *pfailed;   /* set TRUE if the file can't be written */
+   int ncomplete;   /* operations completed (of 3) */
+   int failed;   /* any operation failed */
+} aio_slot_str_typ;
+
+/* the submission and completion rings, as mapped from the kernel */
+typedef struct {
+   int fd;
+   unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+   unsigned *cq_head, *cq_tail, *cq_mask;
+   struct io_uring_sqe *sqes;
+   struct io_uring_cqe *cqes;
+   void *sq_ptr, *cq_ptr;
+   size_t sq_size, cq_size, sqes_size;
+} aio_ring_str_typ;
+
+#endif
+
+/* ---------------------------------------------------------------------------
+
+   Constant Declarations
+
+*/
+
+#define AIO_OPEN	0	/* operations in a chain (cf. 'user_data') */
+#define AIO_WRITE	1
+#define AIO_CLOSE	2
+#define AIO_OPS		3
+
+#ifdef HAVE_IO_URING
+#define AIO_LAST_OP	IORING_OP_WRITE	/* highest opcode used (for the probe) */
+#define AIO_PROBE_FILE	"/dev/null"	/* opened to probe for direct descriptors */
+#define AIO_POLL_USEC	1000	/* polling interval if the ring can't wait */
+#endif
+
+/* ---------------------------------------------------------------------------
+
+   Data Declarations (including externals)
+
+*/
+
+static int aio_failures = 0;   /* since last async_flush() */
+#ifdef BUILD_ENV_UNIX
+static pid_t aio_pid = 0;   /* process the above (and the ring) belong to */
+#endif
+
+#ifdef HAVE_IO_URING
+static aio_ring_str_typ ring;   /* (fd -1 if not set up, cf. check_owner()) */
+static aio_slot_str_typ slots[AIO_SLOTS];
+static int ring_unusable = FALSE;   /* don't try to set up a ring again */
+static int in_flight = 0;
+#endif
+
+/* ---------------------------------------------------------------------------
+
+   write_file
+
+   Notes:
+
+      This routine writes the 'len' bytes at 'data' to the file 'name', at
+      once.  It returns FALSE (after reporting the error) if it can't.
+
+*/
+static int write_file (char *name, char *data, size_t len)
+{
+#ifdef BUILD_ENV_UNIX
+   ssize_t n;
+   int fd, ok = TRUE;
+
+   if ((fd = open(name, O_WRONLY | O_CREAT | O_TRUNC, 0666)) < 0) {
+      fprintf(stderr, E_FOPEN_ERR, progname, name);
+      return FALSE;
+   }
+   while (ok && len > 0) {
+      if ((n = write(fd, data, len)) < 0) {
+         if (errno != EINTR) ok = FALSE;
+         continue;
+      }
+      data += n;
+      len -= n;
+   }
+   if (close(fd) != 0) ok = FALSE;
+#else
+   FILE *fp;
+   int ok;
+
+   if ((fp = fopen(name, "w")) == NULL) {
+      fprintf(stderr, E_FOPEN_ERR, progname, name);
+      return FALSE;
+   }
+   ok = fwrite(data, 1, len, fp) == len;
+   if (fclose(fp) != 0) ok = FALSE;
+#endif
+
+   if (!ok) fprintf(stderr, E_WRITE_ERR, progname, name);
+   return ok;
+}
+
+#ifdef HAVE_IO_URING
+static void ring_close (void);
+static int probe_direct (void);
+#endif
+
+/* ---------------------------------------------------------------------------
+
+   check_owner
+
+   Notes:
+
+      This routine forgets the state inherited from the parent process (the
+      ring, the files in flight, and the failures), if this is a process
+      forked since the state was set.
+
+*/
+static void check_owner (void)
+{
+#ifdef BUILD_ENV_UNIX
+   if (aio_pid != getpid()) {
+#ifdef HAVE_IO_URING
+      if (aio_pid == 0) ring.fd = -1;
+      ring_close();
+#endif
+      aio_failures = 0;
+      aio_pid = getpid();
+   }
+#endif
+   return;
+}
+
+#ifdef HAVE_IO_URING
+
+/* ---------------------------------------------------------------------------
+
+   ring_close
+
+   Notes:
+
+      This routine releases the ring (if any), discarding any files still in
+      flight (which, in a forked process, belong to the parent).
+
+*/
+static void ring_close (void)
+{
+   int i;
+
+   if (ring.fd < 0) return;
+
+   if (ring.sqes) munmap(ring.sqes, ring.sqes_size);
+   if (ring.cq_ptr && ring.cq_ptr != ring.sq_ptr) munmap(ring.cq_ptr, ring.cq_size);
+   if (ring.sq_ptr) munmap(ring.sq_ptr, ring.sq_size);
+   close(ring.fd);
+
+   memset(&ring, 0, sizeof(ring));
+   ring.fd = -1;
+
+   if (in_flight) {
+      for (i = 0; i < AIO_SLOTS; i++) {
+         if (slots[i].busy) {
+            free(slots[i].name);
+            free(slots[i].data);
+         }
+      }
+      memset(slots, 0, sizeof(slots));
+      in_flight = 0;
+   }
+   return;
+}
+
+/* ---------------------------------------------------------------------------
+
+   ring_setup
+
+   Notes:
+
+      This routine sets up the ring for this process, with a table of
+      AIO_SLOTS (initially empty) direct file descriptors.  It returns FALSE
+      if io_uring, any of the operations used, or opening and closing files
+      as direct descriptors (Linux 5.15 and later) is unavailable.
+
+*/
+static int ring_setup (void)
+{
+   struct io_uring_params p;
+   struct io_uring_probe *probe;
+   int fds[AIO_SLOTS], i, ok;
+   size_t probe_size;
+
+   if (ring.fd >= 0) return TRUE;
+   if (ring_unusable) return FALSE;
+   ring_unusable = TRUE;   /* (until we succeed) */
+
+   memset(&p, 0, sizeof(p));
+   if ((ring.fd = (int) syscall(__NR_io_uring_setup, AIO_OPS * AIO_SLOTS, &p)) < 0) {
+      ring.fd = -1;
+      return FALSE;
+   }
+
+   /* map the rings (a single mapping for both, on newer kernels) */
+   ring.sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+   ring.cq_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+   if (p.features & IORING_FEAT_SINGLE_MMAP) {
+      if (ring.cq_size > ring.sq_size) ring.sq_size = ring.cq_size;
+      ring.cq_size = ring.sq_size;
+   }
+   ring.sq_ptr = mmap(NULL, ring.sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      ring.fd, IORING_OFF_SQ_RING);
+   if (ring.sq_ptr == MAP_FAILED) {
+      ring.sq_ptr = NULL;
+      ring_close();
+      return FALSE;
+   }
+   if (p.features & IORING_FEAT_SINGLE_MMAP) ring.cq_ptr = ring.sq_ptr;
+   else {
+      ring.cq_ptr = mmap(NULL, ring.cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                         ring.fd, IORING_OFF_CQ_RING);
+      if (ring.cq_ptr == MAP_FAILED) {
+         ring.cq_ptr = NULL;
+         ring_close();
+         return FALSE;
+      }
+   }
+   ring.sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+   ring.sqes = (struct io_uring_sqe *) mmap(NULL, ring.sqes_size, PROT_READ | PROT_WRITE,
+                                            MAP_SHARED | MAP_POPULATE, ring.fd, IORING_OFF_SQES);
+   if (ring.sqes == MAP_FAILED) {
+      ring.sqes = NULL;
+      ring_close();
+      return FALSE;
+   }
+
+   ring.sq_head = (unsigned *) ((char *) ring.sq_ptr + p.sq_off.head);
+   ring.sq_tail = (unsigned *) ((char *) ring.sq_ptr + p.sq_off.tail);
+   ring.sq_mask = (unsigned *) ((char *) ring.sq_ptr + p.sq_off.ring_mask);
+   ring.sq_array = (unsigned *) ((char *) ring.sq_ptr + p.sq_off.array);
+   ring.cq_head = (unsigned *) ((char *) ring.cq_ptr + p.cq_off.head);
+   ring.cq_tail = (unsigned *) ((char *) ring.cq_ptr + p.cq_off.tail);
+   ring.cq_mask = (unsigned *) ((char *) ring.cq_ptr + p.cq_off.ring_mask);
+   ring.cqes = (struct io_uring_cqe *) ((char *) ring.cq_ptr + p.cq_off.cqes);
+
+   /* make sure the operations we need are supported */
+   probe_size = sizeof(*probe) + (AIO_LAST_OP + 1) * sizeof(struct io_uring_probe_op);
+   if ((probe = (struct io_uring_probe *) calloc(1, probe_size)) == NULL) {
+      ring_close();
+      return FALSE;
+   }
+   ok = syscall(__NR_io_uring_register, ring.fd, IORING_REGISTER_PROBE, probe,
+                AIO_LAST_OP + 1) == 0 &&
+      probe->ops_len > AIO_LAST_OP &&
+      (probe->ops[IORING_OP_OPENAT].flags & IO_URING_OP_SUPPORTED) &&
+      (probe->ops[IORING_OP_WRITE].flags & IO_URING_OP_SUPPORTED) &&
+      (probe->ops[IORING_OP_CLOSE].flags & IO_URING_OP_SUPPORTED);
+   free(probe);
+
+   /* register an empty table of direct descriptors for the open files */
+   for (i = 0; i < AIO_SLOTS; i++) fds[i] = -1;
+   if (!ok || syscall(__NR_io_uring_register, ring.fd, IORING_REGISTER_FILES, fds, AIO_SLOTS) != 0 ||
+       !probe_direct()) {
+      ring_close();
+      return FALSE;
+   }
+
+   ring_unusable = FALSE;
+   return TRUE;
+}
+
+/* ---------------------------------------------------------------------------
+
+   ring_enter
+
+   Notes:
+
+      This routine submits 'to_submit' queued operations and/or waits for
+      'wait_for' to complete (retrying if interrupted, or if only some of
+      the operations were taken).  It returns FALSE if the ring fails.
+
+*/
+static int ring_enter (unsigned to_submit, unsigned wait_for)
+{
+   long n;
+
+   for (;;) {
+      n = syscall(__NR_io_uring_enter, ring.fd, to_submit, wait_for,
+                  wait_for ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+      if (n < 0 && errno != EINTR) return FALSE;
+      if (n >= (long) to_submit) return TRUE;
+      if (n > 0) to_submit -= (unsigned) n;   /* (submit the rest) */
+   }
+}
+
+/* ---------------------------------------------------------------------------
+
+   complete_op
+
+   Notes:
+
+      This routine records the completion of operation 'op' on the file in
+      slot 'slot', with result 'res'.  When all 3 operations for the file
+      have completed, its slot is released; if any of them failed, the file
+      is written again synchronously.
+
+*/
+static void complete_op (int slot, int op, int res)
+{
+   aio_slot_str_typ *ps = &slots[slot];
+
+   if (op == AIO_WRITE ? res != (int) ps->len : res < 0) ps->failed = TRUE;
+
+   if (++ps->ncomplete == AIO_OPS) {
+      if (ps->failed && !write_file(ps->name, ps->data, ps->len)) {
+         if (ps->pfailed) *ps->pfailed = TRUE;
+         aio_failures++;
+      }
+      free(ps->name);
+      free(ps->data);
+      ps->busy = FALSE;
+      in_flight--;
+   }
+   return;
+}
+
+/* ---------------------------------------------------------------------------
+
+   reap_ready
+
+   Notes:
+
+      This routine processes the operations completed so far.
+
+*/
+static void reap_ready (void)
+{
+   struct io_uring_cqe *cqe;
+   unsigned head, tail;
+
+   head = *ring.cq_head;
+   tail = __atomic_load_n(ring.cq_tail, __ATOMIC_ACQUIRE);
+
+   for (; head != tail; head++) {
+      cqe = &ring.cqes[head & *ring.cq_mask];
+      complete_op((int) (cqe->user_data / AIO_OPS), (int) (cqe->user_data % AIO_OPS), cqe->res);
+   }
+
+   __atomic_store_n(ring.cq_head, head, __ATOMIC_RELEASE);
+   return;
+}
+
+/* ---------------------------------------------------------------------------
+
+   ring_fail
+
+   Notes:
+
+      This routine gives up on the ring after it has failed: each file still
+      in flight is written again synchronously, and the files that follow
+      are written synchronously too.
+
+      The operations the kernel never took are counted as failed at once;
+      the others are waited for (polling the completion ring if the ring
+      can't even wait), so that none still uses a file's name or data -- or
+      writes the file -- after it is written again and its slot released.
+
+*/
+static void ring_fail (void)
+{
+   struct io_uring_sqe *sqe;
+   unsigned head, tail;
+
+   head = __atomic_load_n(ring.sq_head, __ATOMIC_ACQUIRE);
+   for (tail = *ring.sq_tail; head != tail; head++) {
+      sqe = &ring.sqes[ring.sq_array[head & *ring.sq_mask]];
+      complete_op((int) (sqe->user_data / AIO_OPS), (int) (sqe->user_data % AIO_OPS), -ECANCELED);
+   }
+   __atomic_store_n(ring.sq_tail, head, __ATOMIC_RELEASE);
+
+   reap_ready();
+   while (in_flight > 0) {
+      if (!ring_enter(0, 1)) usleep(AIO_POLL_USEC);
+      reap_ready();
+   }
+
+   ring_close();
+   ring_unusable = TRUE;
+   return;
+}
+
+/* ---------------------------------------------------------------------------
+
+   reap
+
+   Notes:
+
+      This routine processes the completed operations (cf. complete_op()),
+      waiting for at least 'wait_for' of them first.
+
+      It returns FALSE if the ring has failed (and been given up, cf.
+      ring_fail()).
+
+*/
+static int reap (int wait_for)
+{
+   if (wait_for > 0 && !ring_enter(0, wait_for)) {
+      ring_fail();
+      return FALSE;
+   }
+
+   reap_ready();
+   return TRUE;
+}
+
+/* ---------------------------------------------------------------------------
+
+   queue_op
+
+   Notes:
+
+      This routine fills in the next submission queue entry for operation
+      'op' on the file in slot 'slot'.
+
+*/
+static void queue_op (int slot, int op, unsigned flags)
+{
+   aio_slot_str_typ *ps = &slots[slot];
+   struct io_uring_sqe *sqe;
+   unsigned tail, index;
+
+   tail = *ring.sq_tail;
+   index = tail & *ring.sq_mask;
+   sqe = &ring.sqes[index];
+   memset(sqe, 0, sizeof(*sqe));
+
+   switch (op) {
+   case AIO_OPEN:
+      sqe->opcode = IORING_OP_OPENAT;
+      sqe->fd = AT_FDCWD;
+      sqe->addr = (unsigned long) ps->name;
+      sqe->len = 0666;
+      sqe->open_flags = O_WRONLY | O_CREAT | O_TRUNC;
+      sqe->file_index = slot + 1;
+      break;
+   case AIO_WRITE:
+      sqe->opcode = IORING_OP_WRITE;
+      sqe->fd = slot;
+      sqe->addr = (unsigned long) ps->data;
+      sqe->len = (unsigned) ps->len;
+      sqe->off = 0;
+      flags |= IOSQE_FIXED_FILE;
+      break;
+   case AIO_CLOSE:
+      sqe->opcode = IORING_OP_CLOSE;
+      sqe->file_index = slot + 1;
+      break;
+   }
+   sqe->flags = (unsigned char) flags;
+   sqe->user_data = (unsigned long long) slot * AIO_OPS + op;
+
+   ring.sq_array[index] = index;
+   __atomic_store_n(ring.sq_tail, tail + 1, __ATOMIC_RELEASE);
+   return;
+}
+
+/* ---------------------------------------------------------------------------
+
+   next_result
+
+   Notes:
+
+      This routine returns the result of the next completed operation (of
+      a single one submitted and waited for), or -1 if there is none.
+
+*/
+static int next_result (void)
+{
+   unsigned head = *ring.cq_head;
+   int res;
+
+   if (head == __atomic_load_n(ring.cq_tail, __ATOMIC_ACQUIRE)) return -1;
+   res = ring.cqes[head & *ring.cq_mask].res;
+   __atomic_store_n(ring.cq_head, head + 1, __ATOMIC_RELEASE);
+   return res;
+}
+
+/* ---------------------------------------------------------------------------
+
+   probe_direct
+
+   Notes:
+
+      This routine checks that the kernel opens and closes files as direct
+      descriptors (cf. queue_op()), by opening and closing AIO_PROBE_FILE
+      in slot 0.  The probe for the operations isn't enough: before Linux
+      5.15, IORING_OP_OPENAT ignores 'file_index' and returns an ordinary
+      descriptor (which would leak), and IORING_OP_CLOSE closes 'fd' (which
+      would be standard input).  So the close is only tried once the open
+      has returned a direct descriptor.
+
+      It returns TRUE if both succeed.
+
+*/
+static int probe_direct (void)
+{
+   int res;
+
+   slots[0].name = AIO_PROBE_FILE;
+   queue_op(0, AIO_OPEN, 0);
+   res = ring_enter(1, 1) ? next_result() : -1;
+   if (res > 0) close(res);   /* (an ordinary descriptor) */
+   if (res == 0) {
+      queue_op(0, AIO_CLOSE, 0);
+      res = ring_enter(1, 1) ? next_result() : -1;
+   }
+   slots[0].name = NULL;
+   return res == 0;
+}
+
+#endif   /* HAVE_IO_URING */
+
+/* ---------------------------------------------------------------------------
+
+   async_write_file
+
+   Notes:
+
+      This routine queues the 'len' bytes at 'data' (which must have been
+      allocated by 'malloc()', and is freed here) to be written to the file
+      'name'.  If the file can't be written, '*pfailed' (if 'pfailed' is not
+      NULL) is set TRUE -- possibly only later, when the write completes.
+
+      It returns FALSE if the file could not be written (synchronously).
+
+*/
+int async_write_file (char *name, char *data, size_t len, char *pfailed)
+{
+#ifdef HAVE_IO_URING
+   aio_slot_str_typ *ps;
+   int i, ok;
+#endif
+
+   check_owner();
+
+#ifdef HAVE_IO_URING
+   /* a single write can't take more than 2 GB */
+   if (len < 0x7fffffffUL && ring_setup()) {
+
+      /* wait for a free slot if need be (unless the ring fails meanwhile) */
+      ok = reap(0);
+      while (ok && in_flight == AIO_SLOTS) ok = reap(1);
+
+      for (i = 0; ok && slots[i].busy; i++)
+         ;
+      ps = &slots[i];
+      if (ok && (ps->name = (char *) malloc(strlen(name) + 1)) != NULL) {
+         strcpy(ps->name, name);
+         ps->data = data;
+         ps->len = len;
+         ps->pfailed = pfailed;
+         ps->ncomplete = 0;
+         ps->failed = FALSE;
+         ps->busy = TRUE;
+         in_flight++;
+
+         /* open -> write -> close: the write and close are cancelled if
+            the open fails, and the close happens even if the write fails */
+         queue_op(i, AIO_OPEN, IOSQE_IO_LINK);
+         queue_op(i, AIO_WRITE, IOSQE_IO_HARDLINK);
+         queue_op(i, AIO_CLOSE, 0);
+
+         if (!ring_enter(AIO_OPS, 0)) ring_fail();   /* (which writes this file) */
+         return TRUE;
+      }
+   }
+#endif
+
+   if (!write_file(name, data, len)) {
+      if (pfailed) *pfailed = TRUE;
+      aio_failures++;
+      free(data);
+      return FALSE;
+   }
+   free(data);
+   return TRUE;
+}
+
+/* ---------------------------------------------------------------------------
+
+   async_flush
+
+   Notes:
+
+      This routine waits until all the files queued by this process have
+      been written.  It returns FALSE if any of the files queued since the
+      last call could not be written.
+
+*/
+int async_flush (void)
+{
+   int ok;
+
+   check_owner();
+
+#ifdef HAVE_IO_URING
+   while (in_flight > 0 && reap(1))
+      ;
+#endif
+
+   ok = aio_failures == 0;
+   aio_failures = 0;
+   return ok;
+}
+
+/* ---------------------------------------------------------------------------
+
+   async_backend
+
+   Notes:
+
+      This routine returns the name of the method used to write files: "io_uring",
+      or "write" if it is unavailable (or not yet tried).
+
+*/
+char * async_backend (void)
+{
+   check_owner();
+
+#ifdef HAVE_IO_URING
+   if (ring.fd >= 0) return "io_uring";
+#endif
+   return "write";
+}
@@ -0,0 +1,425 @@
+/* ---------------------------------------------------------------------------
+
+   lcalapi.c
+
+   Notes:
+
+      This program checks the library version of 'lcal' (cf. liblcal.c)
+      through its public interface alone, as a program embedding it would
+      use it: it is linked with 'liblcal.a', built and run by "make check",
+      and is not installed.
+
+      The calendars rendered by 'lcal_render_buffer()' for a few years
+      (API_YEARS) in a few layout modes and other options ('modes[]') must
+      be byte-for-byte identical to those written by 'lcal -R' with the
+      equivalent flags.  Then each error path must return its documented
+      error code (cf. liblcal.h): dates, years, and ranges of months out of
+      range, an unknown time zone or phase engine, other invalid options, a
+      buffer too small (which must also give the size needed), and a sink
+      which fails.
+
+      Usage: lcalapi [LCAL]
+
+      Unix only.
+
+*/
+
+/* ---------------------------------------------------------------------------
+
+   Header Files
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+/*
+ * The library's interface (only):
+ */
+#include "liblcal.h"
+
+/* ---------------------------------------------------------------------------
+
+   Constant Declarations
+
+*/
+
+#define DEFAULT_LCAL	"./lcal"
+
+#define API_BUFSIZ	(1024 * 1024)	/* (ample for any calendar) */
+#define API_LINSIZ	512
+#define MAX_REPORTS	10	/* failures reported in detail */
+
+#define FIRST_YR	1753	/* (cf. MIN_YR, MAX_YR in lcaldefs.h) */
+#define LAST_YR		9999
+
+/* ---------------------------------------------------------------------------
+
+   Type, Struct, & Enum Declarations
+
+*/
+
+/* a layout mode or other option: its 'lcal' flags, and how to set it */
+typedef struct {
+   char *flags;
+   void (*set)(lcal_options_str_typ *opts);
+} api_mode_str_typ;
+
+/* ---------------------------------------------------------------------------
+
+   Data Declarations (including externals)
+
+*/
+
+static int api_years[] = { FIRST_YR, 1900, 2024, LAST_YR };
+
+#define API_YEARS	((int) (sizeof(api_years) / sizeof(api_years[0])))
+
+static char *lcal = DEFAULT_LCAL;
+
+static char lib_buf[API_BUFSIZ], lcal_buf[API_BUFSIZ];
+
+static int failures = 0;
+
+/* ---------------------------------------------------------------------------
+
+   set_... (the modes)
+
+*/
+
+static void set_portrait (lcal_options_str_typ *opts) { opts->landscape = 0; }
+static void set_landscape (lcal_options_str_typ *opts) { opts->landscape = 1; }
+static void set_compressed (lcal_options_str_typ *opts) { opts->compressed = 1; opts->weekdays = !opts->weekdays; }
+static void set_odd_days (lcal_options_str_typ *opts) { opts->landscape = 1; opts->odd_days = 1; }
+static void set_zone (lcal_options_str_typ *opts) { opts->time_zone = "America/New_York"; }
+static void set_engine (lcal_options_str_typ *opts) { opts->engine = "fast"; }
+static void set_shading (lcal_options_str_typ *opts) { opts->shading = "0:1:1/0:0:0.7/0/1:1:0"; }
+static void set_eclipses (lcal_options_str_typ *opts) { opts->eclipses = 1; opts->moon_sizes = 1; }
+
+static void set_rise_set (lcal_options_str_typ *opts)
+{
+   opts->rise_set = 1;
+   opts->latitude = 51.5;
+   opts->longitude = -0.1;
+}
+
+static void set_months (lcal_options_str_typ *opts)
+{
+   opts->month = 11;
+   opts->nmonths = 3;
+}
+
+static api_mode_str_typ modes[] = {
+   { "-p", set_portrait },
+   { "-l", set_landscape },
+   { "-S -W", set_compressed },
+   { "-l -O", set_odd_days },
+   { "-z America/New_York", set_zone },
+   { "-P fast", set_engine },
+   { "-s 0:1:1/0:0:0.7/0/1:1:0", set_shading },
+   { "-e -m", set_eclipses },
+   { "-g 51.5/-0.1", set_rise_set },
+   { "-r 11-1", set_months },
+};
+
+#define NUM_MODES	((int) (sizeof(modes) / sizeof(modes[0])))
+
+/* ---------------------------------------------------------------------------
+
+   failed
+
+   Notes:
+
+      This routine reports a failed check (the first few in detail).
+
+*/
+static void failed (char *what, char *fmt, ...)
+{
+   va_list ap;
+
+   if (failures++ < MAX_REPORTS) {
+      fprintf(stderr, "lcalapi: FAILED %s: ", what);
+      va_start(ap, fmt);
+      vfprintf(stderr, fmt, ap);
+      va_end(ap);
+      fprintf(stderr, "\n");
+   }
+   else if (failures == MAX_REPORTS + 1) fprintf(stderr, "lcalapi: (more failures...)\n");
+}
+
+/* ---------------------------------------------------------------------------
+
+   run_lcal
+
+   Notes:
+
+      This routine runs 'lcal -R' with the flags 'flags' for 'year', and
+      reads its output into 'lcal_buf'.  It returns the length read, or -1
+      if lcal failed.
+
+*/
+static long run_lcal (char *flags, int year)
+{
+   char cmd[2 * API_LINSIZ];
+   FILE *fp;
+   size_t len;
+   int status;
+
+   sprintf(cmd, "%s -R %s %d 2>/dev/null", lcal, flags, year);
+   if ((fp = popen(cmd, "r")) == NULL) return -1;
+   len = fread(lcal_buf, 1, sizeof(lcal_buf), fp);
+   status = pclose(fp);
+   return WIFEXITED(status) && WEXITSTATUS(status) == 0 && len < sizeof(lcal_buf) ? (long) len : -1;
+}
+
+/* ---------------------------------------------------------------------------
+
+   check_render
+
+   Notes:
+
+      This routine renders the calendar for each year and mode with the
+      library, and checks it against the one from 'lcal -R'.  It returns
+      the number of calendars checked.
+
+*/
+static int check_render (void)
+{
+   lcal_options_str_typ opts;
+   char what[API_LINSIZ];
+   size_t len;
+   long n;
+   int y, m, err, i, count = 0;
+
+   for (y = 0; y < API_YEARS; y++) {
+      for (m = 0; m < NUM_MODES; m++) {
+         sprintf(what, "%s %d", modes[m].flags, api_years[y]);
+
+         lcal_init_options(&opts);
+         opts.year = api_years[y];
+         opts.reproducible = 1;
+         modes[m].set(&opts);
+         if (opts.year + (opts.month - 1 + opts.nmonths - 1) / 12 > LAST_YR) continue;
+         count++;
+
+         if ((err = lcal_render_buffer(&opts, lib_buf, sizeof(lib_buf), &len)) != LCAL_OK) {
+            failed(what, "lcal_render_buffer() returned %d (%s)", err, lcal_strerror(err));
+            continue;
+         }
+         if ((n = run_lcal(modes[m].flags, api_years[y])) < 0) {
+            failed(what, "lcal failed");
+            continue;
+         }
+         if ((long) len != n || memcmp(lib_buf, lcal_buf, len) != 0) {
+            for (i = 0; i < (long) len && i < n && lib_buf[i] == lcal_buf[i]; i++)
+               ;
+            failed(what, "differs from lcal -R at byte %d (%lu bytes, lcal %ld)", i,
+                   (unsigned long) len, n);
+         }
+      }
+   }
+   return count;
+}
+
+/* ---------------------------------------------------------------------------
+
+   expect
+
+   Notes:
+
+      This routine checks that the error code 'err' is 'want'.
+
+*/
+static void expect (char *what, int err, int want)
+{
+   if (err != want) {
+      failed(what, "returned %d (%s), expected %d (%s)", err, lcal_strerror(err), want,
+             lcal_strerror(want));
+   }
+}
+
+/* ---------------------------------------------------------------------------
+
+   render_error
+
+   Notes:
+
+      This routine returns the error code from rendering the calendar for
+      the options 'opts' into the buffer.
+
+*/
+static int render_error (lcal_options_str_typ *opts)
+{
+   return lcal_render_buffer(opts, lib_buf, sizeof(lib_buf), NULL);
+}
+
+/* ---------------------------------------------------------------------------
+
+   failing_sink, counting_sink
+
+   Notes:
+
+      These are sinks for lcal_render(): the 1st fails at once, the 2nd
+      counts the bytes passed to it, in '*(size_t *) ctx'.
+
+*/
+static int failing_sink (void *ctx, const char *data, size_t len)
+{
+   (void) ctx;
+   (void) data;
+   (void) len;
+   return 1;
+}
+
+static int counting_sink (void *ctx, const char *data, size_t len)
+{
+   (void) data;
+   *(size_t *) ctx += len;
+   return 0;
+}
+
+/* ---------------------------------------------------------------------------
+
+   check_errors
+
+   Notes:
+
+      This routine checks that each error path returns the documented error
+      code, and that the valid cases on either side of it succeed.
+
+*/
+static void check_errors (void)
+{
+   static char long_font[API_LINSIZ];
+   lcal_options_str_typ opts, dflt;
+   lcal_grid_typ *grid;
+   char small[16];
+   size_t len, need, total;
+   long jd;
+   int wd, err;
+
+   lcal_init_options(&dflt);
+   dflt.year = 2024;
+   dflt.reproducible = 1;
+
+   /* dates */
+   expect("lcal_weekday(2, 29, 2024)", lcal_weekday(2, 29, 2024, &wd), LCAL_OK);
+   if (wd != 4) failed("lcal_weekday(2, 29, 2024)", "weekday %d, expected 4", wd);
+   expect("lcal_julian_day(1, 1, 2000)", lcal_julian_day(1, 1, 2000, &jd), LCAL_OK);
+   if (jd != 2451545L) failed("lcal_julian_day(1, 1, 2000)", "%ld, expected 2451545", jd);
+   expect("lcal_julian_day(12, 31, LAST_YR)", lcal_julian_day(12, 31, LAST_YR, &jd), LCAL_OK);
+   expect("lcal_weekday(13, 1, 2026)", lcal_weekday(13, 1, 2026, &wd), LCAL_E_DATE);
+   expect("lcal_weekday(0, 1, 2026)", lcal_weekday(0, 1, 2026, &wd), LCAL_E_DATE);
+   expect("lcal_weekday(2, 29, 2025)", lcal_weekday(2, 29, 2025, &wd), LCAL_E_DATE);
+   expect("lcal_weekday(2, 29, 1900)", lcal_weekday(2, 29, 1900, &wd), LCAL_E_DATE);
+   expect("lcal_weekday(4, 31, 2026)", lcal_weekday(4, 31, 2026, &wd), LCAL_E_DATE);
+   expect("lcal_julian_day(1, 0, 2026)", lcal_julian_day(1, 0, 2026, &jd), LCAL_E_DATE);
+   expect("lcal_weekday(1, 1, FIRST_YR - 1)", lcal_weekday(1, 1, FIRST_YR - 1, &wd), LCAL_E_YEAR);
+   expect("lcal_julian_day(1, 1, LAST_YR + 1)", lcal_julian_day(1, 1, LAST_YR + 1, &jd), LCAL_E_YEAR);
+
+   /* years and ranges of months */
+   opts = dflt;
+   opts.year = FIRST_YR - 1;
+   expect("year FIRST_YR - 1", render_error(&opts), LCAL_E_YEAR);
+   opts = dflt;
+   opts.year = LAST_YR + 1;
+   expect("year LAST_YR + 1", render_error(&opts), LCAL_E_YEAR);
+   opts = dflt;
+   opts.month = 13;
+   expect("month 13", render_error(&opts), LCAL_E_YEAR);
+   opts = dflt;
+   opts.nmonths = 0;
+   expect("0 months", render_error(&opts), LCAL_E_YEAR);
+   opts = dflt;
+   opts.nmonths = LCAL_MAX_MONTHS + 1;
+   expect("LCAL_MAX_MONTHS + 1 months", render_error(&opts), LCAL_E_YEAR);
+   opts = dflt;
+   opts.year = LAST_YR;
+   opts.month = 12;
+   opts.nmonths = 2;
+   expect("12/LAST_YR + 2 months", render_error(&opts), LCAL_E_YEAR);
+
+   /* other options */
+   opts = dflt;
+   opts.time_zone = "Nowhere/Special";
+   expect("time zone Nowhere/Special", render_error(&opts), LCAL_E_ZONE);
+   opts = dflt;
+   opts.engine = "bogus";
+   expect("engine bogus", render_error(&opts), LCAL_E_ENGINE);
+   opts = dflt;
+   memset(long_font, 'x', sizeof(long_font) - 1);
+   opts.day_font = long_font;
+   expect("overlong day font", render_error(&opts), LCAL_E_OPTION);
+   opts = dflt;
+   opts.rise_set = 1;
+   opts.latitude = 91.0;
+   expect("latitude 91", render_error(&opts), LCAL_E_OPTION);
+
+   /* output */
+   expect("lcal_render_buffer()", lcal_render_buffer(&dflt, lib_buf, sizeof(lib_buf), &need), LCAL_OK);
+   len = 0;
+   expect("small buffer", lcal_render_buffer(&dflt, small, sizeof(small), &len), LCAL_E_SPACE);
+   if (len != need) failed("small buffer", "size needed %lu, expected %lu", (unsigned long) len,
+                           (unsigned long) need);
+   expect("exact buffer", lcal_render_buffer(&dflt, lib_buf, need, &len), LCAL_OK);
+   total = 0;
+   expect("counting sink", lcal_render(&dflt, counting_sink, &total), LCAL_OK);
+   if (total != need) failed("counting sink", "%lu bytes, expected %lu", (unsigned long) total,
+                             (unsigned long) need);
+   expect("failing sink", lcal_render(&dflt, failing_sink, NULL), LCAL_E_SINK);
+
+   /* grids */
+   if ((grid = lcal_grid_new(1, 2024, 12, NULL, &err)) == NULL) {
+      expect("lcal_grid_new()", err, LCAL_OK);
+   }
+   else {
+      expect("lcal_grid_new()", err, LCAL_OK);
+      if (lcal_grid_phase(grid, 2460000.5) >= 0.0) failed("lcal_grid_phase()", "phase outside the grid");
+      lcal_grid_free(grid);
+   }
+   grid = lcal_grid_new(1, 2024, 12, "bogus", &err);
+   expect("lcal_grid_new(engine bogus)", grid ? LCAL_OK : err, LCAL_E_ENGINE);
+   grid = lcal_grid_new(13, 2024, 12, NULL, &err);
+   expect("lcal_grid_new(month 13)", grid ? LCAL_OK : err, LCAL_E_YEAR);
+
+   if (strcmp(lcal_strerror(-1), "unknown error") != 0) failed("lcal_strerror(-1)", "not unknown");
+   if (strcmp(lcal_strerror(LCAL_E_DATE), "unknown error") == 0) failed("lcal_strerror()", "LCAL_E_DATE unknown");
+}
+
+/* ---------------------------------------------------------------------------
+
+   main
+
+*/
+int main (int argc, char **argv)
+{
+   int n;
+
+   if (argc > 2 || (argc == 2 && argv[1][0] == '-')) {
+      fprintf(stderr, "usage: lcalapi [LCAL]\n");
+      exit(EXIT_FAILURE);
+   }
+   if (argc == 2) lcal = argv[1];
+
+   /* make sure nothing but the flags given here affects the calendars */
+   unsetenv("LCAL_OPTS");
+   unsetenv("SOURCE_DATE_EPOCH");
+   unsetenv("LCAL_CACHE_DIR");
+   unsetenv("LCAL_PHASE_CACHE");
+   unsetenv("LCAL_STATS");
+   unsetenv("LCAL_TRACE");
+
+   n = check_render();
+   check_errors();
+
+   if (failures) {
+      fprintf(stderr, "lcalapi: %d check(s) failed\n", failures);
+      exit(EXIT_FAILURE);
+   }
+   printf("lcalapi: %d calendars identical to lcal -R, and all error codes as documented\n", n);
+   exit(EXIT_SUCCESS);
+}
@@ -0,0 +1,983 @@
+/* ---------------------------------------------------------------------------
+
+   lcalbench.c
+
+   Notes:
+
+      This program checks the fast number formatting routines (cf.
+      lcalfmt.c) against 'sprintf()', and then times lcal's computational
+      kernels -- the phase of a day, the Julian day number, the equation of
+      Kepler, the weekday, the moon's age by each phase engine, the
+      interpolated phase grid, a whole year's phase table and moonrise/
+      moonset times (for New York), and the phase formatting -- and finally
+      times the generation of whole calendars.  It is built and run by
+      "make bench", and is not installed.
+
+      The checks are exhaustive over every multiple of 1E-5 in 0 .. 1 (and
+      every 'exact' thousandth and tie between them) for the moon phases,
+      and cover a fixed pseudo-random sample of values for the other
+      routines.  Any mismatch is reported, and the program fails.
+
+      Each kernel is timed in a loop of calls over varying arguments, the
+      number of calls being doubled until a loop takes at least BENCH_MIN_NS;
+      after one more loop as a warm-up, the loop is timed BENCH_REPEATS
+      times.  Under Linux, the program first pins itself to the processor it
+      is running on, so that the timings aren't disturbed by migrations.
+
+      The median, mean, minimum, maximum, and standard deviation of the time
+      per call (in nanoseconds), and the median calls per second, are
+      printed as a table and written as JSON to the file given by '-o' (or
+      stdout if "-"), for comparison between builds.
+
+      The whole calendars are generated for '-n' years (E2E_YEARS by
+      default) in each layout mode -- each combination of '-l'/'-p', '-S' or
+      '-O', '-W', and the default or a colored shading -- and written to
+      each of /dev/null, a file in tmpfs (/dev/shm, or else /tmp), and
+      memory.  The time of each stage of a calendar is measured separately:
+      parsing the flags ('get_args()'), calculating the phase table,
+      generating the PostScript code into memory ('write_psfile()'), and
+      writing it out (opening, writing, and closing the file).  The
+      documents and bytes per second, and the time per document of each
+      stage, are reported for each mode and output, along with the
+      processor cycles, instructions, and cache misses, where the kernel
+      allows them to be counted (cf. 'perf_event_open()'; Linux only).
+
+      Usage: lcalbench [-o FILE] [-r REPEATS] [-n YEARS] [KERNEL ...]
+
+*/
+
+/* ---------------------------------------------------------------------------
+
+   Header Files
+
+*/
+
+#ifdef __linux__
+#define _GNU_SOURCE   /* (for sched_setaffinity() etc.) */
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <math.h>
+#include <time.h>
+
+#ifdef BUILD_ENV_UNIX
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+#include <sched.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+/*
+ * Lcal-specific definitions:
+ */
+#include "lcaldefs.h"
+
+/* ---------------------------------------------------------------------------
+
+   Constant Declarations
+
+*/
+
+#define NUM_SAMPLES	1000000L	/* pseudo-random values checked */
+
+#define BENCH_MIN_NS	20E6	/* shortest timed loop (ns) */
+#define BENCH_REPEATS	15	/* timed loops per kernel (default) */
+#define MAX_REPEATS	1000
+
+#define BENCH_JD0	2451545.0	/* 2000 Jan 1.5, for the moon's age kernels */
+#define ECC_EARTH	0.016718	/* (cf. moonphas.c) */
+
+#define E2E_YEARS	10	/* calendars per mode and output (default) */
+#define E2E_FIRST_YEAR	2020
+#define E2E_STAGES	4	/* cf. stage_names[] */
+#define NUM_COUNTERS	3	/* cf. counter_names[] */
+
+#define COLOR_SHADING	"0:1:1/0:0:0.7/0/1:1:0"	/* (cf. lcal.man) */
+
+/* ---------------------------------------------------------------------------
+
+   Type, Struct, & Enum Declarations
+
+*/
+
+/* a kernel to time: 'run(n)' makes 'n' calls */
+typedef struct {
+   char *name;
+   void (*run)(long n);
+} kernel_str_typ;
+
+/* timings of a kernel (ns per call) */
+typedef struct {
+   long calls;   /* per timed loop */
+   double median, mean, min, max, stddev;
+} timing_str_typ;
+
+/* a layout mode for the whole calendars, and an output for them */
+typedef struct {
+   char *name;
+   char *flags;
+} e2e_mode_str_typ;
+
+typedef struct {
+   char *name;
+   char *path;   /* NULL for memory */
+} e2e_output_str_typ;
+
+/* totals for the calendars of one mode and output */
+typedef struct {
+   long docs;
+   double bytes;
+   double ns[E2E_STAGES];   /* time of each stage */
+   double counts[NUM_COUNTERS];   /* cf. counter_names[] (< 0 if unavailable) */
+} e2e_result_str_typ;
+
+/* a calendar being generated in memory (cf. mem_sink()) */
+typedef struct {
+   char *data;
+   size_t len, size;
+} mem_buf_str_typ;
+
+/* ---------------------------------------------------------------------------
+
+   Data Declarations (including externals)
+
+*/
+
+static int errors = 0;
+static unsigned long seed = 12345UL;
+
+/* where the kernels store their results, so they can't be optimized away */
+static volatile double bench_sink;
+
+static phase_grid_str_typ bench_grid;
+static phase_table_str_typ bench_tbl;
+
+static char *json_file = NULL;   /* -o */
+static int repeats = BENCH_REPEATS;   /* -r */
+static int e2e_years = E2E_YEARS;   /* -n */
+
+static char *stage_names[E2E_STAGES] = { "args", "phases", "postscript", "output" };
+static char *counter_names[NUM_COUNTERS] = { "cycles", "instructions", "cache_misses" };
+
+/* the layout modes: -p/-l x (none)/-S/-O x (none)/-W x default/colored
+   shading (filled in by init_modes()) */
+#define NUM_MODES	24
+static e2e_mode_str_typ modes[NUM_MODES];
+
+static e2e_output_str_typ outputs[] = {
+   { "devnull",	"/dev/null" },
+   { "tmpfs",	"/dev/shm/lcalbench.ps" },
+   { "memory",	NULL },
+};
+
+#define NUM_OUTPUTS	((int) (sizeof(outputs) / sizeof(outputs[0])))
+
+static e2e_result_str_typ results[NUM_MODES][NUM_OUTPUTS];
+
+/* the default options, restored before each calendar's flags are parsed */
+static int dflt_rotate, dflt_compressed, dflt_odd_days, dflt_weekdays;
+static char dflt_shading[STRSIZ];
+
+/* hardware counters (cf. perf_event_open()) - leader first */
+static int counter_fd[NUM_COUNTERS] = { -1, -1, -1 };
+
+/* ---------------------------------------------------------------------------
+
+   uniform
+
+   Notes:
+
+      This routine returns a pseudo-random number in the range 0 .. 1 (the
+      same sequence on every run).
+
+*/
+static double uniform (void)
+{
+   seed = seed * 1103515245UL + 12345UL;
+   return (double) ((seed >> 8) & 0xffffffUL) / 16777216.0;
+}
+
+/* ---------------------------------------------------------------------------
+
+   compare
+
+   Notes:
+
+      This routine compares the string 'got' (of length 'end' - 'got') with
+      'want', reporting the first few mismatches.
+
+*/
+static void compare (char *what, double x, char *got, char *end, char *want)
+{
+   *end = '\0';
+   if (strcmp(got, want) != 0 && errors++ < 10) {
+      fprintf(stderr, "lcalbench: %s(%.17g) gave \"%s\", expected \"%s\"\n",
+              what, x, got, want);
+   }
+}
+
+/* ---------------------------------------------------------------------------
+
+   check_fmt
+
+   Notes:
+
+      This routine checks the formatting routines against 'sprintf()'.
+
+*/
+static void check_fmt (void)
+{
+   static long ints[] = { 0L, 1L, -1L, 9L, 10L, -10L, 99L, 100L, 12345L,
+                          LONG_MAX, LONG_MIN, LONG_MIN + 1 };
+   char got[100], want[100];
+   double x;
+   long i, n;
+   int prec, w;
+
+   for (i = 0; i <= 100000L; i++) {
+      x = i / 100000.0;
+      sprintf(want, "%.3f", x >= 0.9995 ? 0.0 : x);
+      compare("fmt_phase", x, got, fmt_phase(got, x), want);
+   }
+   for (i = 0; i < 2000; i++) {
+      x = i / 2000.0;
+      sprintf(want, "%.3f", x >= 0.9995 ? 0.0 : x);
+      compare("fmt_phase", x, got, fmt_phase(got, x), want);
+   }
+   for (i = 0; i < NUM_SAMPLES; i++) {
+      x = uniform();
+      sprintf(want, "%.3f", x >= 0.9995 ? 0.0 : x);
+      compare("fmt_phase", x, got, fmt_phase(got, x), want);
+   }
+
+   for (i = 0; i < NUM_SAMPLES; i++) {
+      prec = (int) (i % (FMT_MAX_PREC + 1));
+      switch (i % 4) {
+      case 0:  x = uniform(); break;
+      case 1:  x = (uniform() - 0.5) * 2000.0; break;
+      case 2:  x = (double) (long) ((uniform() - 0.5) * 20000.0) / 2000.0; break;
+      default: x = (uniform() - 0.5) * 2E-3; break;
+      }
+      sprintf(want, "%.*f", prec, x);
+      compare("fmt_fixed", x, got, fmt_fixed(got, x, prec), want);
+   }
+
+   for (i = 0; i < (long) (sizeof(ints) / sizeof(ints[0])) + NUM_SAMPLES; i++) {
+      n = i < (long) (sizeof(ints) / sizeof(ints[0])) ? ints[i] :
+         (long) ((uniform() - 0.5) * 2E6);
+      sprintf(want, "%ld", n);
+      compare("fmt_int", (double) n, got, fmt_int(got, n), want);
+      w = (int) (i % 8);
+      sprintf(want, "%*ld", w, n);
+      compare("fmt_int_w", (double) n, got, fmt_int_w(got, n, w), want);
+   }
+}
+
+/* ---------------------------------------------------------------------------
+
+   The kernels
+
+   Notes:
+
+      Each of these routines makes 'n' calls to the routine it is named
+      after, with arguments varying from call to call (dates over 1900 ..
+      2099, for instance, so that the year table is exercised as in a real
+      run of 'lcal' with many years).
+
+*/
+static void run_calc_phase (long n)
+{
+   double total = 0.0;
+   long i;
+
+   for (i = 0; i < n; i++) total += calc_phase((int) (i % 12) + 1, (int) (i % 28) + 1, 1900 + (int) (i % 200));
+   bench_sink = total;
+}
+
+static void run_jdn (long n)
+{
+   long i, total = 0;
+
+   for (i = 0; i < n; i++) total += jdn((int) (i % 12) + 1, (int) (i % 28) + 1, 1900 + (int) (i % 200));
+   bench_sink = (double) total;
+}
+
+static void run_kepler (long n)
+{
+   double total = 0.0;
+   long i;
+
+   for (i = 0; i < n; i++) total += kepler((double) (i % 3600) * 0.1, ECC_EARTH);
+   bench_sink = total;
+}
+
+static void run_calc_weekday (long n)
+{
+   long i, total = 0;
+
+   for (i = 0; i < n; i++) total += calc_weekday((int) (i % 12) + 1, (int) (i % 28) + 1, 1900 + (int) (i % 200));
+   bench_sink = (double) total;
+}
+
+static void run_engine_age (long n)
+{
+   double total = 0.0;
+   long i;
+
+   for (i = 0; i < n; i++) total += engine_age(BENCH_JD0 + (double) (i % 73000) * 1.001);
+   bench_sink = total;
+}
+
+static void run_moontool (long n)
+{
+   set_phase_engine("moontool");
+   run_engine_age(n);
+}
+
+static void run_fast (long n)
+{
+   set_phase_engine("fast");
+   run_engine_age(n);
+   set_phase_engine(DEFAULT_ENGINE);
+}
+
+static void run_meeus (long n)
+{
+   set_phase_engine("meeus");
+   run_engine_age(n);
+   set_phase_engine(DEFAULT_ENGINE);
+}
+
+static void run_grid_phase (long n)
+{
+   double total = 0.0, span = bench_grid.npoints * PHASE_GRID_STEP - 4 * PHASE_GRID_STEP;
+   long i;
+
+   for (i = 0; i < n; i++) {
+      total += grid_phase(&bench_grid, bench_grid.jd0 + 2 * PHASE_GRID_STEP + fmod(i * 0.37, span));
+   }
+   bench_sink = total;
+}
+
+static void run_calc_phase_table (long n)
+{
+   long i;
+
+   for (i = 0; i < n; i++) calc_phase_table(&bench_tbl, 1, 1900 + (int) (i % 200), 12);
+   bench_sink = bench_tbl.phase[0][0];
+}
+
+static void run_calc_rise_set_table (long n)
+{
+   short rise[31][MAX_MONTHS], set[31][MAX_MONTHS];
+   long i, total = 0;
+
+   for (i = 0; i < n; i++) {
+      calc_rise_set_table(&bench_tbl, 40.71, -74.01, rise, set);
+      total += rise[i % 31][i % 12];
+   }
+   bench_sink = (double) total;
+}
+
+static void run_fmt_phase (long n)
+{
+   char buf[100];
+   double total = 0.0;
+   long i;
+
+   for (i = 0; i < n; i++) {
+      fmt_phase(buf, (i % 10000) / 10000.0);
+      total += buf[4];
+   }
+   bench_sink = total;
+}
+
+static void run_sprintf_phase (long n)
+{
+   char buf[100];
+   double total = 0.0;
+   long i;
+
+   for (i = 0; i < n; i++) {
+      sprintf(buf, "%.3f", (i % 10000) / 10000.0);
+      total += buf[4];
+   }
+   bench_sink = total;
+}
+
+static kernel_str_typ kernels[] = {
+   { "calc_phase",		run_calc_phase },
+   { "jdn",			run_jdn },
+   { "kepler",			run_kepler },
+   { "calc_weekday",		run_calc_weekday },
+   { "engine_age/moontool",	run_moontool },
+   { "engine_age/fast",		run_fast },
+   { "engine_age/meeus",	run_meeus },
+   { "grid_phase",		run_grid_phase },
+   { "calc_phase_table",	run_calc_phase_table },
+   { "calc_rise_set_table",	run_calc_rise_set_table },
+   { "fmt_phase",		run_fmt_phase },
+   { "sprintf_phase",		run_sprintf_phase },
+};
+
+#define NUM_KERNELS	((int) (sizeof(kernels) / sizeof(kernels[0])))
+
+/* ---------------------------------------------------------------------------
+
+   now_ns
+
+   Notes:
+
+      This routine returns the time in nanoseconds from an arbitrary
+      origin: monotonic wall-clock time where available, and otherwise
+      processor time.
+
+*/
+static double now_ns (void)
+{
+#if defined (BUILD_ENV_UNIX) && defined (CLOCK_MONOTONIC)
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec * 1E9 + ts.tv_nsec;
+#else
+   return clock() * (1E9 / CLOCKS_PER_SEC);
+#endif
+}
+
+/* ---------------------------------------------------------------------------
+
+   pin_cpu
+
+   Notes:
+
+      This routine pins the program to the processor it is running on, and
+      returns its number (or -1 if it can't).
+
+*/
+static int pin_cpu (void)
+{
+#ifdef __linux__
+   cpu_set_t set;
+   int cpu;
+
+   if ((cpu = sched_getcpu()) < 0) return -1;
+   CPU_ZERO(&set);
+   CPU_SET(cpu, &set);
+   return sched_setaffinity(0, sizeof(set), &set) == 0 ? cpu : -1;
+#else
+   return -1;
+#endif
+}
+
+/* ---------------------------------------------------------------------------
+
+   cmp_double
+
+   Notes:
+
+      This routine compares 2 doubles for 'qsort()'.
+
+*/
+static int cmp_double (const void *a, const void *b)
+{
+   double x = *(const double *) a, y = *(const double *) b;
+
+   return x < y ? -1 : x > y;
+}
+
+/* ---------------------------------------------------------------------------
+
+   time_kernel
+
+   Notes:
+
+      This routine times the kernel 'pk' as described above, and fills in
+      '*pt'.
+
+*/
+static void time_kernel (kernel_str_typ *pk, timing_str_typ *pt)
+{
+   static double ns[MAX_REPEATS];
+   double t0, sum = 0.0, var = 0.0;
+   long n;
+   int i;
+
+   /* calibrate the number of calls per loop */
+   for (n = 1; ; n *= 2) {
+      t0 = now_ns();
+      (*pk->run)(n);
+      if (now_ns() - t0 >= BENCH_MIN_NS || n >= LONG_MAX / 4) break;
+   }
+   (*pk->run)(n);   /* (warm-up) */
+
+   for (i = 0; i < repeats; i++) {
+      t0 = now_ns();
+      (*pk->run)(n);
+      ns[i] = (now_ns() - t0) / n;
+      sum += ns[i];
+   }
+   pt->calls = n;
+   pt->mean = sum / repeats;
+   for (i = 0; i < repeats; i++) var += (ns[i] - pt->mean) * (ns[i] - pt->mean);
+   pt->stddev = repeats > 1 ? sqrt(var / (repeats - 1)) : 0.0;
+
+   qsort(ns, repeats, sizeof(ns[0]), cmp_double);
+   pt->min = ns[0];
+   pt->max = ns[repeats - 1];
+   pt->median = repeats % 2 ? ns[repeats / 2] : (ns[repeats / 2 - 1] + ns[repeats / 2]) / 2;
+}
+
+/* ---------------------------------------------------------------------------
+
+   selected
+
+   Notes:
+
+      This routine returns TRUE if the kernel 'name' is among the 'nnames'
+      names at 'names' (or if there are none).
+
+*/
+static int selected (char *name, char **names, int nnames)
+{
+   int i;
+
+   for (i = 0; i < nnames; i++) {
+      if (strcmp(name, names[i]) == 0) return TRUE;
+   }
+   return nnames == 0;
+}
+
+/* ---------------------------------------------------------------------------
+
+   counters_open
+
+   Notes:
+
+      This routine opens a group of hardware counters (cf. counter_names[])
+      for this process, counting in user mode only, as allowed with the
+      default 'perf_event_paranoid' setting.  It returns FALSE if they
+      aren't available (e.g. in most virtual machines).
+
+*/
+static int counters_open (void)
+{
+#ifdef __linux__
+   static unsigned long long config[NUM_COUNTERS] = {
+      PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES
+   };
+   struct perf_event_attr pa;
+   int i;
+
+   for (i = 0; i < NUM_COUNTERS; i++) {
+      memset(&pa, 0, sizeof(pa));
+      pa.size = sizeof(pa);
+      pa.type = PERF_TYPE_HARDWARE;
+      pa.config = config[i];
+      pa.disabled = i == 0;
+      pa.exclude_kernel = 1;
+      pa.exclude_hv = 1;
+      pa.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED |
+         PERF_FORMAT_TOTAL_TIME_RUNNING;
+      counter_fd[i] = (int) syscall(__NR_perf_event_open, &pa, 0, -1, i ? counter_fd[0] : -1, 0);
+      if (counter_fd[i] < 0) {
+         while (--i >= 0) {
+            close(counter_fd[i]);
+            counter_fd[i] = -1;
+         }
+         return FALSE;
+      }
+   }
+   return TRUE;
+#else
+   return FALSE;
+#endif
+}
+
+/* ---------------------------------------------------------------------------
+
+   counters_start, counters_stop
+
+   Notes:
+
+      These routines reset and start the counters, and stop them and store
+      their counts (scaled up if the counters had to be multiplexed) in
+      'counts[]' -- or -1 if there are no counters.
+
+*/
+static void counters_start (void)
+{
+#ifdef __linux__
+   if (counter_fd[0] < 0) return;
+   ioctl(counter_fd[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+   ioctl(counter_fd[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+#endif
+}
+
+static void counters_stop (double *counts)
+{
+#ifdef __linux__
+   unsigned long long buf[3 + NUM_COUNTERS];   /* nr, time enabled, time running, values */
+   double scale;
+   int i;
+
+   if (counter_fd[0] >= 0) {
+      ioctl(counter_fd[0], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+      if (read(counter_fd[0], buf, sizeof(buf)) == (ssize_t) sizeof(buf) && buf[0] == NUM_COUNTERS) {
+         scale = buf[2] > 0 ? (double) buf[1] / buf[2] : 0.0;
+         for (i = 0; i < NUM_COUNTERS; i++) counts[i] = buf[3 + i] * scale;
+         return;
+      }
+   }
+#endif
+   memset(counts, 0, NUM_COUNTERS * sizeof(counts[0]));
+   counts[0] = counts[1] = counts[2] = -1.0;
+}
+
+/* ---------------------------------------------------------------------------
+
+   init_modes
+
+   Notes:
+
+      This routine fills in 'modes[]' with every combination of the layout
+      flags, and saves the default options.
+
+*/
+static void init_modes (void)
+{
+   static char names[NUM_MODES][12], flags[NUM_MODES][STRSIZ];
+   static char *compress[3] = { "", "S", "O" };
+   int m, c, w, s, i = 0;
+
+   for (m = 0; m < 2; m++) {
+      for (c = 0; c < 3; c++) {
+         for (w = 0; w < 2; w++) {
+            for (s = 0; s < 2; s++, i++) {
+               sprintf(names[i], "%c%s%s%s", m ? 'l' : 'p', compress[c], w ? "W" : "",
+                       s ? "+color" : "");
+               sprintf(flags[i], "-%c%s%s%s%s%s", m ? F_LANDSCAPE : F_PORTRAIT, *compress[c] ? " -" : "",
+                       compress[c], w ? " -W" : "", s ? " -s " : "", s ? COLOR_SHADING : "");
+               modes[i].name = names[i];
+               modes[i].flags = flags[i];
+            }
+         }
+      }
+   }
+
+   dflt_rotate = rotate;
+   dflt_compressed = compressed_singlepage;
+   dflt_odd_days = odd_days_singlepage;
+   dflt_weekdays = draw_day_of_week_inside_moon;
+   strcpy(dflt_shading, shading);
+}
+
+/* ---------------------------------------------------------------------------
+
+   mem_sink
+
+   Notes:
+
+      This routine is the PostScript output sink (cf. set_ps_sink()) which
+      appends the output to the memory buffer 'ctx', growing it as needed.
+
+*/
+static int mem_sink (void *ctx, const char *data, size_t len)
+{
+   mem_buf_str_typ *pm = (mem_buf_str_typ *) ctx;
+   char *p;
+   size_t size;
+
+   if (pm->len + len > pm->size) {
+      for (size = pm->size ? pm->size : 64 * 1024; size < pm->len + len; size *= 2)
+         ;
+      if ((p = (char *) realloc(pm->data, size)) == NULL) return 1;
+      pm->data = p;
+      pm->size = size;
+   }
+   memcpy(pm->data + pm->len, data, len);
+   pm->len += len;
+   return 0;
+}
+
+/* ---------------------------------------------------------------------------
+
+   generate_doc
+
+   Notes:
+
+      This routine generates the calendar for 'year' in layout mode 'pmode'
+      and writes it to the output 'pout', adding the time of each stage to
+      'pr'.  It returns FALSE if anything fails.
+
+*/
+static int generate_doc (e2e_mode_str_typ *pmode, e2e_output_str_typ *pout, int year, mem_buf_str_typ *pm,
+                         e2e_result_str_typ *pr)
+{
+   char buf[2 * STRSIZ], *argv[MAXWORD];
+   double t0, t1, t2, t3, t4;
+   ssize_t n;
+   size_t len;
+   int fd, ok = TRUE;
+
+   t0 = now_ns();
+
+   /* parse the flags, as lcal would */
+   sprintf(buf, "lcalbench %s %d", pmode->flags, year);
+   (void) loadwords(argv, buf);
+   rotate = dflt_rotate;
+   compressed_singlepage = dflt_compressed;
+   odd_days_singlepage = dflt_odd_days;
+   draw_day_of_week_inside_moon = dflt_weekdays;
+   strcpy(shading, dflt_shading);
+   if (!get_args(argv, P_CMD1, "lcalbench")) return FALSE;
+   t1 = now_ns();
+
+   calc_phase_table(&bench_tbl, init_month, init_year, num_months);
+   t2 = now_ns();
+
+   pm->len = 0;
+   set_ps_sink(mem_sink, pm);
+   write_psfile(&bench_tbl);
+   if (ps_sink_error()) ok = FALSE;
+   set_ps_sink(NULL, NULL);
+   t3 = now_ns();
+
+#ifdef BUILD_ENV_UNIX
+   if (pout->path) {
+      if ((fd = open(pout->path, O_WRONLY | O_CREAT | O_TRUNC, 0666)) < 0) return FALSE;
+      for (len = 0; ok && len < pm->len; len += n) {
+         if ((n = write(fd, pm->data + len, pm->len - len)) <= 0) ok = FALSE;
+      }
+      if (close(fd) != 0) ok = FALSE;
+   }
+#else
+   (void) fd;
+   (void) n;
+   (void) len;
+#endif
+   t4 = now_ns();
+
+   pr->docs++;
+   pr->bytes += pm->len;
+   pr->ns[0] += t1 - t0;
+   pr->ns[1] += t2 - t1;
+   pr->ns[2] += t3 - t2;
+   pr->ns[3] += t4 - t3;
+   return ok;
+}
+
+/* ---------------------------------------------------------------------------
+
+   run_e2e
+
+   Notes:
+
+      This routine generates 'e2e_years' calendars in each mode for each
+      output (after one calendar as a warm-up), printing the results as it
+      goes.  It returns FALSE if anything fails.
+
+*/
+static int run_e2e (void)
+{
+   mem_buf_str_typ mem;
+   e2e_result_str_typ *pr, warm;
+   double total;
+   int m, o, y, counters;
+
+   init_modes();
+   counters = counters_open();
+#ifdef BUILD_ENV_UNIX
+   if (access("/dev/shm", W_OK) != 0) {   /* (no tmpfs - use a plain file) */
+      outputs[1].name = "tmpfile";
+      outputs[1].path = "/tmp/lcalbench.ps";
+   }
+#endif
+   memset(&mem, 0, sizeof(mem));
+
+   printf("\ncalendars: %d per mode and output, hardware counters %s\n", e2e_years,
+          counters ? "available" : "unavailable");
+   printf("%-12s %-8s %9s %9s %10s %10s %10s %10s %6s %10s\n", "mode", "output", "docs/sec", "MB/sec",
+          "args us", "phases us", "ps us", "output us", "IPC", "miss/doc");
+
+   for (m = 0; m < NUM_MODES; m++) {
+      for (o = 0; o < NUM_OUTPUTS; o++) {
+         pr = &results[m][o];
+         memset(pr, 0, sizeof(*pr));
+         memset(&warm, 0, sizeof(warm));
+         if (!generate_doc(&modes[m], &outputs[o], E2E_FIRST_YEAR, &mem, &warm)) {
+            fprintf(stderr, "lcalbench: can't generate calendar (%s) to %s\n", modes[m].flags,
+                    outputs[o].path ? outputs[o].path : "memory");
+            free(mem.data);
+            return FALSE;
+         }
+
+         counters_start();
+         for (y = 0; y < e2e_years; y++) {
+            if (!generate_doc(&modes[m], &outputs[o], E2E_FIRST_YEAR + y, &mem, pr)) break;
+         }
+         counters_stop(pr->counts);
+
+         total = pr->ns[0] + pr->ns[1] + pr->ns[2] + pr->ns[3];
+         printf("%-12s %-8s %9.0f %9.1f %10.1f %10.1f %10.1f %10.1f ", modes[m].name, outputs[o].name,
+                1E9 * pr->docs / total, 1E3 * pr->bytes / total, pr->ns[0] / pr->docs / 1E3,
+                pr->ns[1] / pr->docs / 1E3, pr->ns[2] / pr->docs / 1E3, pr->ns[3] / pr->docs / 1E3);
+         if (pr->counts[0] > 0.0) {
+            printf("%6.2f %10.0f\n", pr->counts[1] / pr->counts[0], pr->counts[2] / pr->docs);
+         }
+         else printf("%6s %10s\n", "-", "-");
+         fflush(stdout);
+      }
+   }
+
+#ifdef BUILD_ENV_UNIX
+   (void) unlink(outputs[1].path);
+#endif
+   free(mem.data);
+   return TRUE;
+}
+
+/* ---------------------------------------------------------------------------
+
+   write_json
+
+   Notes:
+
+      This routine writes the results as JSON to 'fp'.
+
+*/
+static void write_json (FILE *fp, int cpu, timing_str_typ *timings, char **names, int nnames)
+{
+   e2e_result_str_typ *pr;
+   double total;
+   int i, m, o, first = TRUE;
+
+   fprintf(fp, "{\n  \"program\": \"lcalbench\",\n  \"pinned_cpu\": %d,\n  \"repeats\": %d,\n", cpu, repeats);
+   fprintf(fp, "  \"min_loop_ns\": %.0f,\n  \"kernels\": [", BENCH_MIN_NS);
+   for (i = 0; i < NUM_KERNELS; i++) {
+      if (!selected(kernels[i].name, names, nnames)) continue;
+      fprintf(fp, "%s\n    { \"name\": \"%s\", \"calls_per_loop\": %ld, \"ns_per_call\": %.3f,"
+              " \"ns_mean\": %.3f, \"ns_min\": %.3f, \"ns_max\": %.3f, \"ns_stddev\": %.3f,"
+              " \"calls_per_sec\": %.0f }", first ? "" : ",", kernels[i].name, timings[i].calls,
+              timings[i].median, timings[i].mean, timings[i].min, timings[i].max,
+              timings[i].stddev, 1E9 / timings[i].median);
+      first = FALSE;
+   }
+   fprintf(fp, "\n  ],\n  \"documents\": [");
+
+   first = TRUE;
+   for (m = 0; e2e_years > 0 && m < NUM_MODES; m++) {
+      for (o = 0; o < NUM_OUTPUTS; o++) {
+         pr = &results[m][o];
+         total = pr->ns[0] + pr->ns[1] + pr->ns[2] + pr->ns[3];
+         fprintf(fp, "%s\n    { \"mode\": \"%s\", \"flags\": \"%s\", \"output\": \"%s\", \"docs\": %ld,"
+                 " \"bytes\": %.0f, \"docs_per_sec\": %.1f, \"bytes_per_sec\": %.0f,",
+                 first ? "" : ",", modes[m].name, modes[m].flags, outputs[o].name, pr->docs, pr->bytes,
+                 1E9 * pr->docs / total, 1E9 * pr->bytes / total);
+         for (i = 0; i < E2E_STAGES; i++) {
+            fprintf(fp, " \"ns_%s\": %.0f,", stage_names[i], pr->ns[i] / pr->docs);
+         }
+         for (i = 0; i < NUM_COUNTERS; i++) {
+            if (pr->counts[i] < 0.0) fprintf(fp, " \"%s\": null%s", counter_names[i], i < NUM_COUNTERS - 1 ? "," : "");
+            else fprintf(fp, " \"%s\": %.0f%s", counter_names[i], pr->counts[i] / pr->docs,
+                         i < NUM_COUNTERS - 1 ? "," : "");
+         }
+         fprintf(fp, " }");
+         first = FALSE;
+      }
+   }
+   fprintf(fp, "\n  ]\n}\n");
+}
+
+/* ---------------------------------------------------------------------------
+
+   main
+
+*/
+int main (int argc, char **argv)
+{
+   static timing_str_typ timings[NUM_KERNELS];
+   FILE *fp = NULL;
+   char **names;
+   int cpu, nnames, i, k;
+
+   for (i = 1; i < argc && argv[i][0] == '-' && argv[i][1]; i++) {
+      if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) json_file = argv[++i];
+      else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc &&
+               (repeats = atoi(argv[++i])) >= 1 && repeats <= MAX_REPEATS)
+         ;
+      else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc && (e2e_years = atoi(argv[++i])) >= 0)
+         ;
+      else {
+         fprintf(stderr, "usage: lcalbench [-o FILE] [-r REPEATS (1 .. %d)] [-n YEARS] [KERNEL ...]\n",
+                 MAX_REPEATS);
+         exit(EXIT_FAILURE);
+      }
+   }
+   names = argv + i;
+   nnames = argc - i;
+   for (i = 0; i < nnames; i++) {
+      for (k = 0; k < NUM_KERNELS && strcmp(names[i], kernels[k].name) != 0; k++)
+         ;
+      if (k == NUM_KERNELS) {
+         fprintf(stderr, "lcalbench: unknown kernel \"%s\"\n", names[i]);
+         exit(EXIT_FAILURE);
+      }
+   }
+
+   check_fmt();
+   if (errors) {
+      fprintf(stderr, "lcalbench: %d formatting mismatches\n", errors);
+      exit(EXIT_FAILURE);
+   }
+   printf("formatting: output identical to sprintf()\n");
+
+   if (json_file && (fp = strcmp(json_file, "-") == 0 ? stdout : fopen(json_file, "w")) == NULL) {
+      fprintf(stderr, "lcalbench: can't open file %s\n", json_file);
+      exit(EXIT_FAILURE);
+   }
+
+   /* set up the data for the grid and table kernels */
+   init_names("lcalbench");
+   if (!calc_phase_grid(&bench_grid, 1, 2025, 12)) {
+      fprintf(stderr, "lcalbench: out of memory\n");
+      exit(EXIT_FAILURE);
+   }
+   calc_phase_table(&bench_tbl, 1, 2025, 12);
+
+   cpu = pin_cpu();
+   printf("timing on %s, %d repeats (ns/call)\n", cpu >= 0 ? "1 pinned processor" : "unpinned processor(s)",
+          repeats);
+   printf("%-22s %12s %12s %12s %12s %9s %14s\n", "kernel", "median", "mean", "min", "max", "stddev%",
+          "calls/sec");
+
+   for (i = 0; i < NUM_KERNELS; i++) {
+      if (!selected(kernels[i].name, names, nnames)) continue;
+      time_kernel(&kernels[i], &timings[i]);
+      printf("%-22s %12.1f %12.1f %12.1f %12.1f %8.1f%% %14.0f\n", kernels[i].name, timings[i].median,
+             timings[i].mean, timings[i].min, timings[i].max,
+             100.0 * timings[i].stddev / timings[i].mean, 1E9 / timings[i].median);
+      fflush(stdout);
+   }
+
+   if (e2e_years > 0 && !run_e2e()) exit(EXIT_FAILURE);
+
+   if (fp) {
+      write_json(fp, cpu, timings, names, nnames);
+      if (fp != stdout && fclose(fp) != 0) {
+         fprintf(stderr, "lcalbench: can't write file %s\n", json_file);
+         exit(EXIT_FAILURE);
+      }
+   }
+
+   free(bench_grid.age);
+   exit(EXIT_SUCCESS);
+}
@@ -0,0 +1,592 @@
+/* ---------------------------------------------------------------------------
+
+   lcalcache.c
+
+   Notes:
+
+      This file contains routines to maintain a local on-disk cache of
+      generated calendars (cf. the 'LCAL_CACHE_DIR' environment variable)
+      and a persistent cache of moon phase tables (cf. 'LCAL_PHASE_CACHE').
+
+      A calendar generated in reproducible mode (cf. '-R') depends only on
+      the options and the year, so it can be stored under a hash of the
+      (canonical) options and served again, without being regenerated, the
+      next time the same calendar is requested.  Cached calendars are copied
+      to the output by reflink or 'copy_file_range()' where the file system
+      supports it, and the total size of the cache is bounded by discarding
+      the least-recently-used calendars.
+
+      The phase table cache lets calendars which differ only in styling
+      (colors, fonts, layout) skip the ephemeris calculations.  It is a single
+      file of fixed-size slots, indexed by a hash of the table's key (months,
+      time zone offsets, engine, ephemeris file, and algorithm version) and
+      shared via 'mmap()' by any number of concurrent 'lcal' processes.
+      Each slot is guarded by a sequence lock: a writer claims the slot by
+      making its sequence number odd and releases it by making it even
+      again, and readers never lock anything -- they just retry (or give up)
+      if the sequence number was odd or changed while the slot was being
+      copied.  The writer's process ID is kept in the lock word beside the
+      sequence number, so that a slot left odd by a writer which died while
+      writing it can be taken over by the next one.
+
+      The caches are only supported in the Unix build environment.
+
+*/
+
+/* ---------------------------------------------------------------------------
+
+   Header Files
+
+*/
+
+#ifdef __linux__
+#define _GNU_SOURCE   /* for 'copy_file_range()' */
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef BUILD_ENV_UNIX
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <utime.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#ifdef __linux__
+#include <linux/fs.h>
+#endif
+#endif
+
+/*
+ * Lcal-specific definitions:
+ */
+#include "lcaldefs.h"
+
+#ifdef BUILD_ENV_UNIX
+
+/* ---------------------------------------------------------------------------
+
+   Type, Struct, & Enum Declarations
+
+*/
+
+typedef struct {
+   char name[STRSIZ];   /* file name within cache directory */
+   time_t mtime;   /* time of last use */
+   off_t size;
+} cache_entry_str_typ;
+
+typedef struct {
+   unsigned long long seq;   /* sequence lock (odd while being written, with
+                                the writer's process ID in the upper half) */
+   char key[PHASE_KEY_SIZE];   /* cf. phase_cache_fetch() */
+   phase_table_str_typ tbl;
+} phase_slot_str_typ;
+
+typedef struct {
+   unsigned int magic;   /* PHASE_CACHE_MAGIC (or 0 if new) */
+   unsigned int nslots;
+   phase_slot_str_typ slot[PHASE_CACHE_SLOTS];
+} phase_cache_str_typ;
+
+/* ---------------------------------------------------------------------------
+
+   Constant Declarations
+
+*/
+
+#define CACHE_SUFFIX	".ps"		/* suffix of cached calendars */
+#define CACHE_TMP	"tmp-XXXXXX"	/* template for calendars being stored */
+#define CACHE_TMP_PREFIX_LEN	4	/* (its fixed part, "tmp-") */
+#define CACHE_TMP_AGE	3600	/* age (secs) after which one is abandoned */
+
+#define FNV_OFFSET	0xcbf29ce484222325ULL	/* 64-bit FNV-1a hash */
+#define FNV_PRIME	0x100000001b3ULL
+
+#define COPY_BUFSIZ	65536
+
+#define PHASE_CACHE_MAGIC	0x4c435033	/* "LCP3" (bump on layout change) */
+#define PHASE_READ_TRIES	4	/* retries while a slot is being written */
+
+#define SEQ_COUNT(seq)	((unsigned int) (seq))	/* parts of a slot's lock word */
+#define SEQ_WRITER(seq)	((pid_t) ((seq) >> 32))
+#define SEQ_MAKE(count, pid)	((unsigned long long) (unsigned int) (count) | \
+				 (unsigned long long) (unsigned int) (pid) << 32)
+
+/* ---------------------------------------------------------------------------
+
+   Data Declarations (including externals)
+
+*/
+
+static char tmp_path[LINSIZ];   /* calendar being added to the cache */
+static int saved_stdout = -1;
+
+static phase_cache_str_typ *phase_cache = NULL;   /* mapped phase cache */
+static int phase_cache_state = 0;   /* 0 = not yet mapped, -1 = unusable */
+
+/* ---------------------------------------------------------------------------
+
+   cache_dir
+
+   Notes:
+
+      This routine returns the cache directory, or NULL if caching is not
+      enabled.
+
+*/
+static char * cache_dir (void)
+{
+   char *p;
+
+   return (p = getenv(LCAL_CACHE_ENV)) != NULL && *p ? p : NULL;
+}
+
+/* ---------------------------------------------------------------------------
+
+   copy_fd
+
+   Notes:
+
+      This routine copies the entire contents of file descriptor 'in' to
+      file descriptor 'out', by reflink if possible and 'clone' is TRUE,
+      else by 'copy_file_range()' (which may itself share or offload the
+      data), and else by reading and writing.
+
+      A reflink replaces the whole of the destination file, whatever its
+      offset, so 'clone' may only be TRUE if 'out' is a file the caller has
+      just created (and not, for instance, an inherited stdout).
+
+      It returns TRUE on success.
+
+*/
+static int copy_fd (int in, int out, int clone)
+{
+   char buf[COPY_BUFSIZ];
+   ssize_t n, m, done;
+
+#ifdef FICLONE
+   if (clone && ioctl(out, FICLONE, in) == 0) return lseek(out, 0, SEEK_END) >= 0;
+#else
+   (void) clone;
+#endif
+
+#ifdef __linux__
+   while ((n = copy_file_range(in, NULL, out, NULL, COPY_BUFSIZ * 16, 0)) > 0)
+      ;
+   if (n == 0) return TRUE;
+   if (errno != EXDEV && errno != EINVAL && errno != EBADF && errno != ENOSYS &&
+       errno != EOPNOTSUPP) return FALSE;
+#endif
+
+   /* fall back to plain reads and writes (from where we left off) */
+   while ((n = read(in, buf, sizeof(buf))) > 0) {
+      for (done = 0; done < n; done += m) {
+         if ((m = write(out, buf + done, n - done)) < 0) return FALSE;
+      }
+   }
+   return n == 0;
+}
+
+/* ---------------------------------------------------------------------------
+
+   hash_string
+
+   Notes:
+
+      This routine returns the 64-bit FNV-1a hash of the string 's'.
+
+*/
+static unsigned long long hash_string (char *s)
+{
+   unsigned long long hash = FNV_OFFSET;
+
+   for (; *s; s++) {
+      hash ^= (unsigned char) *s;
+      hash *= FNV_PRIME;
+   }
+   return hash;
+}
+
+/* ---------------------------------------------------------------------------
+
+   cache_path
+
+   Notes:
+
+      This routine stores in 'path' the name of the cache file for the
+      calendar whose canonical options are 'options'.  It returns FALSE if
+      caching is not enabled.
+
+*/
+int cache_path (char *path, char *options)
+{
+   char *dir;
+
+   if ((dir = cache_dir()) == NULL || strlen(dir) + 24 >= LINSIZ) return FALSE;
+
+   sprintf(path, "%s%c%016llx%s", dir, END_PATH, hash_string(options), CACHE_SUFFIX);
+   return TRUE;
+}
+
+/* ---------------------------------------------------------------------------
+
+   cache_fetch
+
+   Notes:
+
+      This routine copies the cached calendar 'path' (if there is one) to the
+      file 'dest' (or, if 'dest' is NULL, to stdout).
+
+      It returns TRUE if the calendar was found in the cache and copied.
+
+*/
+int cache_fetch (char *path, char *dest)
+{
+   int in, out, ok;
+
+   if ((in = open(path, O_RDONLY)) < 0) return FALSE;
+
+   if (dest) out = open(dest, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+   else {
+      fflush(stdout);
+      out = fileno(stdout);
+   }
+
+   ok = out >= 0 && copy_fd(in, out, dest != NULL);
+
+   close(in);
+   if (dest && out >= 0 && close(out) != 0) ok = FALSE;
+
+   /* mark the calendar as recently used */
+   if (ok) utime(path, NULL);
+
+   return ok;
+}
+
+/* ---------------------------------------------------------------------------
+
+   cache_begin
+
+   Notes:
+
+      This routine redirects stdout to a temporary file in the cache
+      directory, in which the calendar to be added to the cache as 'path' is
+      then written (cf. 'cache_end()').
+
+      It returns TRUE on success.
+
+*/
+int cache_begin (char *path)
+{
+   int fd;
+
+   strcpy(tmp_path, path);
+   strcpy(strrchr(tmp_path, END_PATH) + 1, CACHE_TMP);
+
+   if ((fd = mkstemp(tmp_path)) < 0) return FALSE;
+   fchmod(fd, 0644);
+
+   fflush(stdout);
+   if ((saved_stdout = dup(fileno(stdout))) < 0 || dup2(fd, fileno(stdout)) < 0) {
+      if (saved_stdout >= 0) close(saved_stdout);
+      close(fd);
+      unlink(tmp_path);
+      return FALSE;
+   }
+   close(fd);
+   return TRUE;
+}
+
+/* ---------------------------------------------------------------------------
+
+   entry_cmp
+
+   Notes:
+
+      This routine compares two cache entries for 'qsort()', the least
+      recently used first.
+
+*/
+static int entry_cmp (const void *a, const void *b)
+{
+   time_t ta = ((const cache_entry_str_typ *) a)->mtime;
+   time_t tb = ((const cache_entry_str_typ *) b)->mtime;
+
+   return ta < tb ? -1 : ta > tb;
+}
+
+/* ---------------------------------------------------------------------------
+
+   cache_prune
+
+   Notes:
+
+      This routine deletes the least-recently-used calendars from the cache
+      until its total size is within the limit (cf. 'LCAL_CACHE_SIZE').  It
+      also deletes any calendar left half-stored (cf. CACHE_TMP) by a run
+      which crashed, once it is CACHE_TMP_AGE seconds old.
+
+*/
+static void cache_prune (char *dir)
+{
+   DIR *dp;
+   struct dirent *de;
+   struct stat st;
+   cache_entry_str_typ *entries = NULL, *tmp;
+   char path[LINSIZ], *p;
+   long long total = 0, limit;
+   time_t now = time(NULL);
+   int n = 0, max = 0, i, len;
+
+   limit = (p = getenv(LCAL_CACHE_SIZE_ENV)) != NULL && *p ?
+      atoll(p) * 1024 * 1024 : CACHE_SIZE_DEFAULT;
+
+   if ((dp = opendir(dir)) == NULL) return;
+
+   while ((de = readdir(dp)) != NULL) {
+      len = strlen(de->d_name);
+      if (strncmp(de->d_name, CACHE_TMP, CACHE_TMP_PREFIX_LEN) == 0 && len < STRSIZ) {
+         sprintf(path, "%s%c%s", dir, END_PATH, de->d_name);
+         if (stat(path, &st) == 0 && st.st_mtime < now - CACHE_TMP_AGE) unlink(path);
+         continue;
+      }
+      if (len < 5 || len >= STRSIZ ||
+          strcmp(de->d_name + len - strlen(CACHE_SUFFIX), CACHE_SUFFIX) != 0) continue;
+
+      sprintf(path, "%s%c%s", dir, END_PATH, de->d_name);
+      if (stat(path, &st) != 0) continue;
+
+      if (n == max) {
+         max = max ? 2 * max : 64;
+         if ((tmp = (cache_entry_str_typ *) realloc(entries, max * sizeof(*entries))) == NULL) break;
+         entries = tmp;
+      }
+      strcpy(entries[n].name, de->d_name);
+      entries[n].mtime = st.st_mtime;
+      entries[n].size = st.st_size;
+      total += st.st_size;
+      n++;
+   }
+   closedir(dp);
+
+   if (total > limit) {
+      qsort(entries, n, sizeof(*entries), entry_cmp);
+      for (i = 0; i < n && total > limit; i++) {
+         sprintf(path, "%s%c%s", dir, END_PATH, entries[i].name);
+         if (unlink(path) == 0) total -= entries[i].size;
+      }
+   }
+
+   free(entries);
+   return;
+}
+
+/* ---------------------------------------------------------------------------
+
+   cache_end
+
+   Notes:
+
+      This routine restores stdout and adds the calendar written since
+      'cache_begin()' to the cache as 'path' -- or, if 'ok' is FALSE,
+      discards it -- and then trims the cache to size.
+
+*/
+void cache_end (char *path, int ok)
+{
+   char dir[LINSIZ];
+
+   fflush(stdout);
+   dup2(saved_stdout, fileno(stdout));
+   close(saved_stdout);
+   clearerr(stdout);
+
+   if (!ok || rename(tmp_path, path) != 0) {
+      unlink(tmp_path);
+      return;
+   }
+
+   strcpy(dir, path);
+   *strrchr(dir, END_PATH) = '\0';
+   cache_prune(dir);
+   return;
+}
+
+/* ---------------------------------------------------------------------------
+
+   map_phase_cache
+
+   Notes:
+
+      This routine maps the phase table cache file (cf. 'LCAL_PHASE_CACHE'),
+      creating it if necessary, the first time it is called.
+
+      It returns TRUE if the cache is usable.
+
+*/
+static int map_phase_cache (void)
+{
+   struct stat st;
+   char *name;
+   void *addr;
+   int fd;
+
+   if (phase_cache_state) return phase_cache_state > 0;
+   phase_cache_state = -1;
+
+   if ((name = getenv(LCAL_PHASE_CACHE_ENV)) == NULL || !*name) return FALSE;
+
+   if ((fd = open(name, O_RDWR | O_CREAT, 0666)) < 0) return FALSE;
+
+   /* extending a new (or short) file to full size zero-fills it, which is
+      harmless even if another process does so at the same time */
+   if (fstat(fd, &st) != 0 ||
+       (st.st_size < (off_t) sizeof(phase_cache_str_typ) &&
+        ftruncate(fd, sizeof(phase_cache_str_typ)) != 0)) {
+      close(fd);
+      return FALSE;
+   }
+
+   addr = mmap(NULL, sizeof(phase_cache_str_typ), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+   close(fd);
+   if (addr == MAP_FAILED) return FALSE;
+   phase_cache = (phase_cache_str_typ *) addr;
+
+   /* claim a new file for this layout; leave one in any other layout alone */
+   if (__atomic_load_n(&phase_cache->magic, __ATOMIC_ACQUIRE) == 0) {
+      phase_cache->nslots = PHASE_CACHE_SLOTS;
+      __atomic_store_n(&phase_cache->magic, PHASE_CACHE_MAGIC, __ATOMIC_RELEASE);
+   }
+   if (phase_cache->magic != PHASE_CACHE_MAGIC || phase_cache->nslots != PHASE_CACHE_SLOTS) {
+      munmap(addr, sizeof(phase_cache_str_typ));
+      phase_cache = NULL;
+      return FALSE;
+   }
+
+   phase_cache_state = 1;
+   return TRUE;
+}
+
+/* ---------------------------------------------------------------------------
+
+   phase_cache_fetch
+
+   Notes:
+
+      This routine copies the phase table stored under 'key' (a string of
+      fewer than PHASE_KEY_SIZE characters identifying everything the table
+      depends on) from the phase table cache to 'tbl'.
+
+      It returns TRUE if the table was found.
+
+*/
+int phase_cache_fetch (phase_table_str_typ *tbl, char *key)
+{
+   phase_slot_str_typ *ps;
+   unsigned long long seq;
+   int i, found;
+
+   if (strlen(key) >= PHASE_KEY_SIZE || !map_phase_cache()) return FALSE;
+
+   ps = &phase_cache->slot[hash_string(key) % PHASE_CACHE_SLOTS];
+
+   for (i = 0; i < PHASE_READ_TRIES; i++) {
+      if ((seq = __atomic_load_n(&ps->seq, __ATOMIC_ACQUIRE)) & 1) continue;
+
+      found = strncmp(ps->key, key, PHASE_KEY_SIZE) == 0;
+      if (found) memcpy(tbl, &ps->tbl, sizeof(*tbl));
+
+      /* make sure the copy was consistent (no writer got in meanwhile) */
+      __atomic_thread_fence(__ATOMIC_ACQUIRE);
+      if (__atomic_load_n(&ps->seq, __ATOMIC_RELAXED) == seq) {
+         return found && tbl->nmonths > 0 && tbl->nmonths <= MAX_MONTHS;
+      }
+   }
+   return FALSE;
+}
+
+/* ---------------------------------------------------------------------------
+
+   phase_cache_store
+
+   Notes:
+
+      This routine stores the phase table 'tbl' under 'key' in the phase table
+      cache (replacing whatever occupied its slot).  If another process is
+      writing the same slot, it just gives up -- unless that process no
+      longer exists, in which case it takes the slot over.  (A writer which
+      finds its slot taken over meanwhile leaves it alone.)
+
+*/
+void phase_cache_store (phase_table_str_typ *tbl, char *key)
+{
+   phase_slot_str_typ *ps;
+   unsigned long long seq, claimed;
+   pid_t pid = getpid();
+
+   if (strlen(key) >= PHASE_KEY_SIZE || !map_phase_cache()) return;
+
+   ps = &phase_cache->slot[hash_string(key) % PHASE_CACHE_SLOTS];
+
+   /* claim the slot (still odd if taking over from a dead writer) */
+   seq = __atomic_load_n(&ps->seq, __ATOMIC_RELAXED);
+   if ((seq & 1) && (SEQ_WRITER(seq) == pid || kill(SEQ_WRITER(seq), 0) == 0 || errno != ESRCH)) {
+      return;
+   }
+   claimed = SEQ_MAKE(SEQ_COUNT(seq) + ((seq & 1) ? 2 : 1), pid);
+   if (!__atomic_compare_exchange_n(&ps->seq, &seq, claimed, FALSE,
+                                    __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) return;
+
+   /* keep the contents from being written before the slot is claimed */
+   __atomic_thread_fence(__ATOMIC_RELEASE);
+
+   memset(ps->key, 0, PHASE_KEY_SIZE);
+   strcpy(ps->key, key);
+   memcpy(&ps->tbl, tbl, sizeof(*tbl));
+
+   (void) __atomic_compare_exchange_n(&ps->seq, &claimed, SEQ_MAKE(SEQ_COUNT(claimed) + 1, 0),
+                                      FALSE, __ATOMIC_RELEASE, __ATOMIC_RELAXED);
+   return;
+}
+
+#else   /* caching is only supported under Unix */
+
+int cache_path (char *path GCC_UNUSED, char *options GCC_UNUSED)
+{
+   return FALSE;
+}
+
+int cache_fetch (char *path GCC_UNUSED, char *dest GCC_UNUSED)
+{
+   return FALSE;
+}
+
+int cache_begin (char *path GCC_UNUSED)
+{
+   return FALSE;
+}
+
+void cache_end (char *path GCC_UNUSED, int ok GCC_UNUSED)
+{
+   return;
+}
+
+int phase_cache_fetch (phase_table_str_typ *tbl GCC_UNUSED, char *key GCC_UNUSED)
+{
+   return FALSE;
+}
+
+void phase_cache_store (phase_table_str_typ *tbl GCC_UNUSED, char *key GCC_UNUSED)
+{
+   return;
+}
+
+#endif
@@ -0,0 +1,632 @@
+/* ---------------------------------------------------------------------------
+
+   lcalcheck.c
+
+   Notes:
+
+      This program checks that 'lcal' still generates the calendars it
+      should, and still as fast: it is built and run by "make check", and
+      is not installed.
+
+      The calendars are generated (with '-R') for a set of years chosen to
+      exercise the date calculations ('check_years[]': the first and last years
+      allowed, century years with and without leap days, and an ordinary
+      leap year) in each layout mode -- each combination of '-p'/'-l', '-S'
+      or '-O', '-W', and the default or a colored shading -- and compared
+      with the golden results (cf. "check.gold"):
+
+         - the PostScript code, less the moon phases and the lines naming
+           the program and its user, must be identical (it is compared as
+           a 64-bit FNV-1a digest);
+
+         - the moon phases must be within CHECK_TOL of the golden ones, or
+           within ENGINE_TOL for the phase engines other than the default
+           (which are checked as well, in portrait mode, their phases only
+           up to ENGINE_MAX_YR: further on, the Meeus engine's correction
+           for Delta T grows to days);
+
+         - the calendar for each of several time zones given at once
+           (GRID_ZONES, for which the phases are interpolated from a grid,
+           cf. '-z') must be exactly the same as for that zone alone, in
+           each of GRID_YEARS years (a rounding of the phase which the
+           interpolation gets wrong is rare, so it takes a good many);
+
+         - the years just outside the range allowed must be rejected.
+
+      With '-k DIR', each calendar is also written to DIR (less the lines
+      naming the program and its user), so that any difference can be
+      examined by comparing with the calendars kept from a good build.
+
+      Then the calendars for CHECK_JOB_YEARS years in each layout mode are
+      generated as a single job file (cf. '-J'), and the calendars per
+      second compared with the baseline recorded by '-b' on this machine,
+      if any (cf. "check.perf"): the check fails if they are more than
+      '-t' percent (CHECK_THRESHOLD by default) slower.
+
+      '-u' updates the golden results instead of checking them -- only
+      after making sure that the changes are right!
+
+      Usage: lcalcheck [-u] [-b] [-k DIR] [-t PERCENT] [-g GOLDFILE] [-p PERFFILE] [LCAL]
+
+      Unix only.
+
+*/
+
+/* ---------------------------------------------------------------------------
+
+   Header Files
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+/*
+ * Lcal-specific definitions:
+ */
+#include "lcaldefs.h"
+
+/* ---------------------------------------------------------------------------
+
+   Constant Declarations
+
+*/
+
+#define GOLD_FILE	"check.gold"	/* (defaults) */
+#define PERF_FILE	"check.perf"
+#define DEFAULT_LCAL	"./lcal"
+
+#define CHECK_TOL	0.0011	/* phase tolerance (3 decimals, rounded) */
+#define ENGINE_TOL	0.011	/* ... for the other phase engines */
+#define ENGINE_MAX_YR	2500	/* (... up to this year) */
+#define CHECK_THRESHOLD	20.0	/* slowdown allowed (percent) */
+
+#define CHECK_JOB_YEARS	10	/* calendars per mode for the timing */
+#define CHECK_JOB_RUNS	3	/* timings (the best is taken) */
+
+#define MAX_PHASES	(31 * 13)
+#define GOLD_LINSIZ	(MAX_PHASES * 8 + LINSIZ)
+#define MAX_REPORTS	10	/* mismatches reported in detail */
+
+#define COLOR_SHADING	"0:1:1/0:0:0.7/0/1:1:0"	/* (cf. lcal.man) */
+
+#define GRID_ZONES	"0,5.5,-3.25,America/New_York,Asia/Kathmandu"
+#define GRID_FIRST_YR	2020	/* years checked with GRID_ZONES */
+#define GRID_YEARS	20
+
+#define NUM_MODES	24
+
+/* ---------------------------------------------------------------------------
+
+   Type, Struct, & Enum Declarations
+
+*/
+
+/* a calendar as generated: the digest of its code, and its moon phases */
+typedef struct {
+   unsigned long long digest;
+   int nphases;
+   double phases[MAX_PHASES];
+} result_str_typ;
+
+/* the golden results for one year */
+typedef struct {
+   result_str_typ phases;   /* (only the phases) */
+   unsigned long long digest[NUM_MODES];
+} gold_year_str_typ;
+
+/* ---------------------------------------------------------------------------
+
+   Data Declarations (including externals)
+
+*/
+
+static int check_years[] = { MIN_YR, 1799, 1800, 1900, 2000, 2024, 2100, MAX_YR };
+
+#define NUM_YEARS	((int) (sizeof(check_years) / sizeof(check_years[0])))
+
+static char *other_engines[] = { "fast", "meeus" };
+
+#define NUM_ENGINES	((int) (sizeof(other_engines) / sizeof(other_engines[0])))
+
+/* the layout modes (filled in by init_modes()) */
+static char mode_names[NUM_MODES][12], mode_flags[NUM_MODES][STRSIZ];
+
+static gold_year_str_typ gold[NUM_YEARS];
+
+static char *lcal = DEFAULT_LCAL;
+static char *gold_file = GOLD_FILE;   /* -g */
+static char *perf_file = PERF_FILE;   /* -p */
+static char *keep_dir = NULL;   /* -k */
+static double threshold = CHECK_THRESHOLD;   /* -t */
+static int update = FALSE;   /* -u */
+static int set_baseline = FALSE;   /* -b */
+
+static int failures = 0;
+
+/* ---------------------------------------------------------------------------
+
+   init_modes
+
+   Notes:
+
+      This routine fills in the names and flags of every combination of the
+      layout flags.
+
+*/
+static void init_modes (void)
+{
+   static char *compress[3] = { "", "S", "O" };
+   int m, c, w, s, i = 0;
+
+   for (m = 0; m < 2; m++) {
+      for (c = 0; c < 3; c++) {
+         for (w = 0; w < 2; w++) {
+            for (s = 0; s < 2; s++, i++) {
+               sprintf(mode_names[i], "%c%s%s%s", m ? 'l' : 'p', compress[c], w ? "W" : "",
+                       s ? "+color" : "");
+               sprintf(mode_flags[i], "-%c%s%s%s%s%s", m ? F_LANDSCAPE : F_PORTRAIT, *compress[c] ? " -" : "",
+                       compress[c], w ? " -W" : "", s ? " -s " : "", s ? COLOR_SHADING : "");
+            }
+         }
+      }
+   }
+}
+
+/* ---------------------------------------------------------------------------
+
+   failed
+
+   Notes:
+
+      This routine reports a failed check (the first few in detail).
+
+*/
+static void failed (char *what, int year, char *fmt, ...)
+{
+   va_list ap;
+
+   if (failures++ < MAX_REPORTS) {
+      fprintf(stderr, "lcalcheck: FAILED %s %d: ", what, year);
+      va_start(ap, fmt);
+      vfprintf(stderr, fmt, ap);
+      va_end(ap);
+      fprintf(stderr, "\n");
+   }
+   else if (failures == MAX_REPORTS + 1) fprintf(stderr, "lcalcheck: (more failures...)\n");
+}
+
+/* ---------------------------------------------------------------------------
+
+   read_result
+
+   Notes:
+
+      This routine fills in '*pr' from the calendar read from 'fp' (also
+      written, normalized, to 'kfp' if not NULL).
+
+*/
+static void read_result (FILE *fp, result_str_typ *pr, FILE *kfp)
+{
+   char line[LINSIZ], *p, *q;
+   int in_phases = FALSE;
+   double x;
+
+   pr->digest = 14695981039346656037ULL;   /* (FNV-1a offset basis) */
+   pr->nphases = 0;
+
+   while (fgets(line, sizeof(line), fp) != NULL) {
+      /* leave out what depends on the program name and the user */
+      if (strncmp(line, "%%Creator:", 10) == 0 || strncmp(line, "%%For:", 6) == 0 ||
+          strncmp(line, "%%CreationDate:", 15) == 0) continue;
+      if (kfp) fputs(line, kfp);
+
+      /* the phases are compared by value */
+      if (in_phases) {
+         if (strncmp(line, "] def", 5) == 0) in_phases = FALSE;
+         else {
+            for (p = line; (x = strtod(p, &q)), q != p && pr->nphases < MAX_PHASES; p = q) {
+               pr->phases[pr->nphases++] = x;
+            }
+            continue;
+         }
+      }
+      else if (strncmp(line, "/moon_phases [", 14) == 0) in_phases = TRUE;
+
+      for (p = line; *p; p++) {
+         pr->digest = (pr->digest ^ (unsigned char) *p) * 1099511628211ULL;
+      }
+   }
+}
+
+/* ---------------------------------------------------------------------------
+
+   run_lcal
+
+   Notes:
+
+      This routine runs 'lcal -R' with the flags 'flags' for 'year', and
+      fills in '*pr' from its output (also written, normalized, to the file
+      'keep' if not NULL).  It returns lcal's exit status.
+
+*/
+static int run_lcal (char *flags, int year, result_str_typ *pr, char *keep)
+{
+   char cmd[2 * LINSIZ];
+   FILE *fp, *kfp = NULL;
+   int status;
+
+   sprintf(cmd, "%s -R %s %d 2>/dev/null", lcal, flags, year);
+   if ((fp = popen(cmd, "r")) == NULL) return -1;
+   if (keep && (kfp = fopen(keep, "w")) == NULL) {
+      fprintf(stderr, "lcalcheck: can't open file %s\n", keep);
+   }
+
+   read_result(fp, pr, kfp);
+
+   if (kfp) fclose(kfp);
+   status = pclose(fp);
+   return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+/* ---------------------------------------------------------------------------
+
+   compare_phases
+
+   Notes:
+
+      This routine checks the phases in '*pr' against those in '*pgold',
+      within 'tol' (allowing for the wrap from 0.999 to 0.000).
+
+*/
+static void compare_phases (char *what, int year, result_str_typ *pr, result_str_typ *pgold, double tol)
+{
+   double d, worst = 0.0;
+   int i, bad = -1;
+
+   if (pr->nphases != pgold->nphases) {
+      failed(what, year, "%d phases, expected %d", pr->nphases, pgold->nphases);
+      return;
+   }
+   for (i = 0; i < pr->nphases; i++) {
+      if ((pr->phases[i] < 0.0) != (pgold->phases[i] < 0.0)) d = 1.0;
+      else {
+         d = fabs(pr->phases[i] - pgold->phases[i]);
+         if (d > 0.5) d = 1.0 - d;
+      }
+      if (d > worst) {
+         worst = d;
+         bad = i;
+      }
+   }
+   if (worst > tol) {
+      failed(what, year, "phase %.3f, expected %.3f", pr->phases[bad], pgold->phases[bad]);
+   }
+}
+
+/* ---------------------------------------------------------------------------
+
+   read_gold, write_gold
+
+   Notes:
+
+      These routines read the golden results from 'gold_file', or write
+      them to it.  Each is a line of the form "phases <year> <phase>..." or
+      "doc <year> <mode> <digest>".  They return FALSE if they can't.
+
+*/
+static int read_gold (void)
+{
+   static char line[GOLD_LINSIZ];
+   char mode[STRSIZ], *p, *q;
+   unsigned long long digest;
+   FILE *fp;
+   int year, y, m;
+
+   if ((fp = fopen(gold_file, "r")) == NULL) return FALSE;
+   while (fgets(line, sizeof(line), fp) != NULL) {
+      if (sscanf(line, "phases %d", &year) == 1) {
+         for (y = 0; y < NUM_YEARS && check_years[y] != year; y++)
+            ;
+         if (y == NUM_YEARS) continue;
+         p = line + 6;
+         (void) strtol(p, &p, 10);
+         for (gold[y].phases.nphases = 0; gold[y].phases.nphases < MAX_PHASES; p = q) {
+            gold[y].phases.phases[gold[y].phases.nphases] = strtod(p, &q);
+            if (q == p) break;
+            gold[y].phases.nphases++;
+         }
+      }
+      else if (sscanf(line, "doc %d %31s %llx", &year, mode, &digest) == 3) {
+         for (y = 0; y < NUM_YEARS && check_years[y] != year; y++)
+            ;
+         for (m = 0; m < NUM_MODES && strcmp(mode, mode_names[m]) != 0; m++)
+            ;
+         if (y < NUM_YEARS && m < NUM_MODES) gold[y].digest[m] = digest;
+      }
+   }
+   fclose(fp);
+   return TRUE;
+}
+
+static int write_gold (void)
+{
+   FILE *fp;
+   int y, m, i;
+
+   if ((fp = fopen(gold_file, "w")) == NULL) return FALSE;
+   fprintf(fp, "# golden results for \"make check\" (cf. lcalcheck.c) - do not edit\n");
+   for (y = 0; y < NUM_YEARS; y++) {
+      fprintf(fp, "phases %d", check_years[y]);
+      for (i = 0; i < gold[y].phases.nphases; i++) fprintf(fp, " %.3f", gold[y].phases.phases[i]);
+      fprintf(fp, "\n");
+      for (m = 0; m < NUM_MODES; m++) {
+         fprintf(fp, "doc %d %s %016llx\n", check_years[y], mode_names[m], gold[y].digest[m]);
+      }
+   }
+   return fclose(fp) == 0;
+}
+
+/* ---------------------------------------------------------------------------
+
+   check_grid
+
+   Notes:
+
+      This routine generates the calendars for each of GRID_YEARS years in
+      all GRID_ZONES at once, and checks each against the calendar for its
+      zone alone.  It returns the number of calendars generated.
+
+*/
+static int check_grid (void)
+{
+   static result_str_typ r, alone;
+   char dir[LINSIZ], cmd[2 * LINSIZ], zones[STRSIZ], name[LINSIZ], flags[STRSIZ], *z;
+   FILE *fp;
+   int year, i, n = 0;
+
+   strcpy(dir, "/tmp/lcalcheckXXXXXX");
+   if (mkdtemp(dir) == NULL) {
+      fprintf(stderr, "lcalcheck: can't create directory %s\n", dir);
+      failures++;
+      return 0;
+   }
+
+   for (year = GRID_FIRST_YR; year < GRID_FIRST_YR + GRID_YEARS; year++) {
+      sprintf(cmd, "%s -R -%c %s -%c %s/%%z.ps %d 2>/dev/null", lcal, F_TIMEZONE, GRID_ZONES,
+              F_OUT_FILE, dir, year);
+      if (system(cmd) != 0) {
+         failed("-z " GRID_ZONES, year, "failed");
+         continue;
+      }
+
+      strcpy(zones, GRID_ZONES);
+      for (z = strtok(zones, ","); z; z = strtok(NULL, ","), n++) {
+         sprintf(flags, "-%c%s", F_TIMEZONE, z);
+         if (run_lcal(flags, year, &alone, NULL) != 0) {
+            failed(flags, year, "failed");
+            continue;
+         }
+
+         sprintf(name, "%s/%s.ps", dir, z);
+         for (i = strlen(dir) + 1; name[i]; i++) {
+            if (name[i] == END_PATH) name[i] = '_';   /* (as lcal does) */
+         }
+         if ((fp = fopen(name, "r")) == NULL) {
+            failed(flags, year, "no calendar from -z " GRID_ZONES);
+            continue;
+         }
+         read_result(fp, &r, NULL);
+         fclose(fp);
+         unlink(name);
+
+         if (r.digest != alone.digest || r.nphases != alone.nphases ||
+             memcmp(r.phases, alone.phases, r.nphases * sizeof(double)) != 0) {
+            failed(flags, year, "calendar differs with -z " GRID_ZONES);
+         }
+      }
+   }
+
+   rmdir(dir);
+   return n;
+}
+
+/* ---------------------------------------------------------------------------
+
+   check_output
+
+   Notes:
+
+      This routine generates the calendars for each year and mode, and
+      checks them against the golden results (or records them as such).
+      It returns the number of calendars generated.
+
+*/
+static int check_output (void)
+{
+   static result_str_typ r;
+   char flags[STRSIZ], keep[LINSIZ];
+   int y, m, e, status, n = 0;
+
+   for (y = 0; y < NUM_YEARS; y++) {
+      for (m = 0; m < NUM_MODES; m++, n++) {
+         sprintf(keep, "%s/%s_%d.ps", keep_dir ? keep_dir : ".", mode_names[m], check_years[y]);
+         if ((status = run_lcal(mode_flags[m], check_years[y], &r, keep_dir ? keep : NULL)) != 0) {
+            failed(mode_flags[m], check_years[y], "exit status %d", status);
+            continue;
+         }
+         if (update) {
+            gold[y].digest[m] = r.digest;
+            if (m == 0) gold[y].phases = r;
+            continue;
+         }
+         if (r.digest != gold[y].digest[m]) {
+            failed(mode_flags[m], check_years[y], "PostScript code differs");
+         }
+         compare_phases(mode_flags[m], check_years[y], &r, &gold[y].phases, CHECK_TOL);
+      }
+
+      /* the other engines give the same calendar, with slightly different
+         phases */
+      for (e = 0; e < NUM_ENGINES && !update; e++, n++) {
+         sprintf(flags, "-%c -%c %s", F_PORTRAIT, F_ENGINE, other_engines[e]);
+         if ((status = run_lcal(flags, check_years[y], &r, NULL)) != 0) {
+            failed(flags, check_years[y], "exit status %d", status);
+            continue;
+         }
+         if (r.digest != gold[y].digest[0]) {
+            failed(flags, check_years[y], "PostScript code differs");
+         }
+         if (check_years[y] <= ENGINE_MAX_YR) {
+            compare_phases(flags, check_years[y], &r, &gold[y].phases, ENGINE_TOL);
+         }
+      }
+   }
+
+   if (!update) n += check_grid();
+
+   /* the years just outside the range must be rejected */
+   if (run_lcal("", MIN_YR - 1, &r, NULL) == 0) failed("year", MIN_YR - 1, "accepted");
+   if (run_lcal("", MAX_YR + 1, &r, NULL) == 0) failed("year", MAX_YR + 1, "accepted");
+
+   return n;
+}
+
+/* ---------------------------------------------------------------------------
+
+   check_speed
+
+   Notes:
+
+      This routine times the generation of CHECK_JOB_YEARS calendars in each
+      layout mode, as a single job file run by a single worker, and checks
+      the calendars per second against the baseline (or records them as
+      such).
+
+*/
+static void check_speed (void)
+{
+   char job_name[LINSIZ], cmd[2 * LINSIZ];
+   struct timespec t0, t1;
+   double secs, rate, best = 0.0, baseline;
+   FILE *fp;
+   int m, y, i, fd;
+
+   strcpy(job_name, "/tmp/lcalcheckXXXXXX");
+   if ((fd = mkstemp(job_name)) < 0 || (fp = fdopen(fd, "w")) == NULL) {
+      fprintf(stderr, "lcalcheck: can't create job file\n");
+      failures++;
+      return;
+   }
+   for (m = 0; m < NUM_MODES; m++) {
+      for (y = 0; y < CHECK_JOB_YEARS; y++) {
+         fprintf(fp, "-R %s -o /dev/null %d\n", mode_flags[m], 2020 + y);
+      }
+   }
+   fclose(fp);
+
+   sprintf(cmd, "%s -%c 1 -%c %s >/dev/null", lcal, F_WORKERS, F_JOBS, job_name);
+   for (i = 0; i < CHECK_JOB_RUNS; i++) {
+      clock_gettime(CLOCK_MONOTONIC, &t0);
+      if (system(cmd) != 0) {
+         fprintf(stderr, "lcalcheck: FAILED job file %s\n", job_name);
+         failures++;
+         unlink(job_name);
+         return;
+      }
+      clock_gettime(CLOCK_MONOTONIC, &t1);
+      secs = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1E9;
+      if ((rate = NUM_MODES * CHECK_JOB_YEARS / secs) > best) best = rate;
+   }
+   unlink(job_name);
+
+   printf("lcalcheck: %.0f calendars/sec", best);
+
+   if (set_baseline) {
+      if ((fp = fopen(perf_file, "w")) == NULL || fprintf(fp, "calendars_per_sec %.1f\n", best) < 0 ||
+          fclose(fp) != 0) {
+         fprintf(stderr, "\nlcalcheck: can't write file %s\n", perf_file);
+         failures++;
+         return;
+      }
+      printf(" (recorded as the baseline in %s)\n", perf_file);
+      return;
+   }
+   if ((fp = fopen(perf_file, "r")) == NULL || fscanf(fp, "calendars_per_sec %lf", &baseline) != 1 ||
+       baseline <= 0.0) {
+      printf(" (no baseline in %s - record one with -b)\n", perf_file);
+      if (fp) fclose(fp);
+      return;
+   }
+   fclose(fp);
+
+   printf(" (baseline %.0f, %+.1f%%)\n", baseline, 100.0 * (best - baseline) / baseline);
+   if (best < baseline * (1.0 - threshold / 100.0)) {
+      fprintf(stderr, "lcalcheck: FAILED speed: more than %.0f%% slower than the baseline\n", threshold);
+      failures++;
+   }
+}
+
+/* ---------------------------------------------------------------------------
+
+   main
+
+*/
+int main (int argc, char **argv)
+{
+   int i, n;
+
+   for (i = 1; i < argc && argv[i][0] == '-'; i++) {
+      if (strcmp(argv[i], "-u") == 0) update = TRUE;
+      else if (strcmp(argv[i], "-b") == 0) set_baseline = TRUE;
+      else if (strcmp(argv[i], "-k") == 0 && i + 1 < argc) keep_dir = argv[++i];
+      else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc && (threshold = atof(argv[++i])) > 0.0)
+         ;
+      else if (strcmp(argv[i], "-g") == 0 && i + 1 < argc) gold_file = argv[++i];
+      else if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) perf_file = argv[++i];
+      else {
+         fprintf(stderr, "usage: lcalcheck [-u] [-b] [-k DIR] [-t PERCENT] [-g GOLDFILE] [-p PERFFILE] [LCAL]\n");
+         exit(EXIT_FAILURE);
+      }
+   }
+   if (i < argc) lcal = argv[i];
+
+   /* make sure nothing but the flags given here affects the calendars */
+   unsetenv(LCAL_OPTS);
+   unsetenv(SOURCE_DATE_ENV);
+   unsetenv(LCAL_CACHE_ENV);
+   unsetenv(LCAL_PHASE_CACHE_ENV);
+   unsetenv(LCAL_STATS_ENV);
+
+   init_modes();
+   if (!update && !read_gold()) {
+      fprintf(stderr, "lcalcheck: can't open file %s\n", gold_file);
+      exit(EXIT_FAILURE);
+   }
+
+   n = check_output();
+   if (update) {
+      if (failures || !write_gold()) {
+         fprintf(stderr, "lcalcheck: can't update %s\n", gold_file);
+         exit(EXIT_FAILURE);
+      }
+      printf("lcalcheck: %d calendars recorded in %s\n", n, gold_file);
+   }
+   else printf("lcalcheck: %d calendars checked against %s\n", n, gold_file);
+
+   if (failures == 0) check_speed();
+
+   if (failures) {
+      fprintf(stderr, "lcalcheck: %d check(s) failed\n", failures);
+      exit(EXIT_FAILURE);
+   }
+   printf("lcalcheck: all checks passed\n");
+   exit(EXIT_SUCCESS);
+}
@@ -0,0 +1,84 @@
+/* ---------------------------------------------------------------------------
+
+   lcaldate.c
+
+   Notes:
+
+      This file contains the calendar arithmetic routines: the Julian day
+      number of a date, and the weekday on which a month starts.
+
+      For the years MIN_YR .. MAX_YR, these are simple lookups in a table of
+      year descriptors generated at build time (cf. mkyeartbl.c, which also
+      checks the table exhaustively against the calculations it replaced).
+      Other years, which are only needed at the edges of a calendar (e.g.
+      for a time zone margin), fall back to integer arithmetic.
+
+*/
+
+/* ---------------------------------------------------------------------------
+
+   Header Files
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+/*
+ * Lcal-specific definitions:
+ */
+#include "lcaldefs.h"
+
+/*
+ * Table of year descriptors (generated by mkyeartbl.c):
+ */
+#include "yeartbl.h"
+
+/* ---------------------------------------------------------------------------
+
+   jdn
+
+   Notes:
+
+      This routine returns the Julian day number (i.e. the Julian date at
+      noon UT) of the date 'month'/'day'/'year', for the Gregorian calendar
+      from 15 October 1582 and the Julian calendar before then.
+
+*/
+long jdn (int month, int day, int year)
+{
+   long a, y, m;
+
+   if (year >= MIN_YR && year <= MAX_YR) {
+      return year_tbl[year - MIN_YR].jdn + DAY_OF_YEAR(month, day, year) - 1;
+   }
+
+   /* integer formula of Fliegel & Van Flandern, counting years from 4801 BC
+      and starting each year in March (cf. mkyeartbl.c) */
+   a = (14 - month) / 12;
+   y = year + 4800L - a;
+   m = month + 12 * a - 3;
+
+   if (year < 1582 || (year == 1582 && (month < 10 || (month == 10 && day < 15)))) {
+      return day + (153 * m + 2) / 5 + 365 * y + y / 4 - 32083;
+   }
+   return day + (153 * m + 2) / 5 + 365 * y + y / 4 - y / 100 + y / 400 - 32045;
+}
+
+/* ---------------------------------------------------------------------------
+
+   first_of
+
+   Notes:
+
+      This routine returns the weekday (SUN .. SAT) of the 1st of 'month'
+      (JAN .. DEC) in 'year'.
+
+*/
+int first_of (int month, int year)
+{
+   if (year >= MIN_YR && year <= MAX_YR) {
+      return year_tbl[year - MIN_YR].startday[month - JAN];
+   }
+   return (int) ((jdn(month, 1, year) + 1) % 7);
+}
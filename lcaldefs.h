@@ -80,6 +80,129 @@ typedef struct {
    char *text;   /* associated text */
 } param_msg_str_typ;
 
+/*
+ * Global typedef declarations for the table of moon phases (cf. lcal.c,
+ * calc_phase_table()).  Each month shown on the calendar occupies one
+ * 'column' of the table, in the order in which they are printed.
+ */
+#define NUM_MONTHS	12	/* months shown by default */
+#define MAX_MONTHS	13	/* most months that fit across the page */
+
+typedef struct {
+   int month;   /* month (JAN .. DEC) */
+   int year;   /* year */
+   int startday;   /* weekday (SUN .. SAT) of the 1st */
+   int length;   /* number of days in month */
+} cal_month_str_typ;
+
+typedef struct {
+   int nmonths;   /* number of months shown */
+   cal_month_str_typ month[MAX_MONTHS];
+   double phase[31][MAX_MONTHS];   /* phase by day, month (-1 if no such day) */
+   double dist[31][MAX_MONTHS];   /* moon's distance (km), if calculated, or -1 */
+} phase_table_str_typ;
+
+/*
+ * Global typedef declaration for the table of year descriptors (cf.
+ * lcaldate.c, mkyeartbl.c)
+ */
+typedef struct {
+   long jdn;   /* Julian day number of January 1 */
+   char startday[12];   /* weekday (SUN .. SAT) of the 1st of each month */
+} year_desc_str_typ;
+
+/*
+ * Global typedef declaration for a grid of moon ages sampled at regular
+ * intervals (cf. moonphas.c, calc_phase_grid())
+ */
+typedef struct {
+   double jd0;   /* Julian date of first sample */
+   int npoints;   /* number of samples */
+   double *age;   /* moon's age (degrees, continuous) at each sample */
+} phase_grid_str_typ;
+
+/*
+ * Global typedef declaration for a phase engine, i.e. a method of
+ * calculating the moon's age (cf. moonphas.c, set_phase_engine())
+ */
+typedef struct {
+   char *name;   /* name (cf. '-P') */
+   double (*age)(double jd);   /* moon's age (degrees) at Julian date 'jd' */
+} phase_engine_str_typ;
+
+/*
+ * Global typedef declaration for a Chebyshev ephemeris of the moon's age
+ * (cf. lcaleph.c)
+ */
+typedef struct {
+   double jd0;   /* Julian date at start of first interval */
+   double span;   /* days per interval */
+   int nintervals;
+   double max_err;   /* maximum error (degrees) */
+   float *coef;   /* EPH_NCOEF coefficients per interval */
+   long long file_size, file_mtime;   /* (identify the file, cf. lcal.c) */
+} ephemeris_str_typ;
+
+/*
+ * Global typedef declaration for a sink for the PostScript output, which
+ * returns nonzero on failure (cf. lcalfmt.c, set_ps_sink())
+ */
+typedef int (*ps_sink_typ)(void *ctx, const char *data, size_t len);
+
+/*
+ * Global typedef declaration for the state of the moon at a given instant
+ * (cf. moonphas.c, calc_moon_info())
+ */
+typedef struct {
+   double phase;   /* phase (0.0 = new, 0.5 = full) */
+   double illum;   /* illuminated fraction of disc */
+   double age;   /* days since new moon */
+   double dist;   /* distance from the centre of the Earth (km) */
+   double diam;   /* apparent diameter (degrees) */
+} moon_info_str_typ;
+
+/*
+ * Global typedef declaration for an eclipse of the sun or moon (cf.
+ * lcalecl.c, find_eclipses())
+ */
+#define ECL_NONE	0	/* types of eclipse (cf. ECLIPSE_NAMES) */
+#define ECL_PENUMBRAL	1	/* (lunar) */
+#define ECL_PARTIAL_LUNAR	2
+#define ECL_TOTAL_LUNAR	3
+#define ECL_PARTIAL_SOLAR	4
+#define ECL_ANNULAR	5	/* (solar) */
+#define ECL_HYBRID	6	/* (solar: annular-total) */
+#define ECL_TOTAL_SOLAR	7
+#define ECLIPSE_NAMES	"none", "penumbral lunar", "partial lunar", "total lunar", \
+			"partial solar", "annular solar", "hybrid solar", "total solar"
+
+typedef struct {
+   double jd;   /* Julian date of greatest eclipse (UT) */
+   int type;   /* ECL_PENUMBRAL .. ECL_TOTAL_SOLAR */
+   double gamma;   /* least distance of the shadow's axis (Earth radii) */
+   double mag;   /* magnitude (umbral, or penumbral; -1 if solar and not partial) */
+} eclipse_str_typ;
+
+/*
+ * Global typedef declaration for the statistics of a run (cf. lcalstat.c,
+ * '-T'): the time spent in each stage, and the counters
+ */
+#define STAGE_ARGS	0	/* parsing the arguments */
+#define STAGE_GETPWUID	1	/* looking up the user name */
+#define STAGE_PHASES	2	/* calculating the moon phases */
+#define STAGE_PROLOG	3	/* writing the PostScript prolog */
+#define STAGE_TABLE	4	/* writing the table of phases */
+#define STAGE_FLUSH	5	/* flushing the output (or caching it) */
+#define NUM_STAGES	6
+#define STAGE_NAMES	"args", "getpwuid", "phases", "prolog", "table", "flush"
+
+typedef struct {   /* (all counters, cf. stats_merge()) */
+   unsigned long long ns[NUM_STAGES];   /* nanoseconds per stage */
+   unsigned long long bytes;   /* PostScript written */
+   unsigned long long calc_phase_calls;
+   unsigned long long kepler_calls;   /* (one iteration each) */
+} stats_str_typ;
+
 /* ---------------------------------------------------------------------------
 
    Constant Declarations
@@ -115,11 +238,56 @@ typedef struct {
  * Environment variables:
  */
 #define LCAL_OPTS   "LCAL_OPTS"   /* command-line flags */
+#define SOURCE_DATE_ENV   "SOURCE_DATE_EPOCH"   /* timestamp for '-R' */
+#define LCAL_CACHE_ENV   "LCAL_CACHE_DIR"   /* calendar cache (cf. '-R') */
+#define LCAL_CACHE_SIZE_ENV   "LCAL_CACHE_SIZE"   /* its size limit (MB) */
+#define LCAL_PHASE_CACHE_ENV   "LCAL_PHASE_CACHE"   /* phase table cache file */
+#define LCAL_STATS_ENV   "LCAL_STATS"   /* statistics (cf. '-T') */
+#define LCAL_TRACE_ENV   "LCAL_TRACE"   /* trace file (cf. lcaltrace.c) */
 
 /*
  * Miscellaneous other constants:
  */
 
+#define MAX_ZONES	MAXWORD	/* time zones in one run (cf. '-z') */
+#define ZONE_SEP	','	/* time zone list separator */
+
+#define MAX_VARIANTS	16	/* layout variants in one run (cf. '-V') */
+
+#define MAX_WORKERS	256	/* parallel job workers (cf. '-j') */
+#define JOB_COMMENT	'#'	/* comment character in job files */
+#define AIO_SLOTS	16	/* files being written at once (cf. '-A') */
+#define TRACE_EVENTS	1024	/* trace events buffered per process */
+#define TRACE_ARG_SIZE	96	/* longest argument of a trace event (+1) */
+#define VARIANT_FLAGS	"lpSOW"	/* flags allowed in a layout variant */
+
+#define CACHE_SIZE_DEFAULT	(64LL * 1024 * 1024)	/* calendar cache limit */
+#define PHASE_CACHE_SLOTS	256	/* phase tables in cache file */
+#define PHASE_KEY_SIZE	256	/* max. length of their keys (+1) */
+#define ZONE_OFFSETS_SIZE	(31 * MAX_MONTHS * 24)	/* a zone's offsets, for keys */
+
+/* version of the phase calculations - change whenever they would give
+   different results, to invalidate cached phase tables */
+#define PHASE_ALGO_VERSION	1
+
+#define PHASE_ENGINES	"moontool, fast, meeus"	/* cf. '-P' */
+#define DEFAULT_ENGINE	"moontool"
+
+#define EPH_SPAN	8.0	/* days per Chebyshev ephemeris interval */
+#define EPH_NCOEF	8	/* coefficients per interval */
+
+#define PHASE_GRID_STEP	0.5	/* days between phase grid samples */
+#define PHASE_GRID_MIN	2	/* use grid if more time zones than this */
+#define PHASE_GRID_GUARD	1E-5	/* > max. error of interpolated phase */
+#define PHASE_GRID_QUANTUM	0.0005	/* printed phases round at its multiples */
+
+#define MAX_ECLIPSES	32	/* most eclipses in one calendar (cf. lcalecl.c) */
+
+#define NO_RISE_SET	(-1)	/* no moonrise/moonset that day (cf. lcalrise.c) */
+
+#define MOON_MEAN_DIST	384401.0	/* semi-major axis of moon's orbit (km) */
+#define SUPERMOON_DIST	360000.0	/* full moon nearer than this is ringed (-m) */
+
 #define P_ENV		1	/* environment variable / command line pass */
 #define P_CMD1		2
 
@@ -133,6 +301,12 @@ typedef struct {
 
 #define CENTURY		1900	/* base year for struct tm year field */
 
+#define SECS_PER_DAY	86400L
+#define JD_UNIX_EPOCH	2440587.5	/* Julian date of 1970-01-01 00:00 UT */
+#define JD_MIN_YR	2361330.5	/* Julian date of start of MIN_YR */
+#define JD_MAX_YR	5373484.5	/* Julian date of end of MAX_YR */
+#define JD_J2000	2451545.0	/* Julian date of epoch J2000.0 */
+
 #define JAN		 1	/* significant months */
 #define FEB		 2
 #define DEC		12
@@ -146,6 +320,8 @@ typedef struct {
 #define MAXWORD		100
 #define LINSIZ		512	/* size of source line buffer */
 
+#define FMT_MAX_PREC	4	/* most decimals for fmt_fixed() */
+
 #define MAXARGS		1	/* numeric command-line args */
 
 #define DIGITS		"0123456789"
@@ -184,6 +360,8 @@ typedef struct {
 #define	MONTHFONTSIZE_S	18		/* for legibility when output	*/
 #define SMWKDFONTSIZE_S	 9		/* is compressed (-S)		*/
 
+#define	TIMEFONTSIZE	 5		/* moonrise/moonset times (-g)	*/
+
 /*
  * Very few PostScript printers will actually print to the edges of each page.
  * These site-specific magic numbers (also definable in the Makefile)
@@ -265,6 +443,33 @@ typedef struct {
 
 #define F_TIMEZONE	'z'		/* specify alternate time zone */
 
+#define F_DATE_RANGE	'r'		/* specify range of months */
+
+#define F_QUERY		'q'		/* print phase at given instant */
+
+#define F_VARIANTS	'V'		/* generate several layout variants */
+
+#define F_ENGINE	'P'		/* select phase engine */
+
+#define F_EPHEMERIS	'E'		/* use Chebyshev ephemeris file */
+#define F_GEN_EPHEMERIS	'G'		/* generate Chebyshev ephemeris file */
+
+#define F_REPRODUCIBLE	'R'		/* reproducible output (and caching) */
+
+#define F_JOBS		'J'		/* run the jobs listed in a file */
+#define F_WORKERS	'j'		/* number of parallel job workers */
+
+#define F_ASYNC		'A'		/* write output files asynchronously */
+
+#define F_STATS		'T'		/* report statistics of the run */
+
+#define F_ECLIPSES	'e'		/* mark eclipses on the calendar */
+#define F_LIST_ECLIPSES	'L'		/* list the eclipses of given years */
+
+#define F_LOCATION	'g'		/* moonrise/moonset at given place */
+
+#define F_MOON_SIZES	'm'		/* draw moons to scale of apparent size */
+
 #define F_COMPR_1PAGE	'S'		/* print compressed, single-page calendar */
 #define F_ODD_DAYS_1PAGE	'O'	/* print odd-days-only, single-page calendar */
 
@@ -272,6 +477,13 @@ typedef struct {
 #define W_FILE		"<FILE>"
 #define W_VALUE		"<VALUE>"
 #define W_VAL2		"<n>{/<n>}"
+#define W_RANGE		"<mm/yy>{-<mm/yy>}"
+#define W_TIME		"<TIME>"
+#define W_ENGINE	"<ENGINE>"
+#define W_VARIANTS	"<v>{,<v>...}"
+#define W_NUMBER	"<n>"
+#define W_YEARS		"<yyyy>{-<yyyy>}"
+#define W_LOCATION	"<lat>/<lon>"
 
 /* Oct 2007: Unfortunately, with the way that 'lcal' was designed to display
    the options (via 'lcal -h') in neatly aligned columns, there is not nearly
@@ -295,10 +507,27 @@ typedef struct {
 
 /* program error messages */
 #define	E_FOPEN_ERR	"%s: can't open file %s\n"
+#define	E_ALLOC_ERR	"%s: out of memory\n"
+#define	E_WRITE_ERR	"%s: can't write file %s\n"
 #define	E_ILL_OPT	"%s: unrecognized flag %s"
 #define E_ILL_OPT2	" (%s\"%s\")"
 #define	E_ILL_YEAR	"%s: year %d not in range %d .. %d\n"
+#define E_ILL_RANGE	"%s: invalid range \"%s\" (1 .. %d months)\n"
+#define E_ILL_ZONE	"%s: unknown time zone \"%s\"\n"
+#define E_ILL_VARIANT	"%s: invalid layout variant \"%s\" (flags %s)\n"
+#define E_NEED_PATTERN	"%s: -%c <FILE> must contain \"%%%c\" for more than one %s\n"
+#define E_FNAME_TOO_LONG	"%s: output file name too long (\"%s\", max %d characters)\n"
+#define E_ILL_ENGINE	"%s: unknown phase engine \"%s\" (%s)\n"
+#define E_ILL_EPHEM	"%s: can't load ephemeris file %s\n"
+#define E_ILL_TIME	"%s: invalid time \"%s\" (Unix time or JD<julian date>, years %d .. %d)\n"
 #define E_FLAG_IGNORED	"%s: -%c flag ignored (%s\"%s\")\n"
+#define E_JOB_NO_FILE	"%s: job must specify -%c <FILE> (\"%s\")\n"
+#define E_JOB_FLAG	"%s: -%c flag not allowed in a job (\"%s\")\n"
+#define E_JOB_TOO_LONG	"%s: %s:%d: job longer than %d characters\n"
+#define E_JOBS_FAILED	"%s: %d of %d jobs failed\n"
+#define E_ILL_YEARS	"%s: invalid years \"%s\" (%d .. %d)\n"
+#define E_ILL_LOCATION	"%s: invalid location \"%s\" (<lat>/<lon>, degrees north/east)\n"
+#define E_ILL_WORKERS	"%s: invalid number of workers \"%s\"\n"
 #define ENV_VAR		"environment variable "
 
 /* ---------------------------------------------------------------------------
@@ -332,21 +561,142 @@ typedef struct {
 #define YEAR_LEN(y)   (IS_LEAP(y) ? 366 : 365)
 #define DAY_OF_YEAR(m, d, y) ((month_off[(m)-1] + ((m) > FEB && IS_LEAP(y))) + d)
 #define OFFSET_OF(m, y) ((month_off[(m)-1] + ((m) > FEB && IS_LEAP(y))) % 7)
-#define FIRST_OF(m, y)   calc_weekday(m, 1, y)
+#define FIRST_OF(m, y)   first_of(m, y)
+
+#define UNIX_TO_JD(t)   (JD_UNIX_EPOCH + (t) / (double) SECS_PER_DAY)
+#define JD_TO_UNIX(jd)   (((jd) - JD_UNIX_EPOCH) * SECS_PER_DAY)
 
 #define P_LASTCHAR(p)   ((p) && *(p) ? (p) + strlen(p) - 1 : NULL)
 #define LASTCHAR(p)   (p)[strlen(p) - 1]
 
 #define IS_NUMERIC(p)   ((p)[strspn((p), DIGITS)] == '\0')
 
+/* timing of the stages of a run, and counting of calls, which cost nothing
+   unless '-T' is given or the run is traced:
+   't0 = STATS_CLOCK(); ...; STATS_ADD(STAGE_..., t0);', 'STATS_COUNT(n);' */
+#define STATS_CLOCK()   (stats_on || trace_on ? stats_clock() : 0.0)
+#define STATS_ADD(stage, t0)   do { if (stats_on || trace_on) stats_add(stage, t0); } while (0)
+#define STATS_COUNT(count)   do { if (stats_on || trace_on) (count)++; } while (0)
+
 /* ---------------------------------------------------------------------------
 
    Data Declarations (including externals)
 
 */
 
+extern char progname[];   /* (for error messages) */
+extern char time_zone[];   /* -z */
+
+/* other options, as set by the library (cf. liblcal.c) */
+extern int init_year, init_month, num_months;
+extern int rotate, draw_day_of_week_inside_moon;
+extern int compressed_singlepage, odd_days_singlepage, reproducible;
+extern int mark_eclipses, rise_set, moon_sizes;
+extern double latitude, longitude;
+extern char dayfont[], titlefont[], shading[], x_offset[], y_offset[];
+extern char phase_engine[];
+extern char *source_date;
+
+extern int stats_on;   /* -T (cf. STATS_CLOCK()) */
+extern int trace_on;   /* $LCAL_TRACE */
+extern unsigned long long ps_byte_count;   /* (counters for lcalstat.c) */
+extern unsigned long long calc_phase_count, kepler_count;
+
+extern char month_len[12];   /* cf. LENGTH_OF() etc. */
+extern short month_off[12];
+
 /* ---------------------------------------------------------------------------
 
    External Routine References & Function Prototypes
 
 */
+
+/* lcal.c */
+void init_names (char *argv0);
+int get_args (char **argv, int curr_pass, char *where);
+int calc_weekday (int mm, int dd, int yy);
+int loadwords (char **words, char *buf);
+void define_shading (char *orig_shading, char *new_shading, char *dflt_shading);
+void calc_phase_table (phase_table_str_typ *tbl, int month, int year, int nmonths);
+void write_psfile (phase_table_str_typ *tbl);
+
+/* moonphas.c */
+double kepler (double m, double ecc);
+double moon_age (double pdate);
+double moon_diameter (double dist);
+double calc_phase_dist (int month, int inday, int year, double *pdist);
+double calc_phase (int month, int inday, int year);
+void calc_moon_info (double jd, moon_info_str_typ *pinfo);
+int calc_phase_grid (phase_grid_str_typ *pgrid, int month, int year, int nmonths);
+void use_phase_grid (phase_grid_str_typ *pgrid);
+double grid_phase (phase_grid_str_typ *pgrid, double jd);
+void use_ephemeris (ephemeris_str_typ *peph);
+double engine_age (double jd);
+int set_phase_engine (char *name);
+char * phase_engine_name (void);
+
+/* lcalmeeus.c */
+double delta_t (double y);
+double meeus_age (double jd);
+
+/* lcalecl.c */
+int find_eclipses (double jd0, double jd1, eclipse_str_typ *ecl, int max);
+void calc_eclipse_table (phase_table_str_typ *tbl, char ecl[31][MAX_MONTHS]);
+char * eclipse_name (int type);
+
+/* lcalrise.c */
+void calc_rise_set_table (phase_table_str_typ *tbl, double lat, double lon,
+                          short rise[31][MAX_MONTHS], short set[31][MAX_MONTHS]);
+
+/* lcaldate.c */
+long jdn (int month, int day, int year);
+int first_of (int month, int year);
+
+/* lcalfmt.c */
+char * fmt_int (char *p, long n);
+char * fmt_int_w (char *p, long n, int width);
+char * fmt_fixed (char *p, double x, int prec);
+char * fmt_phase (char *p, double phase);
+char * fmt_hhmm (char *p, int minutes);
+void set_ps_sink (ps_sink_typ sink, void *ctx);
+int ps_sink_error (void);
+void ps_write (char *buf, size_t len);
+void ps_printf (char *fmt, ...);
+
+/* lcalaio.c */
+int async_write_file (char *name, char *data, size_t len, char *pfailed);
+int async_flush (void);
+char * async_backend (void);
+
+/* lcalstat.c */
+double stats_clock (void);
+void stats_add (int stage, double t0);
+void stats_begin (double t_start);
+void stats_merge (void);
+int stats_report (char *json_name);
+
+/* lcaltrace.c */
+int trace_begin (char *name);
+void trace_thread (char *name);
+void trace_span (char *name, double t0, double t1, char *arg);
+void trace_flush (void);
+int trace_end (void);
+
+/* lcaleph.c */
+double eph_age (ephemeris_str_typ *peph, double jd);
+int load_ephemeris (ephemeris_str_typ *peph, char *name);
+void unload_ephemeris (ephemeris_str_typ *peph);
+int write_ephemeris (char *name);
+
+/* lcalcache.c */
+int cache_path (char *path, char *options);
+int cache_fetch (char *path, char *dest);
+int cache_begin (char *path);
+void cache_end (char *path, int ok);
+int phase_cache_fetch (phase_table_str_typ *tbl, char *key);
+void phase_cache_store (phase_table_str_typ *tbl, char *key);
+
+/* lcaltz.c */
+int is_zone_name (char *zone);
+int valid_zone (char *zone);
+double utc_offset_days (char *zone, int month, int day, int year);
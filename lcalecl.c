@@ -0,0 +1,233 @@
+/* ---------------------------------------------------------------------------
+
+   lcalecl.c
+
+   Notes:
+
+      This file contains routines to find the eclipses of the sun and moon
+      (cf. '-e', '-L'), by the method of Jean Meeus, "Astronomical
+      Algorithms" (2nd ed., chapter 54).
+
+      An eclipse can only occur at a new moon (solar) or a full moon
+      (lunar), and only if the moon is then near a node of its orbit, so
+      rather than following the moon from day to day, the search visits
+      just the mean syzygies -- about 25 a year -- and rejects at once
+      those at which the moon's argument of latitude is too far from a
+      node; only the few remaining are examined in full, giving the time of
+      greatest eclipse (to a few minutes), the least distance 'gamma' of the
+      axis of the shadow from the centre of the Earth (solar) or moon
+      (lunar), and the magnitude.  Listing every eclipse from MIN_YR to
+      MAX_YR thus takes a few milliseconds.
+
+      The times are converted from Dynamical Time to Universal Time with the
+      Delta-T of the Meeus phase engine (cf. lcalmeeus.c), whichever engine
+      is active.
+
+*/
+
+/* ---------------------------------------------------------------------------
+
+   Header Files
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+/*
+ * Lcal-specific definitions:
+ */
+#include "lcaldefs.h"
+
+/* ---------------------------------------------------------------------------
+
+   Constant Declarations
+
+*/
+
+#define JDE_K0		2451550.09766	/* mean new moon of k = 0 (2000 Jan 6) */
+#define SYN_MONTH	29.530588861	/* mean synodic month (days) */
+#define K_PER_CENTURY	1236.85		/* lunations per Julian century */
+
+#define NODE_LIMIT	0.36	/* no eclipse if |sin F| exceeds this */
+
+#define fixangle(a) ((a) - 360.0 * (floor((a) / 360.0)))  /* fix angle */
+#define torad(d) ((d) * (M_PI / 180.0))   /* deg->rad */
+
+/* ---------------------------------------------------------------------------
+
+   Data Declarations (including externals)
+
+*/
+
+static char *eclipse_names[] = { ECLIPSE_NAMES };
+
+/* ---------------------------------------------------------------------------
+
+   eclipse_at
+
+   Notes:
+
+      This routine examines the syzygy of lunation 'k' (an integer for a new
+      moon, or an integer plus 0.5 for a full moon; cf. Meeus 49.2), and
+      fills in '*pe' and returns TRUE if there is an eclipse then.
+
+*/
+static int eclipse_at (double k, eclipse_str_typ *pe)
+{
+   double T, jde, M, Mp, F, F1, Om, E, A1, P, Q, W, g, u, ag, w;
+   int full = k != floor(k);
+
+   T = k / K_PER_CENTURY;
+
+   /* the moon's argument of latitude, and the quick rejection */
+   F = torad(fixangle(160.7108 + 390.67050284 * k - 0.0016118 * T * T - 0.00000227 * T * T * T +
+                      0.000000011 * T * T * T * T));
+   if (fabs(sin(F)) > NODE_LIMIT) return FALSE;
+
+   jde = JDE_K0 + SYN_MONTH * k + 0.00015437 * T * T - 0.000000150 * T * T * T +
+      0.00000000073 * T * T * T * T;
+   M = torad(fixangle(2.5534 + 29.10535670 * k - 0.0000014 * T * T - 0.00000011 * T * T * T));
+   Mp = torad(fixangle(201.5643 + 385.81693528 * k + 0.0107582 * T * T + 0.00001238 * T * T * T -
+                       0.000000058 * T * T * T * T));
+   Om = torad(fixangle(124.7746 - 1.56375588 * k + 0.0020672 * T * T + 0.00000215 * T * T * T));
+   E = 1 - 0.002516 * T - 0.0000074 * T * T;
+   F1 = F - torad(0.02665) * sin(Om);
+   A1 = torad(299.77 + 0.107408 * k - 0.009173 * T * T);
+
+   /* time of greatest eclipse */
+   jde += full ? -0.4065 * sin(Mp) + 0.1727 * E * sin(M) : -0.4075 * sin(Mp) + 0.1721 * E * sin(M);
+   jde += 0.0161 * sin(2 * Mp) - 0.0097 * sin(2 * F1) + 0.0073 * E * sin(Mp - M) -
+      0.0050 * E * sin(Mp + M) - 0.0023 * sin(Mp - 2 * F1) + 0.0021 * E * sin(2 * M) +
+      0.0012 * sin(Mp + 2 * F1) + 0.0006 * E * sin(2 * Mp + M) - 0.0004 * sin(3 * Mp) -
+      0.0003 * E * sin(M + 2 * F1) + 0.0003 * sin(A1) - 0.0002 * E * sin(M - 2 * F1) -
+      0.0002 * E * sin(2 * Mp - M) - 0.0002 * sin(Om);
+
+   /* distance of the shadow's axis, and radius of the umbra (or penumbra) */
+   P = 0.2070 * E * sin(M) + 0.0024 * E * sin(2 * M) - 0.0392 * sin(Mp) + 0.0116 * sin(2 * Mp) -
+      0.0073 * E * sin(Mp + M) + 0.0067 * E * sin(Mp - M) + 0.0118 * sin(2 * F1);
+   Q = 5.2207 - 0.0048 * E * cos(M) + 0.0020 * E * cos(2 * M) - 0.3299 * cos(Mp) -
+      0.0060 * E * cos(Mp + M) + 0.0041 * E * cos(Mp - M);
+   W = fabs(cos(F1));
+   g = (P * cos(F1) + Q * sin(F1)) * (1 - 0.0048 * W);
+   u = 0.0059 + 0.0046 * E * cos(M) - 0.0182 * cos(Mp) + 0.0004 * cos(2 * Mp) -
+      0.0005 * cos(M + Mp);
+   ag = fabs(g);
+
+   pe->jd = jde - delta_t(2000.0 + (jde - JD_J2000) / 365.25) / SECS_PER_DAY;
+   pe->gamma = g;
+
+   if (full) {
+      if ((pe->mag = (1.0128 - u - ag) / 0.5450) >= 1.0) pe->type = ECL_TOTAL_LUNAR;
+      else if (pe->mag > 0.0) pe->type = ECL_PARTIAL_LUNAR;
+      else if ((pe->mag = (1.5573 + u - ag) / 0.5450) > 0.0) pe->type = ECL_PENUMBRAL;
+      else return FALSE;
+      return TRUE;
+   }
+
+   if (ag > 1.5433 + u) return FALSE;
+   pe->mag = -1.0;   /* (only calculated for partial eclipses) */
+   if (ag < 0.9972) {
+      /* central: total, annular, or both along the path */
+      w = 0.00464 * sqrt(1 - g * g);
+      pe->type = u < 0.0 ? ECL_TOTAL_SOLAR : u > w ? ECL_ANNULAR : ECL_HYBRID;
+   }
+   else if (ag < 0.9972 + fabs(u)) {
+      /* not central, but still total or annular somewhere */
+      pe->type = u < 0.0 ? ECL_TOTAL_SOLAR : ECL_ANNULAR;
+   }
+   else {
+      pe->type = ECL_PARTIAL_SOLAR;
+      pe->mag = (1.5433 + u - ag) / (0.5461 + 2 * u);
+   }
+   return TRUE;
+}
+
+/* ---------------------------------------------------------------------------
+
+   find_eclipses
+
+   Notes:
+
+      This routine finds the eclipses (of either kind) whose greatest
+      eclipse falls from Julian date 'jd0' up to (not including) 'jd1', UT,
+      and stores the first 'max' of them, in order, in 'ecl'.
+
+      It returns the number stored.
+
+*/
+int find_eclipses (double jd0, double jd1, eclipse_str_typ *ecl, int max)
+{
+   double k;
+   int n = 0;
+
+   /* from the syzygy before 'jd0' (the time of greatest eclipse may differ
+      from that of the mean syzygy by most of a day) to the one after 'jd1' */
+   for (k = floor((jd0 - JDE_K0) / SYN_MONTH * 2.0) / 2.0 - 0.5;
+        JDE_K0 + SYN_MONTH * k < jd1 + 1.0 && n < max; k += 0.5) {
+      if (eclipse_at(k, &ecl[n]) && ecl[n].jd >= jd0 && ecl[n].jd < jd1) n++;
+   }
+   return n;
+}
+
+/* ---------------------------------------------------------------------------
+
+   calc_eclipse_table
+
+   Notes:
+
+      This routine fills in 'ecl' (as the phases in 'tbl', by day and
+      month) with the type of eclipse, if any (cf. ECL_NONE etc.), on each
+      day of the months in 'tbl', in the current time zone.
+
+*/
+void calc_eclipse_table (phase_table_str_typ *tbl, char ecl[31][MAX_MONTHS])
+{
+   eclipse_str_typ found[MAX_ECLIPSES];
+   cal_month_str_typ *pm;
+   double jd0, jd1, off;
+   long jd_first;
+   int n, i, k, day;
+
+   memset(ecl, ECL_NONE, 31 * MAX_MONTHS);
+
+   /* (with a margin of more than a day for any UTC offset) */
+   pm = &tbl->month[tbl->nmonths - 1];
+   jd0 = (double) jdn(tbl->month[0].month, 1, tbl->month[0].year) - 2.0;
+   jd1 = (double) jdn(pm->month, pm->length, pm->year) + 2.0;
+   n = find_eclipses(jd0, jd1, found, MAX_ECLIPSES);
+
+   for (k = 0; k < n; k++) {
+      for (i = 0; i < tbl->nmonths; i++) {
+         pm = &tbl->month[i];
+         jd_first = jdn(pm->month, 1, pm->year);
+
+         /* the day of greatest eclipse in UT (within the month), and then
+            in local time, as for calc_phase() */
+         day = (int) (floor(found[k].jd + 0.5) - jd_first) + 1;
+         day = day < 1 ? 1 : day > pm->length ? pm->length : day;
+         off = utc_offset_days(time_zone, pm->month, day, pm->year);
+         day = (int) (floor(found[k].jd - off + 0.5) - jd_first) + 1;
+
+         if (day >= 1 && day <= pm->length) ecl[day-1][i] = (char) found[k].type;
+      }
+   }
+   return;
+}
+
+/* ---------------------------------------------------------------------------
+
+   eclipse_name
+
+   Notes:
+
+      This routine returns the name of the type of eclipse 'type' (e.g.
+      "total solar").
+
+*/
+char * eclipse_name (int type)
+{
+   return eclipse_names[type];
+}
@@ -0,0 +1,313 @@
+/* ---------------------------------------------------------------------------
+
+   lcaleph.c
+
+   Notes:
+
+      This file contains routines to generate and evaluate a compact
+      ephemeris file (cf. '-G' and '-E'), in which the moon's age (i.e. the
+      phase angle, in degrees) is approximated by Chebyshev polynomials, each
+      fitted over an interval of EPH_SPAN days.
+
+      Evaluating a polynomial takes just a few multiply-adds, which makes the
+      phase at any instant an order of magnitude cheaper to obtain than by
+      the full calculation by any phase engine (cf. moonphas.c), at the cost
+      of reading the file.
+
+      The file covers the years MIN_YR .. MAX_YR (with a margin for any UTC
+      offset) and consists of a header ('eph_header_str_typ') followed by
+      EPH_NCOEF single-precision coefficients for each interval, all in the
+      byte order of the machine which generated it.  The maximum error of the
+      approximation (measured at EPH_CHECKS points per interval while the
+      file is generated) is recorded in the header; with 8 coefficients per
+      8-day interval it is 1E-4 degrees, or 3E-7 of a lunation, for the
+      default engine.  Evaluating the moon's age takes about 30 nanoseconds,
+      vs. about 430 for the full calculation.
+
+*/
+
+/* ---------------------------------------------------------------------------
+
+   Header Files
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#ifdef BUILD_ENV_UNIX
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#endif
+
+/*
+ * Lcal-specific definitions:
+ */
+#include "lcaldefs.h"
+
+/* ---------------------------------------------------------------------------
+
+   Type, Struct, & Enum Declarations
+
+*/
+
+typedef struct {
+   char magic[8];   /* EPH_MAGIC */
+   int version;   /* PHASE_ALGO_VERSION of the fitted calculations */
+   char engine[16];   /* phase engine fitted (cf. '-P') */
+   int ncoef;   /* coefficients per interval */
+   int nintervals;
+   float max_err;   /* maximum error (degrees) */
+   double jd0;   /* Julian date at start of first interval */
+   double span;   /* days per interval */
+} eph_header_str_typ;
+
+/* ---------------------------------------------------------------------------
+
+   Constant Declarations
+
+*/
+
+#define EPH_MAGIC	"LCALEP2"	/* (bump on layout change) */
+#define EPH_CHECKS	32	/* error checks per interval */
+#define EPH_TMP	".tmp"	/* suffix of the file being written */
+
+#define fixangle(a) ((a) - 360.0 * (floor((a) / 360.0)))  /* fix angle */
+#define wrap180(a) (fixangle((a) + 180.0) - 180.0)   /* -180 .. 180 */
+
+/* ---------------------------------------------------------------------------
+
+   cheb_eval
+
+   Notes:
+
+      This routine evaluates the Chebyshev series with coefficients 'c[0]' ..
+      'c[EPH_NCOEF-1]' at 'x' (-1 .. 1), by Clenshaw's recurrence.
+
+*/
+static double cheb_eval (float *c, double x)
+{
+   double b0 = 0.0, b1 = 0.0, b2, x2 = 2.0 * x;
+   int j;
+
+   for (j = EPH_NCOEF - 1; j > 0; j--) {
+      b2 = b1;
+      b1 = b0;
+      b0 = x2 * b1 - b2 + c[j];
+   }
+   return x * b0 - b1 + c[0];
+}
+
+/* ---------------------------------------------------------------------------
+
+   eph_age
+
+   Notes:
+
+      This routine returns the moon's age in degrees (0 -> 360) at Julian
+      date 'jd', as approximated by the ephemeris 'peph', or -1 if 'jd' is
+      not covered by it.
+
+*/
+double eph_age (ephemeris_str_typ *peph, double jd)
+{
+   double x;
+   int i;
+
+   x = (jd - peph->jd0) / peph->span;
+   if (x < 0.0 || x >= peph->nintervals) return -1.0;
+
+   i = (int) x;
+   return fixangle(cheb_eval(peph->coef + i * EPH_NCOEF, 2.0 * (x - i) - 1.0));
+}
+
+/* ---------------------------------------------------------------------------
+
+   load_ephemeris
+
+   Notes:
+
+      This routine loads the ephemeris file 'name' (under Unix, by mapping it
+      into memory) into 'peph', which must be zeroed or hold an ephemeris
+      loaded before (which is released first, cf. unload_ephemeris()).
+
+      It returns FALSE if the file cannot be read or is not an ephemeris
+      file generated by this version of 'lcal' with the active phase engine,
+      or if its size does not match the number of intervals in its header
+      (e.g. a truncated file, which could not safely be mapped).
+
+*/
+int load_ephemeris (ephemeris_str_typ *peph, char *name)
+{
+   eph_header_str_typ hdr;
+   size_t size;
+   FILE *fp;
+   int ok;
+#ifdef BUILD_ENV_UNIX
+   struct stat st;
+   void *addr;
+   int fd;
+#endif
+
+   unload_ephemeris(peph);
+
+   if ((fp = fopen(name, "rb")) == NULL) return FALSE;
+   ok = fread(&hdr, sizeof(hdr), 1, fp) == 1 &&
+      strcmp(hdr.magic, EPH_MAGIC) == 0 && hdr.version == PHASE_ALGO_VERSION &&
+      strncmp(hdr.engine, phase_engine_name(), sizeof(hdr.engine)) == 0 &&
+      hdr.ncoef == EPH_NCOEF && hdr.nintervals > 0;
+
+   peph->jd0 = hdr.jd0;
+   peph->span = hdr.span;
+   peph->nintervals = hdr.nintervals;
+   peph->max_err = hdr.max_err;
+   size = (size_t) hdr.nintervals * EPH_NCOEF * sizeof(float);
+
+#ifdef BUILD_ENV_UNIX
+   fclose(fp);
+   if (!ok || (fd = open(name, O_RDONLY)) < 0) return FALSE;
+   if (fstat(fd, &st) != 0 || (size_t) st.st_size != sizeof(hdr) + size) {
+      close(fd);
+      return FALSE;
+   }
+
+   addr = mmap(NULL, sizeof(hdr) + size, PROT_READ, MAP_SHARED, fd, 0);
+   close(fd);
+   if (addr == MAP_FAILED) return FALSE;
+   peph->coef = (float *) ((char *) addr + sizeof(hdr));
+   peph->file_mtime = (long long) st.st_mtime;
+#else
+   ok = ok && (peph->coef = (float *) malloc(size)) != NULL &&
+      fread(peph->coef, size, 1, fp) == 1 && getc(fp) == EOF;
+   fclose(fp);
+   if (!ok) {
+      free(peph->coef);
+      peph->coef = NULL;
+      return FALSE;
+   }
+   peph->file_mtime = 0;
+#endif
+   peph->file_size = (long long) (sizeof(hdr) + size);
+
+   return TRUE;
+}
+
+/* ---------------------------------------------------------------------------
+
+   unload_ephemeris
+
+   Notes:
+
+      This routine releases the ephemeris loaded into 'peph' (if any) by
+      load_ephemeris().
+
+*/
+void unload_ephemeris (ephemeris_str_typ *peph)
+{
+   if (peph->coef == NULL) return;
+
+#ifdef BUILD_ENV_UNIX
+   munmap((char *) peph->coef - sizeof(eph_header_str_typ), (size_t) peph->file_size);
+#else
+   free(peph->coef);
+#endif
+   peph->coef = NULL;
+   return;
+}
+
+/* ---------------------------------------------------------------------------
+
+   write_ephemeris
+
+   Notes:
+
+      This routine generates the ephemeris file 'name', fitting the moon's
+      age as calculated by the active phase engine (cf. moonphas.c) over each
+      interval by interpolating it at the Chebyshev nodes, and then measuring
+      the error of the fit at EPH_CHECKS evenly spaced points.  The engine's
+      name is recorded in the file, for 'load_ephemeris()' to check.
+
+      The file is written under a temporary name and renamed to 'name' only
+      once it is complete, so that an interrupted run cannot leave a
+      truncated file that still looks valid.
+
+      It returns TRUE if the file was written successfully, and then writes
+      a one-line summary to stdout.
+
+*/
+int write_ephemeris (char *name)
+{
+   eph_header_str_typ hdr;
+   float coef[EPH_NCOEF];
+   double f[EPH_NCOEF], a, mid, ref, sum, err, max_err = 0.0;
+   char tmp_name[STRSIZ + 8];
+   FILE *fp;
+   int i, j, k, ok;
+
+   sprintf(tmp_name, "%.*s%s", STRSIZ - 1, name, EPH_TMP);
+   if ((fp = fopen(tmp_name, "wb")) == NULL) return FALSE;
+
+   /* cover the years MIN_YR .. MAX_YR, plus 2 days either side for UTC
+      offsets */
+   memset(&hdr, 0, sizeof(hdr));
+   strcpy(hdr.magic, EPH_MAGIC);
+   hdr.version = PHASE_ALGO_VERSION;
+   strncpy(hdr.engine, phase_engine_name(), sizeof(hdr.engine) - 1);
+   hdr.ncoef = EPH_NCOEF;
+   hdr.span = EPH_SPAN;
+   hdr.jd0 = JD_MIN_YR - 2.0;
+   hdr.nintervals = (int) ceil((JD_MAX_YR + 2.0 - hdr.jd0) / EPH_SPAN);
+
+   ok = fwrite(&hdr, sizeof(hdr), 1, fp) == 1;
+
+   for (i = 0; ok && i < hdr.nintervals; i++) {
+      a = hdr.jd0 + i * EPH_SPAN;
+      mid = a + EPH_SPAN / 2;
+
+      /* sample the age at the nodes, keeping it continuous across the
+         interval (i.e. not wrapped at 360 degrees) */
+      ref = fixangle(engine_age(mid));
+      for (k = 0; k < EPH_NCOEF; k++) {
+         f[k] = ref + wrap180(engine_age(mid + EPH_SPAN / 2 * cos(M_PI * (k + 0.5) / EPH_NCOEF)) - ref);
+      }
+
+      for (j = 0; j < EPH_NCOEF; j++) {
+         for (sum = 0.0, k = 0; k < EPH_NCOEF; k++) {
+            sum += f[k] * cos(M_PI * j * (k + 0.5) / EPH_NCOEF);
+         }
+         coef[j] = (float) (sum * (j ? 2.0 : 1.0) / EPH_NCOEF);
+      }
+
+      for (k = 0; k <= EPH_CHECKS; k++) {
+         err = fabs(wrap180(cheb_eval(coef, 2.0 * k / EPH_CHECKS - 1.0) -
+                            engine_age(a + EPH_SPAN * k / EPH_CHECKS)));
+         if (err > max_err) max_err = err;
+      }
+
+      ok = fwrite(coef, sizeof(coef), 1, fp) == 1;
+   }
+
+   /* record the maximum error in the header */
+   hdr.max_err = (float) max_err;
+   ok = ok && fseek(fp, 0L, SEEK_SET) == 0 && fwrite(&hdr, sizeof(hdr), 1, fp) == 1;
+   if (fclose(fp) != 0) ok = FALSE;
+
+#ifndef BUILD_ENV_UNIX
+   if (ok) remove(name);   /* (rename() does not replace a file here) */
+#endif
+   if (!ok || rename(tmp_name, name) != 0) {
+      remove(tmp_name);
+      return FALSE;
+   }
+
+   if (ok) {
+      printf("%s: %d intervals of %g days (%d-%d), maximum error %.2g degrees\n",
+             name, hdr.nintervals, hdr.span, MIN_YR, MAX_YR, max_err);
+   }
+   return ok;
+}
@@ -0,0 +1,352 @@
+/* ---------------------------------------------------------------------------
+
+   lcalfmt.c
+
+   Notes:
+
+      This file contains routines to format numbers into a character buffer
+      without going through 'printf()': integers, fixed-point values with up
+      to FMT_MAX_PREC decimals, and moon phases.  It also contains the
+      routines through which all the PostScript code is written, to stdout
+      or to a caller's sink (cf. liblcal.c).
+
+      Each routine writes its digits at 'p' and returns a pointer to the end
+      of what it wrote (without a terminating NUL), so that a whole line of
+      output can be assembled with a series of calls and written at once.
+
+      The output is byte-for-byte what the equivalent 'printf()' conversion
+      gives in the "C" locale (cf. 'lcalbench'), regardless of the current
+      locale.  Values whose rounding is too close to call from a double
+      (i.e. within FMT_TIE of half a unit in the last place), or which are
+      too large, are simply handed to 'sprintf()' (cf. fmt_sprintf(), which
+      puts back the '.' for the locale's decimal point).
+
+      The tables are initialized at compile time, so the 'fmt_...()'
+      routines (only) may be called from several threads at once.  The
+      destination of the PostScript code (cf. set_ps_sink()) and the count
+      of bytes written are per process, unsynchronized, so only one thread
+      at a time may write PostScript (cf. liblcal.h).
+
+*/
+
+/* ---------------------------------------------------------------------------
+
+   Header Files
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <locale.h>
+#include <math.h>
+
+/*
+ * Lcal-specific definitions:
+ */
+#include "lcaldefs.h"
+
+/* ---------------------------------------------------------------------------
+
+   Constant Declarations
+
+*/
+
+#define FMT_TIE	1E-6	/* fraction treated as a rounding tie */
+#define FMT_MAX_VAL	1E9	/* largest magnitude formatted here */
+
+/* ---------------------------------------------------------------------------
+
+   Data Declarations (including externals)
+
+*/
+
+/* "0.000" .. "0.999" */
+#define FRAC3(a, b, c)	{ '0', '.', a, b, c, '\0' }
+#define FRAC2(a, b)	FRAC3(a, b, '0'), FRAC3(a, b, '1'), FRAC3(a, b, '2'), FRAC3(a, b, '3'), \
+			FRAC3(a, b, '4'), FRAC3(a, b, '5'), FRAC3(a, b, '6'), FRAC3(a, b, '7'), \
+			FRAC3(a, b, '8'), FRAC3(a, b, '9')
+#define FRAC1(a)	FRAC2(a, '0'), FRAC2(a, '1'), FRAC2(a, '2'), FRAC2(a, '3'), FRAC2(a, '4'), \
+			FRAC2(a, '5'), FRAC2(a, '6'), FRAC2(a, '7'), FRAC2(a, '8'), FRAC2(a, '9')
+
+static const char frac_tbl[1000][6] = {
+   FRAC1('0'), FRAC1('1'), FRAC1('2'), FRAC1('3'), FRAC1('4'),
+   FRAC1('5'), FRAC1('6'), FRAC1('7'), FRAC1('8'), FRAC1('9')
+};
+
+static const long pow10_tbl[FMT_MAX_PREC + 1] = { 1L, 10L, 100L, 1000L, 10000L };
+
+/* destination of the PostScript code (cf. set_ps_sink()) - stdout if NULL */
+static ps_sink_typ ps_sink = NULL;
+static void *ps_sink_ctx = NULL;
+static int ps_sink_failed = FALSE;
+
+/* bytes of PostScript written (cf. lcalstat.c) */
+unsigned long long ps_byte_count = 0;
+
+/* ---------------------------------------------------------------------------
+
+   fmt_sprintf
+
+   Notes:
+
+      This routine formats 'x' with "%.<prec>f" by 'sprintf()', replacing
+      the current locale's decimal point (if it isn't '.') with '.'.
+
+*/
+static char * fmt_sprintf (char *p, double x, int prec)
+{
+   char *dp = localeconv()->decimal_point, *q;
+   size_t n = strlen(dp);
+   int len = sprintf(p, "%.*f", prec, x);
+
+   if (n > 0 && strcmp(dp, ".") != 0 && (q = strstr(p, dp)) != NULL) {
+      *q = '.';
+      memmove(q + 1, q + n, strlen(q + n) + 1);
+      len -= (int) n - 1;
+   }
+   return p + len;
+}
+
+/* ---------------------------------------------------------------------------
+
+   fmt_int
+
+   Notes:
+
+      This routine formats 'n' as "%ld" would.
+
+*/
+char * fmt_int (char *p, long n)
+{
+   char digits[24], *q = digits + sizeof(digits);
+   unsigned long u = n < 0 ? 0UL - (unsigned long) n : (unsigned long) n;
+
+   do {
+      *--q = (char) ('0' + u % 10);
+      u /= 10;
+   } while (u);
+
+   if (n < 0) *p++ = '-';
+   memcpy(p, q, digits + sizeof(digits) - q);
+   return p + (digits + sizeof(digits) - q);
+}
+
+/* ---------------------------------------------------------------------------
+
+   fmt_int_w
+
+   Notes:
+
+      This routine formats 'n' as "%*ld" would, right-justified in a field
+      of 'width' characters.
+
+*/
+char * fmt_int_w (char *p, long n, int width)
+{
+   char digits[24];
+   int len = (int) (fmt_int(digits, n) - digits);
+
+   for (; width > len; width--) *p++ = ' ';
+   memcpy(p, digits, len);
+   return p + len;
+}
+
+/* ---------------------------------------------------------------------------
+
+   fmt_fixed
+
+   Notes:
+
+      This routine formats 'x' as "%.<prec>f" would, for 'prec' 0 ..
+      FMT_MAX_PREC.
+
+*/
+char * fmt_fixed (char *p, double x, int prec)
+{
+   double s, frac;
+   long n, ip, fp;
+   int neg, i;
+
+   if (prec < 0 || prec > FMT_MAX_PREC) return fmt_sprintf(p, x, prec);
+
+   s = fabs(x) * pow10_tbl[prec];
+   frac = s - floor(s);
+
+   /* leave ties, huge values, NaNs, and zeros (for the sign) to sprintf() */
+   if (!(fabs(x) < FMT_MAX_VAL) || fabs(frac - 0.5) < FMT_TIE || x == 0.0) {
+      return fmt_sprintf(p, x, prec);
+   }
+
+   neg = x < 0.0;
+   n = (long) floor(s) + (frac > 0.5);
+   ip = n / pow10_tbl[prec];
+   fp = n % pow10_tbl[prec];
+
+   if (neg) *p++ = '-';
+   p = fmt_int(p, ip);
+   if (prec == 0) return p;
+
+   *p++ = '.';
+   if (prec == 3) {
+      memcpy(p, frac_tbl[fp] + 2, 3);
+      return p + 3;
+   }
+   for (i = prec - 1; i >= 0; i--, fp /= 10) p[i] = (char) ('0' + fp % 10);
+   return p + prec;
+}
+
+/* ---------------------------------------------------------------------------
+
+   fmt_phase
+
+   Notes:
+
+      This routine formats the moon phase 'phase' (0 .. 1) as "%.3f" would,
+      except that a phase which would round up to "1.000" is written as
+      "0.000" (i.e. it's a new moon either way).
+
+*/
+char * fmt_phase (char *p, double phase)
+{
+   double s;
+   int n;
+
+   if (phase >= 0.9995) phase = 0.0;
+
+   s = phase * 1000.0;
+   n = (int) s;
+   if (phase < 0.0 || fabs(s - n - 0.5) < FMT_TIE) {
+      return fmt_sprintf(p, phase, 3);
+   }
+   n += (s - n > 0.5);
+
+   memcpy(p, frac_tbl[n], 5);
+   return p + 5;
+}
+
+/* ---------------------------------------------------------------------------
+
+   fmt_hhmm
+
+   Notes:
+
+      This routine formats the time 'minutes' (after midnight) as "%02d:%02d"
+      would, or as "--:--" if it is negative (e.g. NO_RISE_SET).
+
+*/
+char * fmt_hhmm (char *p, int minutes)
+{
+   if (minutes < 0) {
+      memcpy(p, "--:--", 5);
+      return p + 5;
+   }
+   p[0] = (char) ('0' + minutes / 600);
+   p[1] = (char) ('0' + minutes / 60 % 10);
+   p[2] = ':';
+   p[3] = (char) ('0' + minutes % 60 / 10);
+   p[4] = (char) ('0' + minutes % 10);
+   return p + 5;
+}
+
+/* ---------------------------------------------------------------------------
+
+   set_ps_sink
+
+   Notes:
+
+      This routine makes 'ps_write()' and 'ps_printf()' pass their output to
+      'sink' (with 'ctx' as its 1st parameter) instead of writing it to
+      stdout.  A NULL 'sink' reverts to stdout.
+
+*/
+void set_ps_sink (ps_sink_typ sink, void *ctx)
+{
+   ps_sink = sink;
+   ps_sink_ctx = ctx;
+   ps_sink_failed = FALSE;
+   return;
+}
+
+/* ---------------------------------------------------------------------------
+
+   ps_sink_error
+
+   Notes:
+
+      This routine returns TRUE if the sink has failed (i.e. returned
+      nonzero) since it was set.  Nothing more is passed to a sink once it
+      has failed.
+
+*/
+int ps_sink_error (void)
+{
+   return ps_sink_failed;
+}
+
+/* ---------------------------------------------------------------------------
+
+   ps_write
+
+   Notes:
+
+      This routine writes the 'len' characters at 'buf' to the PostScript
+      output.
+
+*/
+void ps_write (char *buf, size_t len)
+{
+   ps_byte_count += len;
+   if (ps_sink == NULL) fwrite(buf, 1, len, stdout);
+   else if (!ps_sink_failed && (*ps_sink)(ps_sink_ctx, buf, len) != 0) {
+      ps_sink_failed = TRUE;
+   }
+   return;
+}
+
+/* ---------------------------------------------------------------------------
+
+   ps_printf
+
+   Notes:
+
+      This routine writes to the PostScript output as 'printf()' would.
+
+*/
+void ps_printf (char *fmt, ...)
+{
+   va_list ap;
+   int len;
+#ifdef BUILD_ENV_UNIX
+   char buf[LINSIZ], *p;
+#endif
+
+   va_start(ap, fmt);
+#ifdef BUILD_ENV_UNIX
+   if (ps_sink != NULL) {
+      len = vsnprintf(buf, sizeof(buf), fmt, ap);
+      va_end(ap);
+      if (len < 0) return;
+      if (len < (int) sizeof(buf)) {
+         ps_write(buf, len);
+         return;
+      }
+
+      /* (longer than any line lcal writes, but just in case...) */
+      if ((p = (char *) malloc(len + 1)) == NULL) {
+         ps_sink_failed = TRUE;
+         return;
+      }
+      va_start(ap, fmt);
+      vsnprintf(p, len + 1, fmt, ap);
+      va_end(ap);
+      ps_write(p, len);
+      free(p);
+      return;
+   }
+#endif
+   if ((len = vprintf(fmt, ap)) > 0) ps_byte_count += len;
+   va_end(ap);
+   return;
+}
@@ -0,0 +1,335 @@
+/* ---------------------------------------------------------------------------
+
+   lcalrip.c
+
+   Notes:
+
+      This program measures what lcal's output costs to print: the time and
+      memory a PostScript interpreter (Ghostscript, as installed locally)
+      needs to rasterize each of a set of files, at each of several
+      resolutions.  It is built and run on a sample of lcal's layout modes
+      by "make ripbench", and is not installed; run it by hand on the output
+      of 2 versions of lcal to see how a change to the prolog affects the
+      printers.
+
+      Each file is rendered in full ('-sDEVICE=ppmraw', to /dev/null)
+      'repeats' times per resolution, and the median wall-clock and
+      processor (user + system) times per page are reported, with the peak
+      memory of the interpreter (its maximum resident set size) and the
+      file's size and number of pages (from its "%%Pages:" comment).  The
+      results are printed as a table and, with '-o', written as JSON (to
+      stdout if "-", the table then going to stderr).
+
+      Usage: lcalrip [-g GS] [-d DPI{,DPI...}] [-r REPEATS] [-o FILE] FILE.ps ...
+
+      The interpreter defaults to "gs" (or $GS), found along $PATH.
+
+      Unix only.
+
+*/
+
+/* ---------------------------------------------------------------------------
+
+   Header Files
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+/*
+ * Lcal-specific definitions:
+ */
+#include "lcaldefs.h"
+
+/* ---------------------------------------------------------------------------
+
+   Constant Declarations
+
+*/
+
+#define DEFAULT_GS	"gs"	/* (or $GS_ENV) */
+#define GS_ENV		"GS"
+#define DEFAULT_DPIS	"72,150,300"
+#define RIP_REPEATS	3	/* renderings per file and resolution (default) */
+#define MAX_REPEATS	100
+#define MAX_DPIS	16
+
+#define EXIT_NO_EXEC	127	/* (from the child if the interpreter can't be run) */
+
+/* ---------------------------------------------------------------------------
+
+   Type, Struct, & Enum Declarations
+
+*/
+
+/* one rendering of a file */
+typedef struct {
+   double wall_ns, cpu_ns;   /* elapsed and processor time */
+   long maxrss_kb;   /* peak memory */
+} rip_run_str_typ;
+
+/* ---------------------------------------------------------------------------
+
+   Data Declarations (including externals)
+
+*/
+
+static char *gs = DEFAULT_GS;   /* -g */
+static int dpis[MAX_DPIS];   /* -d */
+static int num_dpis = 0;
+static int repeats = RIP_REPEATS;   /* -r */
+static char *json_file = NULL;   /* -o */
+
+/* ---------------------------------------------------------------------------
+
+   now_ns
+
+   Notes:
+
+      This routine returns the (monotonic) time in nanoseconds from an
+      arbitrary origin.
+
+*/
+static double now_ns (void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec * 1E9 + ts.tv_nsec;
+}
+
+/* ---------------------------------------------------------------------------
+
+   count_pages
+
+   Notes:
+
+      This routine returns the number of pages in the PostScript file
+      'name', from its "%%Pages:" comment (or else by counting its "%%Page:"
+      comments), or -1 if it can't be read.
+
+*/
+static int count_pages (char *name)
+{
+   FILE *fp;
+   char line[LINSIZ];
+   int pages = 0, n;
+
+   if ((fp = fopen(name, "r")) == NULL) return -1;
+   while (fgets(line, sizeof(line), fp) != NULL) {
+      if (sscanf(line, "%%%%Pages: %d", &n) == 1 && n > 0) {
+         pages = n;
+         break;
+      }
+      if (strncmp(line, "%%Page:", 7) == 0) pages++;
+   }
+   fclose(fp);
+   return pages > 0 ? pages : 1;
+}
+
+/* ---------------------------------------------------------------------------
+
+   render
+
+   Notes:
+
+      This routine renders the file 'name' at 'dpi' dots per inch, filling
+      in '*pr'.  It returns FALSE (after reporting why) if the interpreter
+      can't be run or fails.
+
+*/
+static int render (char *name, int dpi, rip_run_str_typ *pr)
+{
+   char res[32];
+   struct rusage ru;
+   double t0;
+   pid_t pid;
+   int status, fd;
+
+   sprintf(res, "-r%d", dpi);
+   fflush(stdout);
+   t0 = now_ns();
+
+   if ((pid = fork()) == 0) {
+      if ((fd = open("/dev/null", O_WRONLY)) >= 0) dup2(fd, STDOUT_FILENO);
+      execlp(gs, gs, "-q", "-dNOPAUSE", "-dBATCH", "-dSAFER", "-sDEVICE=ppmraw", res,
+             "-sOutputFile=/dev/null", name, (char *) NULL);
+      _exit(EXIT_NO_EXEC);
+   }
+   if (pid < 0 || wait4(pid, &status, 0, &ru) != pid) {
+      fprintf(stderr, "lcalrip: can't run %s\n", gs);
+      return FALSE;
+   }
+   pr->wall_ns = now_ns() - t0;
+
+   if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+      if (WIFEXITED(status) && WEXITSTATUS(status) == EXIT_NO_EXEC) {
+         fprintf(stderr, "lcalrip: can't run %s (is Ghostscript installed? cf. -g, $%s)\n", gs, GS_ENV);
+      }
+      else fprintf(stderr, "lcalrip: %s failed on %s at %d dpi\n", gs, name, dpi);
+      return FALSE;
+   }
+
+   pr->cpu_ns = (ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1E9 +
+      (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) * 1E3;
+   pr->maxrss_kb = ru.ru_maxrss;   /* (kilobytes under Linux and BSD) */
+   return TRUE;
+}
+
+/* ---------------------------------------------------------------------------
+
+   cmp_double
+
+   Notes:
+
+      This routine compares 2 doubles for 'qsort()'.
+
+*/
+static int cmp_double (const void *a, const void *b)
+{
+   double x = *(const double *) a, y = *(const double *) b;
+
+   return x < y ? -1 : x > y;
+}
+
+/* ---------------------------------------------------------------------------
+
+   median
+
+   Notes:
+
+      This routine returns the median of the 'n' values at 'x' (which it
+      sorts).
+
+*/
+static double median (double *x, int n)
+{
+   qsort(x, n, sizeof(x[0]), cmp_double);
+   return n % 2 ? x[n / 2] : (x[n / 2 - 1] + x[n / 2]) / 2;
+}
+
+/* ---------------------------------------------------------------------------
+
+   get_dpis
+
+   Notes:
+
+      This routine parses the comma-separated list of resolutions 'list'
+      into 'dpis[]'.  It returns FALSE, leaving 'dpis[]' unchanged, if any
+      is invalid.
+
+*/
+static int get_dpis (char *list)
+{
+   int tmp[MAX_DPIS], n;
+   char *p;
+
+   for (n = 0, p = list; n < MAX_DPIS; p++) {
+      if ((tmp[n++] = (int) strtol(p, &p, 10)) <= 0 || (*p && *p != ',')) return FALSE;
+      if (*p == '\0') {
+         memcpy(dpis, tmp, n * sizeof(int));
+         num_dpis = n;
+         return TRUE;
+      }
+   }
+   return FALSE;
+}
+
+/* ---------------------------------------------------------------------------
+
+   main
+
+*/
+int main (int argc, char **argv)
+{
+   static double wall[MAX_REPEATS], cpu[MAX_REPEATS];
+   rip_run_str_typ run;
+   struct stat st;
+   FILE *fp = NULL, *out = stdout;
+   char *name, *p;
+   long maxrss;
+   int i, d, r, n, pages, ok = TRUE, first = TRUE, badopt = FALSE;
+
+   if (getenv(GS_ENV) != NULL && *getenv(GS_ENV)) gs = getenv(GS_ENV);
+   (void) get_dpis(DEFAULT_DPIS);
+
+   /* (each flag takes a value, which is checked before it is used) */
+   for (i = 1; i < argc && argv[i][0] == '-' && argv[i][1] && !badopt; i++) {
+      if (i + 1 >= argc) badopt = TRUE;
+      else if (strcmp(argv[i], "-g") == 0) gs = argv[++i];
+      else if (strcmp(argv[i], "-d") == 0) badopt = !get_dpis(argv[++i]);
+      else if (strcmp(argv[i], "-r") == 0) {
+         n = (int) strtol(argv[++i], &p, 10);
+         if (*p || n < 1 || n > MAX_REPEATS) badopt = TRUE;
+         else repeats = n;
+      }
+      else if (strcmp(argv[i], "-o") == 0) json_file = argv[++i];
+      else badopt = TRUE;
+   }
+   if (badopt || i >= argc || argv[i][0] == '-') {
+      fprintf(stderr, "usage: lcalrip [-g GS] [-d DPI{,DPI...}] [-r REPEATS (1 .. %d)] [-o FILE] FILE.ps ...\n",
+              MAX_REPEATS);
+      exit(EXIT_FAILURE);
+   }
+
+   if (json_file && (fp = strcmp(json_file, "-") == 0 ? stdout : fopen(json_file, "w")) == NULL) {
+      fprintf(stderr, "lcalrip: can't open file %s\n", json_file);
+      exit(EXIT_FAILURE);
+   }
+   if (fp == stdout) out = stderr;   /* (the table, with JSON on stdout) */
+   if (fp) fprintf(fp, "{\n  \"program\": \"lcalrip\",\n  \"interpreter\": \"%s\",\n  \"repeats\": %d,\n"
+                   "  \"renders\": [", gs, repeats);
+
+   fprintf(out, "%-28s %9s %5s %5s %12s %12s %9s\n", "file", "bytes", "pages", "dpi", "ms/page", "cpu ms/page",
+          "peak MB");
+
+   for (; i < argc && ok; i++) {
+      name = argv[i];
+      if (stat(name, &st) != 0 || (pages = count_pages(name)) < 0) {
+         fprintf(stderr, "lcalrip: can't open file %s\n", name);
+         ok = FALSE;
+         break;
+      }
+
+      for (d = 0; d < num_dpis && ok; d++) {
+         maxrss = 0;
+         for (r = 0; r < repeats && ok; r++) {
+            if (!(ok = render(name, dpis[d], &run))) break;
+            wall[r] = run.wall_ns / pages;
+            cpu[r] = run.cpu_ns / pages;
+            if (run.maxrss_kb > maxrss) maxrss = run.maxrss_kb;
+         }
+         if (!ok) break;
+
+         fprintf(out, "%-28s %9ld %5d %5d %12.2f %12.2f %9.1f\n", name, (long) st.st_size, pages, dpis[d],
+                median(wall, repeats) / 1E6, median(cpu, repeats) / 1E6, maxrss / 1024.0);
+         if (fp) {
+            fprintf(fp, "%s\n    { \"file\": \"%s\", \"bytes\": %ld, \"pages\": %d, \"dpi\": %d,"
+                    " \"ms_per_page\": %.3f, \"cpu_ms_per_page\": %.3f, \"peak_kb\": %ld }",
+                    first ? "" : ",", name, (long) st.st_size, pages, dpis[d],
+                    median(wall, repeats) / 1E6, median(cpu, repeats) / 1E6, maxrss);
+            first = FALSE;
+         }
+      }
+   }
+
+   if (fp) {
+      fprintf(fp, "\n  ]\n}\n");
+      if (fp != stdout && fclose(fp) != 0) {
+         fprintf(stderr, "lcalrip: can't write file %s\n", json_file);
+         exit(EXIT_FAILURE);
+      }
+   }
+
+   exit(ok ? EXIT_SUCCESS : EXIT_FAILURE);
+}
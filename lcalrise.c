@@ -0,0 +1,301 @@
+/* ---------------------------------------------------------------------------
+
+   lcalrise.c
+
+   Notes:
+
+      This file contains routines to calculate the times of moonrise and
+      moonset at a given place (cf. '-g'), on each day of a calendar.
+
+      Rather than solving for each rising and setting separately, which
+      would mean evaluating the moon's position many times a day, the
+      position (its direction in equatorial coordinates, and its parallax)
+      is calculated once every RISE_GRID_STEP days over the whole calendar,
+      and merely interpolated for the altitude at each hour of each local
+      day, the sidereal time being advanced by a rotation; the crossings of
+      the horizon are then found among the 25 hourly altitudes by fitting a
+      parabola through each 3 in turn (the method of Montenbruck & Pfleger,
+      "Astronomy on the Personal Computer").  A year of risings and
+      settings thus takes about a millisecond, and interpolating every half
+      day changes a time by a minute only a few times a year.
+
+      The moon's position is calculated from the largest terms of the
+      ELP-2000/82 theory (Meeus, "Astronomical Algorithms", 2nd ed.,
+      chapter 47), good to about 0.05 degrees, and the moon is taken to
+      rise or set when its centre is at the altitude h0 = 0.7275 * parallax
+      - 0.5667 degrees, allowing for its parallax and semidiameter and for
+      refraction (Meeus, chapter 15).  The times are thus good to a minute
+      or two, but for a moon which just grazes the horizon.
+
+*/
+
+/* ---------------------------------------------------------------------------
+
+   Header Files
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+/*
+ * Lcal-specific definitions:
+ */
+#include "lcaldefs.h"
+
+/* ---------------------------------------------------------------------------
+
+   Type, Struct, & Enum Declarations
+
+*/
+
+typedef struct {
+   signed char d, m, mp, f;   /* multiples of D, M, M', F */
+   long coef;   /* coefficient (1E-6 degrees, or 1E-3 km) */
+   long coef_r;   /* coefficient of the distance (1E-3 km), if any */
+} moon_term_str_typ;
+
+/* ---------------------------------------------------------------------------
+
+   Constant Declarations
+
+*/
+
+#define RISE_GRID_STEP	0.5	/* days between lunar positions */
+#define RISE_GRID_MAX	((MAX_MONTHS * 31 + 6) * 2 + 1)	/* (for the step above) */
+
+#define DAYS_PER_CENTURY	36525.0
+#define EARTH_RADIUS	6378.14	/* km */
+
+#define fixangle(a) ((a) - 360.0 * (floor((a) / 360.0)))  /* fix angle */
+#define torad(d) ((d) * (M_PI / 180.0))   /* deg->rad */
+
+/* ---------------------------------------------------------------------------
+
+   Data Declarations (including externals)
+
+*/
+
+/* largest periodic terms for the moon's longitude and distance (Meeus,
+   table 47.A) ... */
+static moon_term_str_typ lon_terms[] = {
+   { 0,  0,  1,  0, 6288774, -20905355 }, { 2,  0, -1,  0, 1274027, -3699111 },
+   { 2,  0,  0,  0,  658314,  -2955968 }, { 0,  0,  2,  0,  213618,  -569925 },
+   { 0,  1,  0,  0, -185116,     48888 }, { 0,  0,  0,  2, -114332,    -3149 },
+   { 2,  0, -2,  0,   58793,    246158 }, { 2, -1, -1,  0,   57066,  -152138 },
+   { 2,  0,  1,  0,   53322,   -170733 }, { 2, -1,  0,  0,   45758,  -204586 },
+   { 0,  1, -1,  0,  -40923,   -129620 }, { 1,  0,  0,  0,  -34720,   108743 },
+   { 0,  1,  1,  0,  -30383,    104755 }, { 2,  0,  0, -2,   15327,    10321 },
+};
+
+/* ... and latitude (table 47.B) */
+static moon_term_str_typ lat_terms[] = {
+   { 0,  0,  0,  1, 5128122, 0 }, { 0,  0,  1,  1,  280602, 0 },
+   { 0,  0,  1, -1,  277693, 0 }, { 2,  0,  0, -1,  173237, 0 },
+   { 2,  0, -1,  1,   55413, 0 }, { 2,  0, -1, -1,   46271, 0 },
+   { 2,  0,  0,  1,   32573, 0 }, { 0,  0,  2,  1,   17198, 0 },
+   { 2,  0,  1, -1,    9266, 0 }, { 0,  0,  2, -1,    8822, 0 },
+};
+
+#define NUM_LON_TERMS	(int) (sizeof(lon_terms) / sizeof(lon_terms[0]))
+#define NUM_LAT_TERMS	(int) (sizeof(lat_terms) / sizeof(lat_terms[0]))
+
+/* the moon's position every RISE_GRID_STEP days (cf. moon_position()) */
+static double grid[RISE_GRID_MAX][4];
+
+/* ---------------------------------------------------------------------------
+
+   moon_position
+
+   Notes:
+
+      This routine calculates the moon's geocentric position at the Julian
+      date (UT) 'jd': the direction cosines of the moon in equatorial
+      coordinates of date in 'v[0..2]', and the sine of the altitude at
+      which it rises or sets (cf. h0 above) in 'v[3]'.
+
+*/
+static void moon_position (double jd, double *v)
+{
+   double T, Lp, D, M, Mp, F, E, arg, lambda, beta, dist, eps, h0;
+   moon_term_str_typ *pt;
+   double sigma_l = 0.0, sigma_b = 0.0, sigma_r = 0.0, e_fac;
+   int i;
+
+   /* Julian centuries of Dynamical Time since J2000.0 */
+   jd += delta_t(2000.0 + (jd - JD_J2000) / 365.25) / SECS_PER_DAY;
+   T = (jd - JD_J2000) / DAYS_PER_CENTURY;
+
+   /* mean elements (as for meeus_age()) */
+   Lp = 218.3164477 + T * (481267.88123421 + T * (-0.0015786 + T * (1.0 / 538841.0 - T / 65194000.0)));
+   D = torad(fixangle(297.8501921 + T * (445267.1114034 + T * (-0.0018819 + T * (1.0 / 545868.0 - T / 113065000.0)))));
+   M = torad(fixangle(357.5291092 + T * (35999.0502909 + T * (-0.0001536 + T / 24490000.0))));
+   Mp = torad(fixangle(134.9633964 + T * (477198.8675055 + T * (0.0087414 + T * (1.0 / 69699.0 - T / 14712000.0)))));
+   F = torad(fixangle(93.2720950 + T * (483202.0175233 + T * (-0.0036539 + T * (-1.0 / 3526000.0 + T / 863310000.0)))));
+   E = 1.0 - T * (0.002516 + T * 0.0000074);
+
+   for (i = 0, pt = lon_terms; i < NUM_LON_TERMS; i++, pt++) {
+      arg = pt->d * D + pt->m * M + pt->mp * Mp + pt->f * F;
+      e_fac = pt->m ? E : 1.0;
+      sigma_l += pt->coef * e_fac * sin(arg);
+      sigma_r += pt->coef_r * e_fac * cos(arg);
+   }
+   for (i = 0, pt = lat_terms; i < NUM_LAT_TERMS; i++, pt++) {
+      sigma_b += pt->coef * sin(pt->d * D + pt->m * M + pt->mp * Mp + pt->f * F);
+   }
+
+   lambda = torad(Lp + sigma_l / 1E6);
+   beta = torad(sigma_b / 1E6);
+   dist = 385000.56 + sigma_r / 1E3;
+
+   /* ecliptic -> equatorial (mean obliquity) */
+   eps = torad(23.439291 - 0.0130042 * T);
+   v[0] = cos(beta) * cos(lambda);
+   v[1] = cos(beta) * sin(lambda) * cos(eps) - sin(beta) * sin(eps);
+   v[2] = cos(beta) * sin(lambda) * sin(eps) + sin(beta) * cos(eps);
+
+   h0 = 0.7275 * asin(EARTH_RADIUS / dist) - torad(0.5667);
+   v[3] = sin(h0);
+   return;
+}
+
+/* ---------------------------------------------------------------------------
+
+   find_crossings
+
+   Notes:
+
+      This routine finds the first rising and setting among the hourly
+      values 'y[0..24]' of sin(altitude) - sin(h0), by fitting a parabola
+      through each 3 in turn, and stores them (in minutes, or NO_RISE_SET
+      if none) in '*prise' and '*pset'.
+
+*/
+static void find_crossings (double *y, short *prise, short *pset)
+{
+   double a, b, c, xe, ye, dis, dx, z1, z2;
+   double rise = -1.0, set = -1.0;
+   int h, nz;
+
+   for (h = 1; h < 24; h += 2) {
+      a = 0.5 * (y[h+1] + y[h-1]) - y[h];
+      b = 0.5 * (y[h+1] - y[h-1]);
+      c = y[h];
+
+      if (a == 0.0) {   /* (a straight line) */
+         if (b == 0.0) continue;
+         z1 = -c / b;
+         nz = fabs(z1) <= 1.0;
+         ye = 0.0;
+         z2 = z1;
+      }
+      else {
+         xe = -b / (2.0 * a);
+         ye = (a * xe + b) * xe + c;
+         if ((dis = b * b - 4.0 * a * c) < 0.0) continue;
+         dx = 0.5 * sqrt(dis) / fabs(a);
+         z1 = xe - dx;
+         z2 = xe + dx;
+         nz = (fabs(z1) <= 1.0) + (fabs(z2) <= 1.0);
+         if (fabs(z1) > 1.0) z1 = z2;
+      }
+
+      if (nz == 1) {
+         if (y[h-1] < 0.0) { if (rise < 0.0) rise = h + z1; }
+         else if (set < 0.0) set = h + z1;
+      }
+      else if (nz == 2) {
+         if (ye < 0.0) {
+            if (rise < 0.0) rise = h + z2;
+            if (set < 0.0) set = h + z1;
+         }
+         else {
+            if (rise < 0.0) rise = h + z1;
+            if (set < 0.0) set = h + z2;
+         }
+      }
+   }
+
+   *prise = rise < 0.0 ? NO_RISE_SET : (short) (rise * 60.0 + 0.5 > 1439 ? 1439 : rise * 60.0 + 0.5);
+   *pset = set < 0.0 ? NO_RISE_SET : (short) (set * 60.0 + 0.5 > 1439 ? 1439 : set * 60.0 + 0.5);
+   return;
+}
+
+/* ---------------------------------------------------------------------------
+
+   calc_rise_set_table
+
+   Notes:
+
+      This routine fills in 'rise' and 'set' (as the phases in 'tbl', by
+      day and month) with the local times, in minutes after midnight, of the
+      first moonrise and moonset (or NO_RISE_SET if there is none) of each
+      day of the months in 'tbl', in the current time zone, at latitude
+      'lat' and longitude 'lon' (degrees, north and east positive).
+
+*/
+void calc_rise_set_table (phase_table_str_typ *tbl, double lat, double lon,
+                          short rise[31][MAX_MONTHS], short set[31][MAX_MONTHS])
+{
+   cal_month_str_typ *pm;
+   double jd0, jd, x, t, w[4], v[4], y[25], theta, sin_lat, cos_lat;
+   double cos_th, sin_th, cos_hr, sin_hr, tmp;
+   int npoints, i, k, h, day, j;
+
+   /* the moon's position over the calendar (with a margin of more than a
+      day either side for any UTC offset, and for the interpolation) */
+   pm = &tbl->month[tbl->nmonths - 1];
+   jd0 = (double) jdn(tbl->month[0].month, 1, tbl->month[0].year) - 3.0;
+   npoints = (int) ((jdn(pm->month, pm->length, pm->year) + 3.0 - jd0) / RISE_GRID_STEP) + 1;
+   for (k = 0; k < npoints; k++) moon_position(jd0 + k * RISE_GRID_STEP, grid[k]);
+
+   sin_lat = sin(torad(lat));
+   cos_lat = cos(torad(lat));
+   cos_hr = cos(torad(360.98564736629 / 24));
+   sin_hr = sin(torad(360.98564736629 / 24));
+
+   for (i = 0; i < tbl->nmonths; i++) {
+      pm = &tbl->month[i];
+      for (day = 1; day <= 31; day++) {
+         if (day > pm->length) {
+            rise[day-1][i] = set[day-1][i] = NO_RISE_SET;
+            continue;
+         }
+
+         /* from local midnight (UT), hourly */
+         jd = (double) jdn(pm->month, day, pm->year) - 0.5 +
+            utc_offset_days(time_zone, pm->month, day, pm->year);
+
+         /* local sidereal time then (Meeus 12.4, less the tiny T^2 terms),
+            advanced by rotation each hour */
+         theta = torad(fixangle(280.46061837 + 360.98564736629 * (jd - JD_J2000) + lon));
+         cos_th = cos(theta);
+         sin_th = sin(theta);
+
+         for (h = 0; h <= 24; h++, jd += 1.0 / 24) {
+            /* the position, by Lagrange interpolation through the 4
+               nearest points (cf. grid_phase()) */
+            x = (jd - jd0) / RISE_GRID_STEP;
+            k = (int) floor(x);
+            t = x - k;
+            w[0] = -t * (t - 1) * (t - 2) / 6;
+            w[1] = (t + 1) * (t - 1) * (t - 2) / 2;
+            w[2] = -(t + 1) * t * (t - 2) / 2;
+            w[3] = (t + 1) * t * (t - 1) / 6;
+            for (j = 0; j < 4; j++) {
+               v[j] = w[0] * grid[k-1][j] + w[1] * grid[k][j] + w[2] * grid[k+1][j] + w[3] * grid[k+2][j];
+            }
+            y[h] = cos_lat * (v[0] * cos_th + v[1] * sin_th) + sin_lat * v[2] - v[3];
+
+            tmp = cos_th * cos_hr - sin_th * sin_hr;
+            sin_th = sin_th * cos_hr + cos_th * sin_hr;
+            cos_th = tmp;
+         }
+
+         find_crossings(y, &rise[day-1][i], &set[day-1][i]);
+      }
+   }
+   return;
+}
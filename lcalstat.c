@@ -0,0 +1,219 @@
+/* ---------------------------------------------------------------------------
+
+   lcalstat.c
+
+   Notes:
+
+      This file contains routines to collect and report statistics on a run
+      of 'lcal' (cf. '-T'): the time spent in each stage of generating the
+      calendars (cf. STAGE_NAMES), the bytes of PostScript written, and the
+      number of calls to 'calc_phase()' and of iterations of 'kepler()' (the
+      latter being one Newton step per call, cf. kepler()).
+
+      Unless the statistics are enabled (or the run is traced, cf.
+      lcaltrace.c), the stages aren't timed and the calls aren't counted at
+      all (cf. STATS_CLOCK(), STATS_ADD(), STATS_COUNT()).
+
+      Each process accumulates its own statistics, and adds them to a total
+      shared with the processes it forks (cf. stats_merge()) -- the layout
+      variants and the job workers -- so the times reported are summed over
+      all of them, and may exceed the elapsed time.
+
+*/
+
+/* ---------------------------------------------------------------------------
+
+   Header Files
+
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef BUILD_ENV_UNIX
+#include <sys/types.h>
+#include <sys/mman.h>
+#endif
+
+/*
+ * Lcal-specific definitions:
+ */
+#include "lcaldefs.h"
+
+/* ---------------------------------------------------------------------------
+
+   Data Declarations (including externals)
+
+*/
+
+int stats_on = FALSE;   /* -T, $LCAL_STATS */
+
+static char *stage_names[NUM_STAGES] = { STAGE_NAMES };
+
+static stats_str_typ local_stats;   /* not yet added to 'total_stats' */
+static stats_str_typ *total_stats = NULL;   /* (shared with child processes) */
+static double start_ns;
+
+/* the counters, as of the last merge */
+static unsigned long long last_bytes, last_calc_phase, last_kepler;
+
+/* ---------------------------------------------------------------------------
+
+   stats_clock
+
+   Notes:
+
+      This routine returns the (monotonic, if possible) time in nanoseconds
+      from an arbitrary origin.
+
+*/
+double stats_clock (void)
+{
+#ifdef BUILD_ENV_UNIX
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec * 1E9 + ts.tv_nsec;
+#else
+   return clock() * (1E9 / CLOCKS_PER_SEC);
+#endif
+}
+
+/* ---------------------------------------------------------------------------
+
+   stats_add
+
+   Notes:
+
+      This routine adds the time since 't0' (cf. stats_clock()) to the
+      stage 'stage' (and traces it, cf. lcaltrace.c).
+
+*/
+void stats_add (int stage, double t0)
+{
+   double t1 = stats_clock();
+
+   local_stats.ns[stage] += (unsigned long long) (t1 - t0);
+   if (trace_on) trace_span(stage_names[stage], t0, t1, NULL);
+   return;
+}
+
+/* ---------------------------------------------------------------------------
+
+   stats_begin
+
+   Notes:
+
+      This routine sets up the total of the statistics, once they are
+      enabled, for a run which began at 't_start' (cf. stats_clock()).  It
+      must be called before any process is forked.
+
+*/
+void stats_begin (double t_start)
+{
+   static stats_str_typ total;
+
+   start_ns = t_start;
+   total_stats = &total;
+#ifdef BUILD_ENV_UNIX
+   total_stats = (stats_str_typ *) mmap(NULL, sizeof(stats_str_typ), PROT_READ | PROT_WRITE,
+                                        MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+   if (total_stats == (stats_str_typ *) MAP_FAILED) total_stats = &total;   /* (children's stats lost) */
+#endif
+   memset(total_stats, 0, sizeof(stats_str_typ));
+   return;
+}
+
+/* ---------------------------------------------------------------------------
+
+   stats_merge
+
+   Notes:
+
+      This routine adds the statistics of this process to the total, and
+      clears them.  It must be called before forking a process (lest the
+      child's copy be counted again), and by a child before it exits.
+
+*/
+void stats_merge (void)
+{
+   stats_str_typ delta;
+   unsigned long long *pd, *pt;
+   int i;
+
+   if (total_stats == NULL) return;
+
+   delta = local_stats;
+   delta.bytes = ps_byte_count - last_bytes;
+   delta.calc_phase_calls = calc_phase_count - last_calc_phase;
+   delta.kepler_calls = kepler_count - last_kepler;
+
+   memset(&local_stats, 0, sizeof(local_stats));
+   last_bytes = ps_byte_count;
+   last_calc_phase = calc_phase_count;
+   last_kepler = kepler_count;
+
+   pd = (unsigned long long *) &delta;
+   pt = (unsigned long long *) total_stats;
+   for (i = 0; i < (int) (sizeof(delta) / sizeof(*pd)); i++) {
+#ifdef BUILD_ENV_UNIX
+      (void) __sync_fetch_and_add(&pt[i], pd[i]);
+#else
+      pt[i] += pd[i];
+#endif
+   }
+   return;
+}
+
+/* ---------------------------------------------------------------------------
+
+   stats_report
+
+   Notes:
+
+      This routine reports the statistics of the run: to stderr, or as JSON
+      to the file 'json_name' if it is not empty.  It returns FALSE (after
+      reporting the error) if the file can't be written.
+
+*/
+int stats_report (char *json_name)
+{
+   stats_str_typ *ps;
+   FILE *fp;
+   double wall;
+   int i;
+
+   if (total_stats == NULL) return TRUE;
+
+   stats_merge();
+   ps = total_stats;
+   wall = stats_clock() - start_ns;
+
+   if (json_name == NULL || *json_name == '\0') {
+      fprintf(stderr, "%s: statistics (ms):\n", progname);
+      for (i = 0; i < NUM_STAGES; i++) {
+         fprintf(stderr, "   %-20s %10.3f\n", stage_names[i], ps->ns[i] / 1E6);
+      }
+      fprintf(stderr, "   %-20s %10.3f\n", "elapsed", wall / 1E6);
+      fprintf(stderr, "%s: %llu bytes written, %llu calc_phase() calls, %llu kepler() iterations\n",
+              progname, ps->bytes, ps->calc_phase_calls, ps->kepler_calls);
+      return TRUE;
+   }
+
+   if ((fp = fopen(json_name, "w")) == NULL) {
+      fprintf(stderr, E_FOPEN_ERR, progname, json_name);
+      return FALSE;
+   }
+   fprintf(fp, "{\n  \"program\": \"%s\",\n  \"elapsed_ms\": %.3f,\n  \"stages_ms\": {", progname, wall / 1E6);
+   for (i = 0; i < NUM_STAGES; i++) {
+      fprintf(fp, "%s\n    \"%s\": %.3f", i ? "," : "", stage_names[i], ps->ns[i] / 1E6);
+   }
+   fprintf(fp, "\n  },\n  \"bytes_written\": %llu,\n  \"calc_phase_calls\": %llu,\n"
+           "  \"kepler_iterations\": %llu\n}\n", ps->bytes, ps->calc_phase_calls, ps->kepler_calls);
+   if (fclose(fp) != 0) {
+      fprintf(stderr, E_WRITE_ERR, progname, json_name);
+      return FALSE;
+   }
+   return TRUE;
+}
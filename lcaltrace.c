@@ -0,0 +1,328 @@
+/* ---------------------------------------------------------------------------
+
+   lcaltrace.c
+
+   Notes:
+
+      This file contains routines to record a trace of a run of 'lcal', for
+      viewing in Perfetto or Chrome's "about:tracing", when the environment
+      variable LCAL_TRACE names a file to write it to: a span for each
+      stage timed for the statistics (cf. lcalstat.c), for each job (cf.
+      '-J'), and for each layout variant written by a child process (cf.
+      '-V').  This shows where the time went in a run, and which of its
+      processes were busy or idle meanwhile, rather than just the totals.
+
+      The trace is written in the "JSON Array" format of the Trace Event
+      Format.  Each process (the job workers and the layout variants each
+      have their own) is shown as a thread of the run.  It records its
+      events in a buffer of its own, so no locking is needed, and adds them
+      to the file whenever the buffer fills, before it forks, when it
+      exits, and on demand (on SIGUSR1, once the current stage ends); each
+      such addition is a single write to the file, opened for appending.
+      The run itself closes the array when it ends, after its children.
+
+      Unless LCAL_TRACE is set, nothing is recorded (cf. STATS_CLOCK(),
+      STATS_ADD()).
+
+*/
+
+/* ---------------------------------------------------------------------------
+
+   Header Files
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef BUILD_ENV_UNIX
+#include <signal.h>
+#include <unistd.h>
+#include <sys/types.h>
+#endif
+
+/*
+ * Lcal-specific definitions:
+ */
+#include "lcaldefs.h"
+
+/* ---------------------------------------------------------------------------
+
+   Type, Struct, & Enum Declarations
+
+*/
+
+/* an event of the trace */
+typedef struct {
+   char ph;   /* TRACE_SPAN or TRACE_NAME */
+   char *name;   /* (a literal) */
+   double ts, dur;   /* microseconds */
+   char arg[TRACE_ARG_SIZE];   /* (truncated) */
+} trace_event_str_typ;
+
+/* ---------------------------------------------------------------------------
+
+   Constant Declarations
+
+*/
+
+#define TRACE_SPAN	'X'	/* event types ("ph") */
+#define TRACE_NAME	'M'
+
+#define TRACE_CHUNK	(64 * 1024)	/* most written to the file at once */
+#define TRACE_EVENT_MAX	(2 * TRACE_ARG_SIZE + 200)	/* most per event */
+
+/* ---------------------------------------------------------------------------
+
+   Data Declarations (including externals)
+
+*/
+
+int trace_on = FALSE;   /* $LCAL_TRACE */
+
+static FILE *trace_fp = NULL;
+static trace_event_str_typ events[TRACE_EVENTS];   /* not yet written */
+static int num_events = 0;
+static long trace_pid = 0;   /* of the run (its children are its threads) */
+
+#ifdef BUILD_ENV_UNIX
+static volatile sig_atomic_t dump_requested = 0;   /* (cf. SIGUSR1) */
+#endif
+
+/* ---------------------------------------------------------------------------
+
+   this_tid
+
+   Notes:
+
+      This routine returns the thread id of this process in the trace.
+
+*/
+static long this_tid (void)
+{
+#ifdef BUILD_ENV_UNIX
+   return (long) getpid();
+#else
+   return trace_pid;
+#endif
+}
+
+/* ---------------------------------------------------------------------------
+
+   json_copy
+
+   Notes:
+
+      This routine copies the string 'src' to 'dest' (as the contents of a
+      JSON string) and returns a pointer to the terminating NUL.
+
+*/
+static char * json_copy (char *dest, char *src)
+{
+   for (; *src; src++) {
+      if (*src == '"' || *src == '\\') *dest++ = '\\';
+      if ((unsigned char) *src < ' ') *dest++ = ' ';
+      else *dest++ = *src;
+   }
+   *dest = '\0';
+   return dest;
+}
+
+/* ---------------------------------------------------------------------------
+
+   add_event
+
+   Notes:
+
+      This routine adds an event of type 'ph', named 'name' (with argument
+      'arg', if not NULL), to the buffer, writing the buffer out first if
+      it is full.
+
+*/
+static void add_event (int ph, char *name, double ts, double dur, char *arg)
+{
+   trace_event_str_typ *pe;
+
+   if (num_events == TRACE_EVENTS) trace_flush();
+
+   pe = &events[num_events++];
+   pe->ph = (char) ph;
+   pe->name = name;
+   pe->ts = ts;
+   pe->dur = dur;
+   sprintf(pe->arg, "%.*s", TRACE_ARG_SIZE - 1, arg ? arg : "");
+   return;
+}
+
+#ifdef BUILD_ENV_UNIX
+/* ---------------------------------------------------------------------------
+
+   request_dump
+
+   Notes:
+
+      This routine is the handler for SIGUSR1, which asks for the events
+      recorded so far to be written out (cf. trace_span()).
+
+*/
+static void request_dump (int sig GCC_UNUSED)
+{
+   dump_requested = 1;
+   return;
+}
+#endif
+
+/* ---------------------------------------------------------------------------
+
+   trace_begin
+
+   Notes:
+
+      This routine starts the trace of a run, to the file 'name'.  It must
+      be called before any process is forked.  It returns FALSE if the file
+      can't be written.
+
+*/
+int trace_begin (char *name)
+{
+   FILE *fp;
+#ifdef BUILD_ENV_UNIX
+   struct sigaction sa;
+#endif
+
+   /* start the array, then append everything else to it, unbuffered (so
+      each process adds its events to it in one write) */
+   if ((fp = fopen(name, "w")) == NULL || fputs("[\n", fp) == EOF || fclose(fp) != 0 ||
+       (trace_fp = fopen(name, "a")) == NULL) {
+      return FALSE;
+   }
+   setvbuf(trace_fp, NULL, _IONBF, 0);
+
+   trace_on = TRUE;
+   trace_pid = this_tid();
+   trace_thread("main");
+
+#ifdef BUILD_ENV_UNIX
+   memset(&sa, 0, sizeof(sa));
+   sa.sa_handler = request_dump;
+   sa.sa_flags = SA_RESTART;
+   sigemptyset(&sa.sa_mask);
+   (void) sigaction(SIGUSR1, &sa, NULL);
+#endif
+   return TRUE;
+}
+
+/* ---------------------------------------------------------------------------
+
+   trace_thread
+
+   Notes:
+
+      This routine names the thread of this process in the trace: "main",
+      or the kind of child process it is.
+
+*/
+void trace_thread (char *name)
+{
+   if (trace_on) add_event(TRACE_NAME, name, 0.0, 0.0, NULL);
+   return;
+}
+
+/* ---------------------------------------------------------------------------
+
+   trace_span
+
+   Notes:
+
+      This routine records a span named 'name' (with the argument 'arg', if
+      not NULL), from 't0' to 't1' (cf. stats_clock()).  It then writes out
+      the events recorded so far if this was asked for (cf. SIGUSR1).
+
+*/
+void trace_span (char *name, double t0, double t1, char *arg)
+{
+   add_event(TRACE_SPAN, name, t0 / 1E3, (t1 - t0) / 1E3, arg);
+#ifdef BUILD_ENV_UNIX
+   if (dump_requested) {
+      dump_requested = 0;
+      trace_flush();
+   }
+#endif
+   return;
+}
+
+/* ---------------------------------------------------------------------------
+
+   trace_flush
+
+   Notes:
+
+      This routine writes out the events recorded by this process so far.
+      It must be called before forking a process (lest the child write them
+      again), and by a child before it exits.
+
+*/
+void trace_flush (void)
+{
+   static char buf[TRACE_CHUNK];
+   trace_event_str_typ *pe;
+   long tid = this_tid();
+   char *p = buf;
+   int i;
+
+   if (!trace_on) return;
+
+   for (i = 0, pe = events; i < num_events; i++, pe++) {
+      if (pe->ph == TRACE_NAME) {
+         p += sprintf(p, "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":%ld,\"tid\":%ld,"
+                      "\"args\":{\"name\":\"%s\"}},\n", trace_pid, tid, pe->name);
+      }
+      else {
+         p += sprintf(p, "{\"ph\":\"X\",\"name\":\"%s\",\"cat\":\"lcal\",\"pid\":%ld,\"tid\":%ld,"
+                      "\"ts\":%.3f,\"dur\":%.3f", pe->name, trace_pid, tid, pe->ts, pe->dur);
+         if (*pe->arg) {
+            strcpy(p, ",\"args\":{\"arg\":\"");
+            p = json_copy(p + strlen(p), pe->arg);
+            *p++ = '"';
+            *p++ = '}';
+         }
+         p += sprintf(p, "},\n");
+      }
+      if (p - buf > TRACE_CHUNK - TRACE_EVENT_MAX || i == num_events - 1) {
+         (void) fwrite(buf, 1, p - buf, trace_fp);
+         p = buf;
+      }
+   }
+   num_events = 0;
+   return;
+}
+
+/* ---------------------------------------------------------------------------
+
+   trace_end
+
+   Notes:
+
+      This routine ends the trace of the run, once all its child processes
+      are done.  It returns FALSE (after reporting the error) if the trace
+      couldn't be written.
+
+*/
+int trace_end (void)
+{
+   int ok;
+
+   if (!trace_on) return TRUE;
+
+   trace_flush();
+   fprintf(trace_fp, "{\"ph\":\"M\",\"name\":\"process_name\",\"pid\":%ld,\"tid\":%ld,"
+           "\"args\":{\"name\":\"%s\"}}\n]\n", trace_pid, trace_pid, progname);
+   ok = !ferror(trace_fp);
+   if (fclose(trace_fp) != 0) ok = FALSE;
+   trace_fp = NULL;
+   trace_on = FALSE;
+
+   if (!ok) fprintf(stderr, E_WRITE_ERR, progname, getenv(LCAL_TRACE_ENV));
+   return ok;
+}
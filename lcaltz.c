@@ -0,0 +1,551 @@
+/* ---------------------------------------------------------------------------
+
+   lcaltz.c
+
+   Notes:
+
+      This file contains routines to determine the offset from UTC of the
+      local time zone ('-z') for any given day.
+
+      The time zone may be specified either as a fixed number of hours west
+      of UTC (e.g. "5" or "-5.5") or as the name of a zone in the local
+      zoneinfo database (e.g. "Europe/Berlin"), in which case daylight saving
+      time and all other historical changes in the zone's offset are taken
+      into account.
+
+      Zoneinfo ('TZif') files are parsed only once per process.  Each zone is
+      kept in a compact form -- just the transition times and the UTC offsets
+      that take effect at them, plus the POSIX-style rule (from the footer of
+      version 2+ files) which governs times after the last transition -- so
+      that repeated calendars for the same zone cost nothing but a binary
+      search per day.
+
+*/
+
+/* ---------------------------------------------------------------------------
+
+   Header Files
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <string.h>
+
+/*
+ * Lcal-specific definitions:
+ */
+#include "lcaldefs.h"
+
+/* ---------------------------------------------------------------------------
+
+   Type, Struct, & Enum Declarations
+
+*/
+
+/* a POSIX-style daylight saving time transition rule ("Jn", "n", "Mm.w.d") */
+typedef struct {
+   char type;   /* 'J', 'D' (zero-based day), or 'M' */
+   int month, week, day;   /* 'Mm.w.d' (or day number in 'day') */
+   long secs;   /* local time of transition (seconds after midnight) */
+} tz_rule_str_typ;
+
+/* a time zone, in compact form */
+typedef struct tz_zone_str {
+   char *name;   /* name as given to '-z' */
+   int ntrans;   /* number of transitions */
+   long long *trans;   /* transition times (seconds since 1970, UT) */
+   long *offset;   /* UTC offset (seconds east) from each transition on */
+   long first_offset;   /* UTC offset before the first transition */
+   int has_footer;   /* TRUE if rule below applies after last transition */
+   long std_offset;   /* standard UTC offset (seconds east) */
+   long dst_offset;   /* daylight UTC offset (seconds east) */
+   int has_dst;   /* TRUE if zone observes daylight saving time */
+   tz_rule_str_typ dst_start, dst_end;
+   struct tz_zone_str *next;
+} tz_zone_str_typ;
+
+/* ---------------------------------------------------------------------------
+
+   Constant Declarations
+
+*/
+
+#define TZDIR_ENV	"TZDIR"			/* overrides TZDIR_DEFAULT */
+#define TZDIR_DEFAULT	"/usr/share/zoneinfo"
+
+#define TZ_MAGIC	"TZif"
+#define TZ_HDRSIZE	44			/* size of TZif header */
+#define TZ_MAXSIZE	(256 * 1024L)		/* sanity limit on file size */
+
+/* ---------------------------------------------------------------------------
+
+   Macro Definitions
+
+*/
+
+/* big-endian 32- and 64-bit integers in TZif files */
+#define GET32(p)   ((long) (int) (((unsigned long) (p)[0] << 24) | ((p)[1] << 16) | \
+                                  ((p)[2] << 8) | (p)[3]))
+#define GET64(p)   ((long long) (((unsigned long long) GET32(p) << 32) | \
+                                 ((unsigned long long) GET32((p) + 4) & 0xffffffffULL)))
+
+/* ---------------------------------------------------------------------------
+
+   Data Declarations (including externals)
+
+*/
+
+static tz_zone_str_typ *zone_cache = NULL;   /* all zones loaded so far */
+
+/* ---------------------------------------------------------------------------
+
+   days_from_civil
+
+   Notes:
+
+      This routine returns the number of days from 1970-01-01 to the given
+      (proleptic Gregorian) date.
+
+*/
+static long days_from_civil (int year, int month, int day)
+{
+   long era, yoe, doy, doe;
+
+   year -= month <= FEB;
+   era = (year >= 0 ? year : year - 399) / 400;
+   yoe = year - era * 400;
+   doy = (153 * (month + (month > FEB ? -3 : 9)) + 2) / 5 + day - 1;
+   doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+   return era * 146097 + doe - 719468;
+}
+
+/* ---------------------------------------------------------------------------
+
+   parse_offset
+
+   Notes:
+
+      This routine parses a POSIX-style "[+-]hh[:mm[:ss]]" time or offset
+      and returns it in seconds; '*pp' is advanced past it.
+
+*/
+static long parse_offset (char **pp)
+{
+   char *p = *pp;
+   long sign = 1, secs;
+
+   if (*p == '+' || *p == '-') sign = *p++ == '-' ? -1 : 1;
+   secs = 3600 * strtol(p, &p, 10);
+   if (*p == ':') {
+      secs += 60 * strtol(p + 1, &p, 10);
+      if (*p == ':') secs += strtol(p + 1, &p, 10);
+   }
+   *pp = p;
+   return sign * secs;
+}
+
+/* ---------------------------------------------------------------------------
+
+   parse_rule
+
+   Notes:
+
+      This routine parses a POSIX-style ",date[/time]" transition rule into
+      'prule'; '*pp' is advanced past it.  It returns FALSE on a syntax
+      error.
+
+*/
+static int parse_rule (char **pp, tz_rule_str_typ *prule)
+{
+   char *p = *pp;
+
+   if (*p++ != ',') return FALSE;
+
+   if (*p == 'M') {
+      prule->type = 'M';
+      prule->month = (int) strtol(p + 1, &p, 10);
+      if (*p++ != '.') return FALSE;
+      prule->week = (int) strtol(p, &p, 10);
+      if (*p++ != '.') return FALSE;
+      prule->day = (int) strtol(p, &p, 10);
+      if (prule->month < JAN || prule->month > DEC || prule->week < 1 ||
+          prule->week > 5 || prule->day < SUN || prule->day > SAT) return FALSE;
+   }
+   else if (*p == 'J') {
+      prule->type = 'J';
+      prule->day = (int) strtol(p + 1, &p, 10);
+   }
+   else if (isdigit(*p)) {
+      prule->type = 'D';
+      prule->day = (int) strtol(p, &p, 10);
+   }
+   else return FALSE;
+
+   prule->secs = 2 * 3600L;   /* default: 02:00:00 */
+   if (*p == '/') {
+      p++;
+      prule->secs = parse_offset(&p);
+   }
+
+   *pp = p;
+   return TRUE;
+}
+
+/* ---------------------------------------------------------------------------
+
+   skip_name
+
+   Notes:
+
+      This routine skips a POSIX-style time zone abbreviation ("EST" or
+      "<+0530>").  It returns FALSE if there is none.
+
+*/
+static int skip_name (char **pp)
+{
+   char *p = *pp;
+
+   if (*p == '<') {
+      if ((p = strchr(p, '>')) == NULL) return FALSE;
+      p++;
+   }
+   else while (isalpha(*p)) p++;
+
+   if (p == *pp) return FALSE;
+   *pp = p;
+   return TRUE;
+}
+
+/* ---------------------------------------------------------------------------
+
+   parse_posix_tz
+
+   Notes:
+
+      This routine parses a POSIX-style TZ string (e.g.
+      "CET-1CEST,M3.5.0,M10.5.0/3") into the zone 'pz'.  It returns FALSE on
+      a syntax error.
+
+*/
+static int parse_posix_tz (char *tz, tz_zone_str_typ *pz)
+{
+   char *p = tz;
+
+   if (!skip_name(&p)) return FALSE;
+   pz->std_offset = -parse_offset(&p);   /* POSIX offsets are west of UTC */
+   pz->has_dst = FALSE;
+
+   if (*p && skip_name(&p)) {
+      pz->has_dst = TRUE;
+      pz->dst_offset = (*p && *p != ',') ? -parse_offset(&p) : pz->std_offset + 3600;
+
+      if (*p == '\0') {   /* no rule given - use the US rule */
+         p = ",M3.2.0,M11.1.0";
+      }
+      if (!parse_rule(&p, &pz->dst_start) || !parse_rule(&p, &pz->dst_end)) return FALSE;
+   }
+
+   return *p == '\0';
+}
+
+/* ---------------------------------------------------------------------------
+
+   rule_time
+
+   Notes:
+
+      This routine returns the time (seconds since 1970, UT) at which the
+      transition rule 'prule' takes effect in 'year', given the UTC offset
+      'offset' in effect just before it.
+
+*/
+static long long rule_time (tz_rule_str_typ *prule, int year, long offset)
+{
+   long days, wd;
+
+   switch (prule->type) {
+   case 'J':   /* Julian day 1 - 365, never counting February 29 */
+      days = days_from_civil(year, JAN, 1) + prule->day - 1;
+      if (IS_LEAP(year) && prule->day > 59) days++;
+      break;
+
+   case 'D':   /* zero-based day 0 - 365 */
+      days = days_from_civil(year, JAN, 1) + prule->day;
+      break;
+
+   default:   /* day 'd' of week 'w' (5 = last) of month 'm' */
+      days = days_from_civil(year, prule->month, 1);
+      wd = (days % 7 + 11) % 7;   /* 1970-01-01 was a Thursday */
+      days += (prule->day - wd + 7) % 7 + 7 * (prule->week - 1);
+      while (days >= days_from_civil(year, prule->month, 1) + LENGTH_OF(prule->month, year)) {
+         days -= 7;
+      }
+      break;
+   }
+
+   return (long long) days * SECS_PER_DAY + prule->secs - offset;
+}
+
+/* ---------------------------------------------------------------------------
+
+   rule_offset
+
+   Notes:
+
+      This routine returns the UTC offset (seconds east) given by the
+      zone's POSIX-style rule at time 't' (seconds since 1970, UT).
+
+*/
+static long rule_offset (tz_zone_str_typ *pz, long long t)
+{
+   long long start, end;
+   int year;
+
+   if (!pz->has_dst) return pz->std_offset;
+
+   /* year of 't' in local standard time */
+   year = 1970 + (int) ((t + pz->std_offset) / (SECS_PER_DAY * 365.2425));
+   if ((long long) days_from_civil(year, JAN, 1) * SECS_PER_DAY > t + pz->std_offset) year--;
+   else if ((long long) days_from_civil(year + 1, JAN, 1) * SECS_PER_DAY <= t + pz->std_offset) year++;
+
+   start = rule_time(&pz->dst_start, year, pz->std_offset);
+   end = rule_time(&pz->dst_end, year, pz->dst_offset);
+
+   if (start < end) {   /* northern hemisphere */
+      return (t >= start && t < end) ? pz->dst_offset : pz->std_offset;
+   }
+   else {   /* southern hemisphere */
+      return (t >= end && t < start) ? pz->std_offset : pz->dst_offset;
+   }
+}
+
+/* ---------------------------------------------------------------------------
+
+   load_tzfile
+
+   Notes:
+
+      This routine reads the zoneinfo file for the zone 'name' into a newly
+      allocated zone.  It returns NULL if the file can't be read or isn't a
+      valid TZif file.
+
+      For version 2+ files, the 64-bit data block and the POSIX-style TZ
+      footer are used; for version 1 files, the 32-bit data block.
+
+*/
+static tz_zone_str_typ * load_tzfile (char *name)
+{
+   FILE *fp;
+   char path[2 * LINSIZ], *dir, *p;
+   unsigned char *buf, *data, *idx, *types;
+   long size, timecnt, typecnt, charcnt, leapcnt, isstdcnt, isutcnt, len;
+   int tsize, i, ok = FALSE;
+   tz_zone_str_typ *pz = NULL;
+
+   /* look up relative names in the zoneinfo directory */
+   if (*name == END_PATH) strcpy(path, name);
+   else {
+      dir = (p = getenv(TZDIR_ENV)) != NULL && *p ? p : TZDIR_DEFAULT;
+      if (strlen(dir) >= LINSIZ || strlen(name) >= LINSIZ || strstr(name, "..")) return NULL;
+      sprintf(path, "%s%c%s", dir, END_PATH, name);
+   }
+
+   if ((fp = fopen(path, "rb")) == NULL) return NULL;
+   buf = (unsigned char *) malloc(TZ_MAXSIZE);
+   size = buf ? (long) fread(buf, 1, TZ_MAXSIZE, fp) : 0;
+   fclose(fp);
+
+   if (size < TZ_HDRSIZE || memcmp(buf, TZ_MAGIC, 4) != 0) goto done;
+
+   /* skip the version 1 data block if there is a 64-bit one */
+   data = buf;
+   tsize = 4;
+   if (buf[4] >= '2') {
+      data += TZ_HDRSIZE + GET32(buf + 32) * 5 + GET32(buf + 36) * 6 +
+         GET32(buf + 40) + GET32(buf + 28) * 8 + GET32(buf + 24) + GET32(buf + 20);
+      tsize = 8;
+      if (data + TZ_HDRSIZE > buf + size || memcmp(data, TZ_MAGIC, 4) != 0) goto done;
+   }
+
+   isutcnt = GET32(data + 20);
+   isstdcnt = GET32(data + 24);
+   leapcnt = GET32(data + 28);
+   timecnt = GET32(data + 32);
+   typecnt = GET32(data + 36);
+   charcnt = GET32(data + 40);
+
+   len = timecnt * (tsize + 1) + typecnt * 6 + charcnt +
+      leapcnt * (tsize + 4) + isstdcnt + isutcnt;
+   if (typecnt < 1 || timecnt < 0 || data + TZ_HDRSIZE + len > buf + size) goto done;
+
+   if ((pz = (tz_zone_str_typ *) calloc(1, sizeof(tz_zone_str_typ))) == NULL) goto done;
+   pz->ntrans = (int) timecnt;
+   pz->trans = (long long *) malloc((timecnt + 1) * sizeof(long long));
+   pz->offset = (long *) malloc((timecnt + 1) * sizeof(long));
+   pz->name = (char *) malloc(strlen(name) + 1);
+   if (!pz->trans || !pz->offset || !pz->name) goto done;
+   strcpy(pz->name, name);
+
+   data += TZ_HDRSIZE;
+   idx = data + timecnt * tsize;
+   types = idx + timecnt;
+
+   for (i = 0; i < timecnt; i++) {
+      pz->trans[i] = tsize == 8 ? GET64(data + i * 8) : GET32(data + i * 4);
+      if (idx[i] >= typecnt) goto done;
+      pz->offset[i] = GET32(types + idx[i] * 6);
+   }
+   pz->first_offset = GET32(types);   /* type 0 applies before first transition */
+
+   /* the footer (version 2+) gives the rule for times after the last
+      transition */
+   if (tsize == 8) {
+      p = (char *) types + typecnt * 6 + charcnt + leapcnt * 12 + isstdcnt + isutcnt;
+      if (p < (char *) buf + size && *p == '\n') {
+         char *end = memchr(p + 1, '\n', (char *) buf + size - p - 1);
+         if (end && end > p + 1) {
+            *end = '\0';
+            if (!parse_posix_tz(p + 1, pz)) goto done;
+            pz->has_footer = TRUE;
+         }
+      }
+   }
+
+   ok = TRUE;
+
+ done:
+   free(buf);
+   if (!ok && pz) {
+      free(pz->trans);
+      free(pz->offset);
+      free(pz->name);
+      free(pz);
+      pz = NULL;
+   }
+   return pz;
+}
+
+/* ---------------------------------------------------------------------------
+
+   find_zone
+
+   Notes:
+
+      This routine returns the (cached) zone named 'name', loading it from
+      the zoneinfo database if necessary.  It returns NULL if there is no
+      such zone.
+
+*/
+static tz_zone_str_typ * find_zone (char *name)
+{
+   tz_zone_str_typ *pz;
+
+   for (pz = zone_cache; pz; pz = pz->next) {
+      if (strcmp(pz->name, name) == 0) return pz;
+   }
+
+   if ((pz = load_tzfile(name)) != NULL) {
+      pz->next = zone_cache;
+      zone_cache = pz;
+   }
+   return pz;
+}
+
+/* ---------------------------------------------------------------------------
+
+   zone_offset
+
+   Notes:
+
+      This routine returns the UTC offset (seconds east) in effect in zone
+      'pz' at time 't' (seconds since 1970, UT).
+
+*/
+static long zone_offset (tz_zone_str_typ *pz, long long t)
+{
+   int lo, hi, mid;
+
+   if (pz->ntrans == 0 || t < pz->trans[0]) {
+      return pz->has_footer && pz->ntrans == 0 ? rule_offset(pz, t) : pz->first_offset;
+   }
+   if (t >= pz->trans[pz->ntrans - 1] && pz->has_footer) return rule_offset(pz, t);
+
+   /* binary search for the last transition at or before 't' */
+   lo = 0;
+   hi = pz->ntrans - 1;
+   while (lo < hi) {
+      mid = (lo + hi + 1) / 2;
+      if (pz->trans[mid] <= t) lo = mid;
+      else hi = mid - 1;
+   }
+   return pz->offset[lo];
+}
+
+/* ---------------------------------------------------------------------------
+
+   is_zone_name
+
+   Notes:
+
+      This routine returns TRUE if the '-z' value 'zone' is the name of a
+      time zone rather than a numeric offset.  (Anything after a numeric
+      offset, like "5 [New York EST]", is a comment.)
+
+*/
+int is_zone_name (char *zone)
+{
+   return *zone && strchr("+-.0123456789 ", *zone) == NULL;
+}
+
+/* ---------------------------------------------------------------------------
+
+   valid_zone
+
+   Notes:
+
+      This routine returns TRUE if the '-z' value 'zone' is either a numeric
+      offset or the name of a zone which can be loaded.
+
+*/
+int valid_zone (char *zone)
+{
+   return !is_zone_name(zone) || find_zone(zone) != NULL;
+}
+
+/* ---------------------------------------------------------------------------
+
+   utc_offset_days
+
+   Notes:
+
+      This routine returns the difference, in days, between noon UT and
+      noon local time on the given date in the time zone 'zone' (cf. '-z').
+      This is positive west of UTC, as for the numeric form of '-z'.
+
+*/
+double utc_offset_days (char *zone, int month, int day, int year)
+{
+   static char last_zone[STRSIZ] = "";
+   static tz_zone_str_typ *pz = NULL;
+   static double fixed_offset = 0.0;
+   long long noon;
+   long offset;
+
+   /* parse the zone only when it changes */
+   if (strcmp(zone, last_zone) != 0) {
+      pz = is_zone_name(zone) ? find_zone(zone) : NULL;
+      fixed_offset = atof(zone) / 24.0;
+      strcpy(last_zone, zone);
+   }
+
+   if (pz == NULL) return fixed_offset;
+
+   /* find the offset in effect at local noon */
+   noon = (long long) days_from_civil(year, month, day) * SECS_PER_DAY + SECS_PER_DAY / 2;
+   offset = zone_offset(pz, noon);
+   offset = zone_offset(pz, noon - offset);
+
+   return -offset / (double) SECS_PER_DAY;
+}
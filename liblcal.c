@@ -0,0 +1,558 @@
+/* ---------------------------------------------------------------------------
+
+   liblcal.c
+
+   Notes:
+
+      This file contains the C interface of 'liblcal' (cf. liblcal.h), which
+      generates calendars in-process: the PostScript code goes to a sink or
+      buffer supplied by the caller, nothing is written to stdout or any
+      file, and errors are returned as codes rather than reported (and
+      'exit()'ed on).
+
+      The library is built from the same sources as 'lcal' itself, compiled
+      with LCAL_LIBRARY defined to leave out the program's 'main()' and
+      everything only it needs (cf. "make lib").  Given the same options, a
+      calendar generated by the library is identical to one from 'lcal -R',
+      apart from the '%%CreationDate' and user comments if not reproducible.
+
+      Neither the calendar cache nor the phase cache (cf. lcalcache.c) is
+      used.
+
+*/
+
+/* ---------------------------------------------------------------------------
+
+   Header Files
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <math.h>
+
+/*
+ * Lcal-specific definitions:
+ */
+#include "lcaldefs.h"
+#include "liblcal.h"
+
+/* ---------------------------------------------------------------------------
+
+   Type, Struct, & Enum Declarations
+
+*/
+
+/* (opaque to the caller) */
+struct lcal_grid_str {
+   phase_grid_str_typ grid;
+};
+
+/* output buffer for lcal_render_buffer() */
+typedef struct {
+   char *buf;
+   size_t size;
+   size_t len;   /* length of output so far (even if it didn't fit) */
+} out_buf_str_typ;
+
+/* ---------------------------------------------------------------------------
+
+   Data Declarations (including externals)
+
+*/
+
+static char *error_msgs[] = {
+   "success",   /* LCAL_OK */
+   "year or range of months out of range",   /* LCAL_E_YEAR */
+   "unknown time zone",   /* LCAL_E_ZONE */
+   "unknown phase engine",   /* LCAL_E_ENGINE */
+   "invalid option",   /* LCAL_E_OPTION */
+   "out of memory",   /* LCAL_E_NOMEM */
+   "output sink failed",   /* LCAL_E_SINK */
+   "output buffer too small",   /* LCAL_E_SPACE */
+   "month or day out of range",   /* LCAL_E_DATE */
+};
+
+#define NUM_ERRORS	(int) (sizeof(error_msgs) / sizeof(error_msgs[0]))
+
+static int names_set = FALSE;   /* cf. init_names() */
+
+/* ---------------------------------------------------------------------------
+
+   set_string
+
+   Notes:
+
+      This routine copies the option 'value' (or 'dflt' if it is NULL) to
+      'dest' (of size STRSIZ).  It returns FALSE if it is too long.
+
+*/
+static int set_string (char *dest, const char *value, char *dflt)
+{
+   if (value == NULL) value = dflt;
+   if (strlen(value) >= STRSIZ) return FALSE;
+   strcpy(dest, value);
+   return TRUE;
+}
+
+/* ---------------------------------------------------------------------------
+
+   check_months
+
+   Notes:
+
+      This routine returns LCAL_OK if 'nmonths' months from 'month'/'year'
+      are all within the calendar limits, or LCAL_E_YEAR if not.
+
+*/
+static int check_months (int month, int year, int nmonths)
+{
+   if (month < JAN || month > DEC || nmonths < 1 || nmonths > MAX_MONTHS ||
+       year < MIN_YR || year + (month - 1 + nmonths - 1) / 12 > MAX_YR) {
+      return LCAL_E_YEAR;
+   }
+   return LCAL_OK;
+}
+
+/* ---------------------------------------------------------------------------
+
+   check_date
+
+   Notes:
+
+      This routine returns LCAL_OK if 'month'/'day'/'year' is a date within
+      the calendar limits, LCAL_E_YEAR if the year is not, or LCAL_E_DATE
+      if the month or day is not valid.
+
+*/
+static int check_date (int month, int day, int year)
+{
+   if (year < MIN_YR || year > MAX_YR) return LCAL_E_YEAR;
+   if (month < JAN || month > DEC || day < 1 || day > LENGTH_OF(month, year)) return LCAL_E_DATE;
+   return LCAL_OK;
+}
+
+/* ---------------------------------------------------------------------------
+
+   apply_options
+
+   Notes:
+
+      This routine validates the options 'opts' and sets the corresponding
+      'lcal' options (cf. lcal.c, get_args()).  It returns LCAL_OK, or the
+      error code for the first invalid option.
+
+*/
+static int apply_options (const lcal_options_str_typ *opts)
+{
+   char tmp[STRSIZ];
+   int err;
+
+   if (!names_set) {
+      init_names("lcal");
+      names_set = TRUE;
+   }
+
+   if ((err = check_months(opts->month, opts->year, opts->nmonths)) != LCAL_OK) return err;
+   init_month = opts->month;
+   init_year = opts->year;
+   num_months = opts->nmonths;
+
+   if (!set_string(time_zone, opts->time_zone, TIMEZONE)) return LCAL_E_ZONE;
+   if (!valid_zone(time_zone)) return LCAL_E_ZONE;
+
+   if (!set_string(phase_engine, opts->engine, DEFAULT_ENGINE)) return LCAL_E_ENGINE;
+   if (!set_phase_engine(phase_engine)) return LCAL_E_ENGINE;
+
+   if (!set_string(dayfont, opts->day_font, DATEFONT) ||
+       !set_string(titlefont, opts->title_font, TITLEFONT) ||
+       !set_string(x_offset, opts->x_offset, X_OFFSET) ||
+       !set_string(y_offset, opts->y_offset, Y_OFFSET) ||
+       !set_string(tmp, opts->shading, DEFAULT_SHADING)) {
+      return LCAL_E_OPTION;
+   }
+   define_shading(shading, tmp, DEFAULT_SHADING);
+
+   rotate = opts->landscape ? LANDSCAPE : PORTRAIT;
+   odd_days_singlepage = opts->odd_days != 0;
+   compressed_singlepage = opts->compressed != 0 && !odd_days_singlepage;
+   draw_day_of_week_inside_moon = opts->weekdays != 0;
+   reproducible = opts->reproducible != 0;
+   mark_eclipses = opts->eclipses != 0;
+   if (opts->rise_set && (fabs(opts->latitude) > 90.0 || fabs(opts->longitude) > 180.0)) {
+      return LCAL_E_OPTION;
+   }
+   rise_set = opts->rise_set != 0;
+   latitude = opts->latitude;
+   longitude = opts->longitude;
+   moon_sizes = opts->moon_sizes != 0;
+   source_date = NULL;
+
+   /* always calculate the phases directly */
+   use_phase_grid(NULL);
+   use_ephemeris(NULL);
+
+   return LCAL_OK;
+}
+
+/* ---------------------------------------------------------------------------
+
+   buffer_sink
+
+   Notes:
+
+      This routine is the sink used by 'lcal_render_buffer()': it appends
+      the output to the buffer while it fits, and counts it regardless.
+
+*/
+static int buffer_sink (void *ctx, const char *data, size_t len)
+{
+   out_buf_str_typ *pout = (out_buf_str_typ *) ctx;
+
+   if (pout->len + len <= pout->size) memcpy(pout->buf + pout->len, data, len);
+   pout->len += len;
+   return 0;
+}
+
+/* ---------------------------------------------------------------------------
+
+   lcal_init_options
+
+   Notes:
+
+      This routine fills in 'opts' with the default options, i.e. those of
+      'lcal' with no flags: January through December of the current year,
+      in the default time zone, engine, and layout.
+
+*/
+void lcal_init_options (lcal_options_str_typ *opts)
+{
+   time_t curr_tyme;
+
+   time(&curr_tyme);
+   memset(opts, 0, sizeof(*opts));
+   opts->year = CENTURY + localtime(&curr_tyme)->tm_year;
+   opts->month = JAN;
+   opts->nmonths = NUM_MONTHS;
+   opts->landscape = ROTATE == LANDSCAPE;
+   opts->weekdays = WEEKDAYS;
+   return;
+}
+
+/* ---------------------------------------------------------------------------
+
+   lcal_render
+
+   Notes:
+
+      This routine generates the calendar for the options 'opts', passing
+      the PostScript code to 'sink' (with 'ctx' as its 1st parameter) a
+      piece at a time.  If the sink returns nonzero, nothing more is passed
+      to it.
+
+      It returns LCAL_OK if the whole calendar was passed to the sink, and
+      otherwise an error code (cf. lcal_strerror()).
+
+*/
+int lcal_render (const lcal_options_str_typ *opts, lcal_sink_typ sink, void *ctx)
+{
+   phase_table_str_typ *tbl;
+   int err;
+
+   if ((err = apply_options(opts)) != LCAL_OK) return err;
+
+   if ((tbl = (phase_table_str_typ *) malloc(sizeof(*tbl))) == NULL) return LCAL_E_NOMEM;
+   calc_phase_table(tbl, init_month, init_year, num_months);
+
+   set_ps_sink(sink, ctx);
+   write_psfile(tbl);
+   err = ps_sink_error() ? LCAL_E_SINK : LCAL_OK;
+   set_ps_sink(NULL, NULL);
+
+   free(tbl);
+   return err;
+}
+
+/* ---------------------------------------------------------------------------
+
+   lcal_render_buffer
+
+   Notes:
+
+      This routine generates the calendar for the options 'opts' into 'buf'
+      (of 'size' bytes), NUL-terminated if there is room, and stores its
+      length in '*plen' (if 'plen' is not NULL).
+
+      If the buffer is too small, it returns LCAL_E_SPACE, and '*plen' is
+      the size needed (without the NUL).
+
+*/
+int lcal_render_buffer (const lcal_options_str_typ *opts, char *buf, size_t size, size_t *plen)
+{
+   out_buf_str_typ out;
+   int err;
+
+   out.buf = buf;
+   out.size = size;
+   out.len = 0;
+
+   err = lcal_render(opts, buffer_sink, &out);
+
+   if (plen) *plen = out.len;
+   if (err != LCAL_OK) return err;
+   if (out.len > size) return LCAL_E_SPACE;
+   if (out.len < size) buf[out.len] = '\0';
+   return LCAL_OK;
+}
+
+/* ---------------------------------------------------------------------------
+
+   lcal_phase_table
+
+   Notes:
+
+      This routine fills in 'phase[day-1][i]' with the phase of the moon
+      (0.0 = new, 0.5 = full) on each day of the 'i'th month of the calendar
+      for the options 'opts' (only the year, months, time zone, and engine
+      matter), or -1 for days which don't exist (e.g. February 30).
+
+      It returns LCAL_OK, or an error code if the options are invalid.
+
+*/
+int lcal_phase_table (const lcal_options_str_typ *opts, double phase[31][LCAL_MAX_MONTHS])
+{
+   phase_table_str_typ *tbl;
+   int err, day, i;
+
+   if ((err = apply_options(opts)) != LCAL_OK) return err;
+
+   if ((tbl = (phase_table_str_typ *) malloc(sizeof(*tbl))) == NULL) return LCAL_E_NOMEM;
+   calc_phase_table(tbl, init_month, init_year, num_months);
+
+   for (day = 0; day < 31; day++) {
+      for (i = 0; i < LCAL_MAX_MONTHS; i++) {
+         phase[day][i] = i < num_months ? tbl->phase[day][i] : -1.0;
+      }
+   }
+
+   free(tbl);
+   return LCAL_OK;
+}
+
+/* ---------------------------------------------------------------------------
+
+   lcal_distance_table
+
+   Notes:
+
+      This routine fills in 'dist[day-1][i]' with the distance of the moon
+      from the centre of the Earth (km), and 'diam[day-1][i]' with its
+      apparent diameter (degrees), on each day of the 'i'th month of the
+      calendar for the options 'opts' (as for 'lcal_phase_table()'), or -1
+      for days which don't exist.  The distances are calculated along with
+      the phases, in a single pass.
+
+      It returns LCAL_OK, or an error code if the options are invalid.
+
+*/
+int lcal_distance_table (const lcal_options_str_typ *opts, double dist[31][LCAL_MAX_MONTHS],
+                         double diam[31][LCAL_MAX_MONTHS])
+{
+   phase_table_str_typ *tbl;
+   int err, day, i;
+
+   if ((err = apply_options(opts)) != LCAL_OK) return err;
+
+   if ((tbl = (phase_table_str_typ *) malloc(sizeof(*tbl))) == NULL) return LCAL_E_NOMEM;
+   moon_sizes = TRUE;
+   calc_phase_table(tbl, init_month, init_year, num_months);
+
+   for (day = 0; day < 31; day++) {
+      for (i = 0; i < LCAL_MAX_MONTHS; i++) {
+         dist[day][i] = i < num_months ? tbl->dist[day][i] : -1.0;
+         diam[day][i] = dist[day][i] > 0.0 ? moon_diameter(dist[day][i]) : -1.0;
+      }
+   }
+
+   free(tbl);
+   return LCAL_OK;
+}
+
+/* ---------------------------------------------------------------------------
+
+   lcal_grid_new
+
+   Notes:
+
+      This routine calculates a grid of moon phases, by the phase engine
+      'engine' (NULL for the default), covering 'nmonths' months from
+      'month'/'year' (cf. moonphas.c, calc_phase_grid()), from which
+      'lcal_grid_phase()' interpolates the phase at any instant.
+
+      It returns the grid (to be freed by 'lcal_grid_free()'), or NULL with
+      an error code in '*perr' (if 'perr' is not NULL).
+
+*/
+lcal_grid_typ * lcal_grid_new (int month, int year, int nmonths, const char *engine, int *perr)
+{
+   lcal_grid_typ *pg;
+   int err;
+
+   if ((err = check_months(month, year, nmonths)) == LCAL_OK) {
+      if (!set_string(phase_engine, engine, DEFAULT_ENGINE) || !set_phase_engine(phase_engine)) {
+         err = LCAL_E_ENGINE;
+      }
+   }
+   if (err == LCAL_OK) {
+      use_ephemeris(NULL);
+      if ((pg = (lcal_grid_typ *) malloc(sizeof(*pg))) != NULL &&
+          calc_phase_grid(&pg->grid, month, year, nmonths)) {
+         if (perr) *perr = LCAL_OK;
+         return pg;
+      }
+      free(pg);
+      err = LCAL_E_NOMEM;
+   }
+
+   if (perr) *perr = err;
+   return NULL;
+}
+
+/* ---------------------------------------------------------------------------
+
+   lcal_grid_phase
+
+   Notes:
+
+      This routine returns the phase of the moon (0.0 = new, 0.5 = full) at
+      the Julian date (UT) 'jd', interpolated from 'grid', or -1 if 'jd' is
+      not covered by it.
+
+*/
+double lcal_grid_phase (const lcal_grid_typ *grid, double jd)
+{
+   return grid_phase((phase_grid_str_typ *) &grid->grid, jd);
+}
+
+/* ---------------------------------------------------------------------------
+
+   lcal_grid_free
+
+   Notes:
+
+      This routine frees 'grid' (cf. lcal_grid_new()).
+
+*/
+void lcal_grid_free (lcal_grid_typ *grid)
+{
+   if (grid) {
+      free(grid->grid.age);
+      free(grid);
+   }
+   return;
+}
+
+/* ---------------------------------------------------------------------------
+
+   lcal_eclipses
+
+   Notes:
+
+      This routine finds the eclipses of the sun and moon whose greatest
+      eclipse falls from Julian date 'jd0' up to (not including) 'jd1', UT
+      (cf. lcalecl.c), and stores the first 'max' of them, in order, in
+      'ecl'.
+
+      It returns the number stored.
+
+*/
+int lcal_eclipses (double jd0, double jd1, lcal_eclipse_str_typ *ecl, int max)
+{
+   eclipse_str_typ found[MAX_ECLIPSES];
+   int n, i, total = 0;
+
+   /* (a year at a time, which has fewer than MAX_ECLIPSES) */
+   for (; jd0 < jd1 && total < max; jd0 += 366.0) {
+      n = find_eclipses(jd0, jd0 + 366.0 < jd1 ? jd0 + 366.0 : jd1, found, MAX_ECLIPSES);
+      for (i = 0; i < n && total < max; i++, total++) {
+         ecl[total].jd = found[i].jd;
+         ecl[total].type = found[i].type;
+         ecl[total].gamma = found[i].gamma;
+         ecl[total].magnitude = found[i].mag;
+      }
+   }
+   return total;
+}
+
+/* ---------------------------------------------------------------------------
+
+   lcal_eclipse_name
+
+   Notes:
+
+      This routine returns the name of the type of eclipse 'type' (e.g.
+      "total solar").
+
+*/
+const char * lcal_eclipse_name (int type)
+{
+   return type >= LCAL_ECL_PENUMBRAL && type <= LCAL_ECL_TOTAL_SOLAR ? eclipse_name(type) : "none";
+}
+
+/* ---------------------------------------------------------------------------
+
+   lcal_weekday
+
+   Notes:
+
+      This routine stores the day of the week (0 = Sunday .. 6 = Saturday)
+      of 'month'/'day'/'year' in '*pweekday'.
+
+      It returns LCAL_OK, or an error code if the date is invalid.
+
+*/
+int lcal_weekday (int month, int day, int year, int *pweekday)
+{
+   int err;
+
+   if ((err = check_date(month, day, year)) != LCAL_OK) return err;
+   *pweekday = (int) ((jdn(month, day, year) + 1) % 7);
+   return LCAL_OK;
+}
+
+/* ---------------------------------------------------------------------------
+
+   lcal_julian_day
+
+   Notes:
+
+      This routine stores the Julian day number (i.e. the Julian date at
+      noon UT) of 'month'/'day'/'year' in '*pjdn'.
+
+      It returns LCAL_OK, or an error code if the date is invalid.
+
+*/
+int lcal_julian_day (int month, int day, int year, long *pjdn)
+{
+   int err;
+
+   if ((err = check_date(month, day, year)) != LCAL_OK) return err;
+   *pjdn = jdn(month, day, year);
+   return LCAL_OK;
+}
+
+/* ---------------------------------------------------------------------------
+
+   lcal_strerror
+
+   Notes:
+
+      This routine returns a description of the error code 'err'.
+
+*/
+const char * lcal_strerror (int err)
+{
+   return err >= 0 && err < NUM_ERRORS ? error_msgs[err] : "unknown error";
+}
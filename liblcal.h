@@ -0,0 +1,142 @@
+/* ---------------------------------------------------------------------------
+
+   liblcal.h
+
+   Notes:
+
+      This file contains the public interface of 'liblcal' (cf. liblcal.c),
+      the library version of 'lcal' for programs which generate calendars
+      in-process.  It is self-contained: programs using the library need
+      only this file, and 'liblcal.a' or 'liblcal.so' (cf. "make lib").
+
+      The library keeps its state in static variables, per process -- the
+      options, and the sink the PostScript code goes to, among others -- so
+      calls must not be made from more than one thread at a time.  (Only the
+      number formatting inside it, cf. lcalfmt.c, is thread-safe.)
+
+*/
+
+#ifndef LIBLCAL_H
+#define LIBLCAL_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* ---------------------------------------------------------------------------
+
+   Constant Declarations
+
+*/
+
+/* error codes returned by the library (cf. lcal_strerror()) */
+#define LCAL_OK		0	/* success */
+#define LCAL_E_YEAR	1	/* year or range of months out of range */
+#define LCAL_E_ZONE	2	/* unknown time zone */
+#define LCAL_E_ENGINE	3	/* unknown phase engine */
+#define LCAL_E_OPTION	4	/* other option invalid (or too long) */
+#define LCAL_E_NOMEM	5	/* out of memory */
+#define LCAL_E_SINK	6	/* the output sink failed */
+#define LCAL_E_SPACE	7	/* the output buffer is too small */
+#define LCAL_E_DATE	8	/* month or day out of range */
+
+#define LCAL_MAX_MONTHS	13	/* most months in one calendar */
+
+/* types of eclipse (cf. lcal_eclipses()) */
+#define LCAL_ECL_PENUMBRAL	1	/* lunar */
+#define LCAL_ECL_PARTIAL_LUNAR	2
+#define LCAL_ECL_TOTAL_LUNAR	3
+#define LCAL_ECL_PARTIAL_SOLAR	4	/* solar */
+#define LCAL_ECL_ANNULAR	5
+#define LCAL_ECL_HYBRID	6
+#define LCAL_ECL_TOTAL_SOLAR	7
+
+/* ---------------------------------------------------------------------------
+
+   Type, Struct, & Enum Declarations
+
+*/
+
+/*
+ * Options for a calendar: the equivalents of the 'lcal' command-line flags
+ * (noted below).  Call lcal_init_options() for the defaults, then change
+ * what is needed; NULL strings also select the defaults.
+ */
+typedef struct {
+   int year;   /* first year (default: current) */
+   int month;   /* first month (1 .. 12, default 1) */
+   int nmonths;   /* number of months (1 .. LCAL_MAX_MONTHS, default 12) */
+   const char *time_zone;   /* -z (a single zone) */
+   const char *engine;   /* -P */
+   const char *day_font;   /* -d */
+   const char *title_font;   /* -t */
+   const char *shading;   /* -s */
+   const char *x_offset;   /* -X */
+   const char *y_offset;   /* -Y */
+   int landscape;   /* -l (nonzero) or -p (zero) */
+   int compressed;   /* -S */
+   int odd_days;   /* -O (overrides 'compressed') */
+   int weekdays;   /* -W (weekday names inside moons) */
+   int reproducible;   /* -R (omit timestamp and user name) */
+   int eclipses;   /* -e (mark eclipses) */
+   int rise_set;   /* -g (moonrise/moonset at 'latitude', 'longitude') */
+   double latitude, longitude;   /* (degrees, north and east positive) */
+   int moon_sizes;   /* -m (moons to scale, perigee full moons ringed) */
+} lcal_options_str_typ;
+
+/*
+ * Sink for the PostScript code: called with each piece of it in turn, and
+ * returns nonzero to abandon the calendar
+ */
+typedef int (*lcal_sink_typ)(void *ctx, const char *data, size_t len);
+
+/*
+ * Grid of moon phases, for interpolating the phase at any instant (cf.
+ * lcal_grid_new())
+ */
+typedef struct lcal_grid_str lcal_grid_typ;
+
+/*
+ * An eclipse of the sun or moon (cf. lcal_eclipses())
+ */
+typedef struct {
+   double jd;   /* Julian date of greatest eclipse (UT) */
+   int type;   /* LCAL_ECL_... */
+   double gamma;   /* least distance of the shadow's axis (Earth radii) */
+   double magnitude;   /* (umbral, or penumbral; -1 if solar and not partial) */
+} lcal_eclipse_str_typ;
+
+/* ---------------------------------------------------------------------------
+
+   Function Prototypes
+
+*/
+
+void lcal_init_options (lcal_options_str_typ *opts);
+
+int lcal_render (const lcal_options_str_typ *opts, lcal_sink_typ sink, void *ctx);
+int lcal_render_buffer (const lcal_options_str_typ *opts, char *buf, size_t size, size_t *plen);
+
+int lcal_phase_table (const lcal_options_str_typ *opts, double phase[31][LCAL_MAX_MONTHS]);
+int lcal_distance_table (const lcal_options_str_typ *opts, double dist[31][LCAL_MAX_MONTHS],
+                         double diam[31][LCAL_MAX_MONTHS]);
+
+lcal_grid_typ * lcal_grid_new (int month, int year, int nmonths, const char *engine, int *perr);
+double lcal_grid_phase (const lcal_grid_typ *grid, double jd);
+void lcal_grid_free (lcal_grid_typ *grid);
+
+int lcal_eclipses (double jd0, double jd1, lcal_eclipse_str_typ *ecl, int max);
+const char * lcal_eclipse_name (int type);
+
+int lcal_weekday (int month, int day, int year, int *pweekday);
+int lcal_julian_day (int month, int day, int year, long *pjdn);
+
+const char * lcal_strerror (int err);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif   /* LIBLCAL_H */
@@ -0,0 +1,208 @@
+/* ---------------------------------------------------------------------------
+
+   mkyeartbl.c
+
+   Notes:
+
+      This program generates the header file of year descriptors (cf.
+      lcaldate.c) for the years MIN_YR .. MAX_YR: the Julian day number of
+      January 1, and the weekday on which each month starts.  It is run as part of the build:
+
+         mkyeartbl yeartbl.h
+
+      The table is built by simply counting days from a known Julian day
+      number.  Before it is written, every day of every year is checked
+      against the calculations it replaces -- the floating-point 'julday()'
+      (cf. moonphas.c), 'calc_weekday()' (cf. lcal.c) -- and against the
+      integer Julian day number formula used by 'jdn()' outside the table
+      (cf. lcaldate.c).  Any disagreement is reported and no table is
+      written, so the build fails.
+
+*/
+
+/* ---------------------------------------------------------------------------
+
+   Header Files
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+/*
+ * Lcal-specific definitions:
+ */
+#include "lcaldefs.h"
+
+/* ---------------------------------------------------------------------------
+
+   Constant Declarations
+
+*/
+
+#define JDN_MIN_YR	2361331L	/* Julian day number of 1753-01-01 */
+
+#define sgn(x) (((x) < 0) ? -1 : ((x) > 0 ? 1 : 0))   /* extract sign */
+#ifndef abs
+#define abs(x) ((x) < 0 ? (-(x)) : (x))   /* absolute val */
+#endif
+#define FNITG(x) (sgn (x) * floor (abs (x)))
+
+/* ---------------------------------------------------------------------------
+
+   Data Declarations (including externals)
+
+*/
+
+/* lengths and offsets of months in common year (as in lcal.c) */
+char month_len[12] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+short month_off[12] = {0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334};
+
+/* ---------------------------------------------------------------------------
+
+   julday
+
+   Notes:
+
+      This routine is a copy of 'julday()' (cf. moonphas.c), as it was
+      before it was replaced by 'jdn()'.
+
+*/
+static double julday (int month, int day, int year)
+{
+   int mn1, yr1;
+   double a, b, c, d, djd;
+
+   mn1 = month;
+   yr1 = year;
+   if ( yr1 < 0 ) yr1 = yr1 + 1;
+   if ( month < 3 ) {
+      mn1 = month + 12;
+      yr1 = yr1 - 1;
+   }
+   if (( year < 1582 ) ||
+       ( year == 1582  && month < 10 ) ||
+       ( year == 1582  && month == 10 && day < 15.0 )) {
+      b = 0;
+   }
+   else {
+      a = floor (yr1 / 100.0);
+      b = 2 - a + floor (a / 4);
+   }
+   if ( yr1 >= 0 ) c = floor (365.25 * yr1) - 694025;
+   else c = FNITG ((365.25 * yr1) - 0.75) - 694025;
+
+   d = floor (30.6001 * (mn1 + 1));
+   djd = b + c + d + day + 2415020.0;
+   return djd;
+}
+
+/* ---------------------------------------------------------------------------
+
+   old_weekday
+
+   Notes:
+
+      This routine is a copy of 'calc_weekday()' (cf. lcal.c), as it was
+      before the table of year descriptors.
+
+*/
+static int old_weekday (int mm, int dd, int yy)
+{
+   return (yy + (yy-1)/4 - (yy-1)/100 + (yy-1)/400 + OFFSET_OF(mm, yy) + (dd-1)) % 7;
+}
+
+/* ---------------------------------------------------------------------------
+
+   jdn_formula
+
+   Notes:
+
+      This routine is a copy of the integer formula in 'jdn()' (cf.
+      lcaldate.c).
+
+*/
+static long jdn_formula (int month, int day, int year)
+{
+   long a = (14 - month) / 12, y = year + 4800L - a, m = month + 12 * a - 3;
+
+   if (year < 1582 || (year == 1582 && (month < 10 || (month == 10 && day < 15)))) {
+      return day + (153 * m + 2) / 5 + 365 * y + y / 4 - 32083;
+   }
+   return day + (153 * m + 2) / 5 + 365 * y + y / 4 - y / 100 + y / 400 - 32045;
+}
+
+/* ---------------------------------------------------------------------------
+
+   main
+
+   Notes:
+
+      Main program - build and check the table of year descriptors, and
+      write it to the file named on the command line.
+
+*/
+int main (int argc, char **argv)
+{
+   static year_desc_str_typ tbl[MAX_YR - MIN_YR + 1];
+   year_desc_str_typ *py;
+   long day_num = JDN_MIN_YR;
+   int year, month, day, errors = 0;
+   FILE *fp;
+
+   if (argc != 2) {
+      fprintf(stderr, "Usage: %s <FILE>\n", argv[0]);
+      exit(EXIT_FAILURE);
+   }
+
+   for (year = MIN_YR; year <= MAX_YR; year++) {
+      py = &tbl[year - MIN_YR];
+      py->jdn = day_num;
+
+      for (month = JAN; month <= DEC; month++) {
+         py->startday[month - JAN] = (char) ((day_num + 1) % 7);
+
+         for (day = 1; day <= LENGTH_OF(month, year); day++, day_num++) {
+            if (julday(month, day, year) != (double) day_num ||
+                jdn_formula(month, day, year) != day_num ||
+                old_weekday(month, day, year) != (day_num + 1) % 7) {
+               if (errors++ < 10) {
+                  fprintf(stderr, "%s: mismatch on %04d-%02d-%02d (JDN %ld)\n",
+                          argv[0], year, month, day, day_num);
+               }
+            }
+         }
+      }
+   }
+
+   if (errors) {
+      fprintf(stderr, "%s: %d mismatches - no table written\n", argv[0], errors);
+      exit(EXIT_FAILURE);
+   }
+
+   if ((fp = fopen(argv[1], "w")) == NULL) {
+      fprintf(stderr, "%s: can't open file %s\n", argv[0], argv[1]);
+      exit(EXIT_FAILURE);
+   }
+
+   fprintf(fp, "/* year descriptors for %d .. %d - generated by mkyeartbl.c; do not edit */\n\n",
+           MIN_YR, MAX_YR);
+   fprintf(fp, "static const year_desc_str_typ year_tbl[] = {\n");
+   for (year = MIN_YR; year <= MAX_YR; year++) {
+      py = &tbl[year - MIN_YR];
+      fprintf(fp, "   { %ldL, {", py->jdn);
+      for (month = 0; month < 12; month++) {
+         fprintf(fp, "%s%d", month ? "," : "", py->startday[month]);
+      }
+      fprintf(fp, "} },   /* %d */\n", year);
+   }
+   fprintf(fp, "};\n");
+
+   if (fclose(fp) != 0) {
+      fprintf(stderr, "%s: can't write file %s\n", argv[0], argv[1]);
+      exit(EXIT_FAILURE);
+   }
+
+   exit(EXIT_SUCCESS);
+}
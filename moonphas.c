@@ -0,0 +1,734 @@
+/* ---------------------------------------------------------------------------
+
+   moonphas.c
+   
+   Notes:
+
+      This file contains routines to calculate the phase of the moon, either
+      for a given calendar date (noon, local time) or for an arbitrary
+      instant.
+
+      The moon's age is calculated by one of several engines (cf. '-P'),
+      trading accuracy for speed:
+
+         fast       the moontool model below, in single precision and with
+                    a series for the equation of the centre instead of
+                    solving Kepler's equation - straight-line code that
+                    vectorizes.  Within 2E-4 degrees of 'moontool'; about
+                    0.14 microseconds per call.
+
+         moontool   the default: John Walker's model, with the 6 largest
+                    periodic terms of the moon's longitude.  Within 0.4
+                    degrees (under an hour in the time of a given phase) of
+                    'meeus'; about 0.43 microseconds per call.
+
+         meeus      the truncated ELP-2000/82 theory (cf. lcalmeeus.c),
+                    with Delta-T.  Good to about 0.01 degrees; about 2.7
+                    microseconds per call.
+
+      These routines were originally part of 'lcal.c'.
+
+*/
+
+/* ---------------------------------------------------------------------------
+
+   Header Files
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+/*
+ * Lcal-specific definitions:
+ */
+#include "lcaldefs.h"
+
+/* ---------------------------------------------------------------------------
+
+   The following suite of routines ('kepler()' and 'calc_phase()', with
+   'jdn()' from lcaldate.c in place of the former 'julday()') are used to
+   calculate the phase of the moon for a given month, day, year.  They
+   compute the phase of the moon for noon (UT) on the day requested, the
+   start of the Julian day.
+ 
+   Revision history:
+ 
+ 	1.2	AWR	01/25/00	fix calculation of default year
+ 
+ 	1.0	AWR	01/26/92	from Pcal v4.4
+
+   -------------------------------------------------------
+
+   Routines to accurately calculate the phase of the moon
+ 
+   Originally adapted from "moontool.c" by John Walker, Release 2.0.
+ 
+       This routine (calc_phase) and its support routines were adapted from
+       phase.c (v 1.2 88/08/26 22:29:42 jef) in the program "xphoon" (v 1.9
+       88/08/26 22:29:47 jef) by Jef Poskanzer and Craig Leres.  The necessary
+       notice follows...
+ 
+       Copyright (C) 1988 by Jef Poskanzer and Craig Leres.
+ 
+       Permission to use, copy, modify, and distribute this software and its
+       documentation for any purpose and without fee is hereby granted,
+       provided that the above copyright notice appear in all copies and that
+       both that copyright notice and this permission notice appear in
+       supporting documentation.  This software is provided "as is" without
+       express or implied warranty.
+ 
+       These were added to "pcal" by RLD on 19-MAR-1991
+ 
+*/
+
+/*  Astronomical constants. */
+
+#define epoch   2444238.5   /* 1980 January 0.0 */
+
+/*  Constants defining the Sun's apparent orbit. */
+
+#define elonge   278.833540   /* ecliptic longitude of the Sun at epoch 1980.0 */
+#define elongp   282.596403   /* ecliptic longitude of the Sun at perigee */
+#define eccent   0.016718   /* eccentricity of Earth's orbit */
+
+/*  Elements of the Moon's orbit, epoch 1980.0. */
+
+#define mmlong   64.975464   /* moon's mean lonigitude at the epoch */
+#define mmlongp   349.383063   /* mean longitude of the perigee at the
+                                        epoch */
+#define mlnode   151.950429   /* mean longitude of the node at the epoch */
+#define synmonth   29.53058868   /* synodic month (new Moon to new Moon) */
+
+/*  Properties of the Moon's orbit (cf. moontool_age()). */
+
+#define msmax   MOON_MEAN_DIST   /* semi-major axis of Moon's orbit in km */
+#define mecc   0.054900   /* eccentricity of the Moon's orbit */
+#define mangsiz   0.5181   /* moon's angular size at distance a
+                                        from Earth */
+
+
+/*  Handy mathematical functions. */
+
+#define sgn(x) (((x) < 0) ? -1 : ((x) > 0 ? 1 : 0))   /* extract sign */
+#ifndef abs
+#define abs(x) ((x) < 0 ? (-(x)) : (x))   /* absolute val */
+#endif
+#define fixangle(a) ((a) - 360.0 * (floor((a) / 360.0)))  /* fix angle */
+#define torad(d) ((d) * (M_PI / 180.0))   /* deg->rad */
+#define todeg(d) ((d) * (180.0 / M_PI))   /* rad->deg */
+#define dsin(x) (sin(torad((x))))   /* sin from deg */
+#define dcos(x) (cos(torad((x))))   /* cos from deg */
+
+/* grid of moon ages in use by calc_phase() (cf. use_phase_grid()) */
+static phase_grid_str_typ *active_grid = NULL;
+
+/* ephemeris in use instead of moon_age() (cf. use_ephemeris()) */
+static ephemeris_str_typ *active_eph = NULL;
+
+static double fast_age (double pdate);
+
+/* phase engines (cf. set_phase_engine()) - the first is the default */
+static phase_engine_str_typ engines[] = {
+   { "moontool", moon_age },
+   { "fast", fast_age },
+   { "meeus", meeus_age },
+   { NULL, NULL }   /* must be last */
+};
+
+static phase_engine_str_typ *active_engine = engines;
+
+/* calls to calc_phase() and kepler() (cf. lcalstat.c) */
+unsigned long long calc_phase_count = 0, kepler_count = 0;
+
+/* ---------------------------------------------------------------------------
+
+   kepler_loop
+
+   Notes:
+
+      This routine solves the equation of Kepler by Newton's method, iterating
+      until the correction is within EPSILON.
+
+      This utility routine was borrowed from 'pcal' (as 'kepler()').  It is
+      now only used to check 'kepler()' when compiled with KEPLER_STATS.
+
+*/
+#ifdef KEPLER_STATS
+#define EPSILON 1E-6
+#define KEPLER_MAX_ITER	16	/* histogram size */
+
+static long kepler_calls = 0;
+static long kepler_iter[KEPLER_MAX_ITER + 1];   /* iterations -> calls */
+static double kepler_max_err = 0.0;
+
+static double kepler_loop (double m, double ecc, int *niter)
+{
+   double e, delta;
+   
+   e = m = torad(m);
+   *niter = 0;
+   do {
+      delta = e - ecc * sin(e) - m;
+      e -= delta / (1 - ecc * cos(e));
+      ++*niter;
+   } while (abs(delta) > EPSILON);
+   return e;
+}
+
+/* ---------------------------------------------------------------------------
+
+   kepler_report
+
+   Notes:
+
+      This routine writes the distribution of the number of iterations which
+      'kepler_loop()' needed, and the greatest difference between its
+      results and those of 'kepler()', to stderr (at exit).
+
+*/
+static void kepler_report (void)
+{
+   int i;
+
+   fprintf(stderr, "kepler: %ld calls; loop iterations:", kepler_calls);
+   for (i = 1; i <= KEPLER_MAX_ITER; i++) {
+      if (kepler_iter[i]) fprintf(stderr, " %d: %ld", i, kepler_iter[i]);
+   }
+   fprintf(stderr, "; max difference %.3g rad\n", kepler_max_err);
+   return;
+}
+#endif
+
+/* ---------------------------------------------------------------------------
+
+   kepler
+
+   Notes:
+
+      This routine solves the equation of Kepler, returning the eccentric
+      anomaly (in radians) for the mean anomaly 'm' (in degrees) and
+      eccentricity 'ecc'.
+
+      Rather than iterating until convergence, it starts from the series
+      E = M + e sin M (1 + e cos M), whose error is of order e^3, and applies
+      a single Newton step, which squares it.  For the Earth's orbit that is
+      within 1E-13 radians, with no loop or branch -- more accurate than the
+      old Newton loop (cf. 'kepler_loop()'), which needed 2 or 3 iterations
+      to converge to EPSILON, and friendlier to vectorization.
+
+*/
+double kepler (double m, double ecc)
+{
+   double e;
+#ifdef KEPLER_STATS
+   double e_loop, err;
+   int niter;
+   
+   if (kepler_calls++ == 0) atexit(kepler_report);
+   e_loop = kepler_loop(m, ecc, &niter);
+   kepler_iter[niter < KEPLER_MAX_ITER ? niter : KEPLER_MAX_ITER]++;
+#endif
+   
+   STATS_COUNT(kepler_count);
+   m = torad(m);
+   e = m + ecc * sin(m) * (1 + ecc * cos(m));
+   e -= (e - ecc * sin(e) - m) / (1 - ecc * cos(e));
+
+#ifdef KEPLER_STATS
+   if ((err = abs(e - e_loop)) > kepler_max_err) kepler_max_err = err;
+#endif
+   return e;
+}
+
+/* ---------------------------------------------------------------------------
+
+   moontool_age
+
+   Notes:
+
+      This routine calculates the age of the moon, in degrees (i.e. the
+      difference between the Moon's and the Sun's true longitudes, not
+      normalized to 0 -> 360), at the Julian date 'pdate'; and, if 'pdist'
+      is not NULL, the distance of the moon from the centre of the Earth
+      (in km) into '*pdist', from the anomaly and equation of the centre
+      already at hand.  The distance is good to about 300 km (rms; 750 at
+      worst) -- enough to tell a full moon near perigee.
+
+      It is the computational core of 'calc_phase()' and 'calc_moon_info()',
+      and is also what the Chebyshev ephemeris approximates (cf. lcaleph.c).
+
+      Converted from the subroutine phase.c used by "xphoon.c" (see above
+      disclaimer) into calc_phase() for use in "moonphas.c" by Rick Dyson
+      18-MAR-1991
+      
+*/
+static double moontool_age (double pdate, double *pdist)
+{
+   double Day, N, M, Ec, Lambdasun, ml, MM;
+   double Ev, Ae, A3, MmP, mEc, A4, lP, V, lPP;
+   
+   /*  Calculation of the Sun's position. */
+
+   Day = pdate - epoch;   /* date within epoch */
+   N = fixangle((360 / 365.2422) * Day);   /* mean anomaly of the Sun */
+   M = fixangle(N + elonge - elongp);      /* convert from perigee
+                                              co-ordinates to epoch 1980.0 */
+   Ec = kepler(M, eccent);   /* solve equation of Kepler */
+   Ec = sqrt((1 + eccent) / (1 - eccent)) * tan(Ec / 2);
+   Ec = 2 * todeg(atan(Ec));   /* true anomaly */
+   Lambdasun = fixangle(Ec + elongp);   /* Sun's geocentric ecliptic longitude */
+
+   /*  Calculation of the Moon's position. */
+   
+   /*  Moon's mean longitude. */
+   ml = fixangle(13.1763966 * Day + mmlong);
+   
+   /*  Moon's mean anomaly. */
+   MM = fixangle(ml - 0.1114041 * Day - mmlongp);
+   
+   /*  Moon's ascending node mean longitude. */
+   /*  Not used -- commented out. */
+   /* MN = fixangle(mlnode - 0.0529539 * Day); */
+   
+   /*  Evection. */
+   Ev = 1.2739 * sin(torad(2 * (ml - Lambdasun) - MM));
+   
+   /*  Annual equation. */
+   Ae = 0.1858 * sin(torad(M));
+   
+   /*  Correction term. */
+   A3 = 0.37 * sin(torad(M));
+   
+   /*  Corrected anomaly. */
+   MmP = MM + Ev - Ae - A3;
+   
+   /*  Correction for the equation of the centre. */
+   mEc = 6.2886 * sin(torad(MmP));
+   
+   /*  Another correction term. */
+   A4 = 0.214 * sin(torad(2 * MmP));
+   
+   /*  Corrected longitude. */
+   lP = ml + Ev + mEc - Ae + A4;
+   
+   /*  Variation. */
+   V = 0.6583 * sin(torad(2 * (lP - Lambdasun)));
+   
+   /*  True longitude. */
+   lPP = lP + V;
+   
+   /*  Calculation of the phase of the Moon. */
+   
+   /*  Distance of the Moon from the centre of the Earth: on the ellipse,
+       less the evection and variation in distance (the largest terms left,
+       cf. Meeus, "Astronomical Algorithms", table 47.A). */
+   if (pdist != NULL) {
+      *pdist = (msmax * (1 - mecc * mecc)) / (1 + mecc * cos(torad(MmP + mEc))) -
+         3699.1 * cos(torad(2 * (ml - Lambdasun) - MM)) - 2956.0 * cos(torad(2 * (ml - Lambdasun)));
+   }
+   
+   /*  Age of the Moon in degrees. */
+   return lPP - Lambdasun;
+}
+
+/* ---------------------------------------------------------------------------
+
+   moon_age
+
+   Notes:
+
+      This routine calculates the age of the moon in degrees at the Julian
+      date 'pdate', as above (it is the 'moontool' phase engine).
+
+*/
+double moon_age (double pdate)
+{
+   return moontool_age(pdate, NULL);
+}
+
+/* ---------------------------------------------------------------------------
+
+   moon_diameter
+
+   Notes:
+
+      This routine returns the apparent diameter of the moon (in degrees)
+      at the distance 'dist' (in km) from the centre of the Earth.
+
+*/
+double moon_diameter (double dist)
+{
+   return mangsiz * msmax / dist;
+}
+
+/* ---------------------------------------------------------------------------
+
+   fast_age
+
+   Notes:
+
+      This routine calculates the age of the moon in degrees, as for
+      'moon_age()', but in single precision.  Only the mean motions are
+      reduced in double precision, since they grow too large for it.
+
+      The Sun's true anomaly is obtained directly from the series for the
+      equation of the centre (to the 3rd power of the eccentricity, i.e.
+      within 1E-7 radians) rather than via Kepler's equation, which saves
+      several transcendental functions.
+
+*/
+static double fast_age (double pdate)
+{
+   double Day = pdate - epoch;
+   float M, ml, MM, Ec, Lambdasun, Ev, Ae, A3, MmP, mEc, A4, lP, V;
+   const float e = eccent;
+   const float rad = (float) (M_PI / 180.0), deg = (float) (180.0 / M_PI);
+
+   /*  Mean motions (reduced to 0 -> 360 in double precision). */
+   M = (float) fixangle((360 / 365.2422) * Day + elonge - elongp);
+   ml = (float) fixangle(13.1763966 * Day + mmlong);
+   MM = (float) fixangle(13.1763966 * Day + mmlong - 0.1114041 * Day - mmlongp);
+
+   /*  Sun's true anomaly and longitude. */
+   M *= rad;
+   Ec = M + (2 * e - e * e * e / 4) * sinf(M) + 1.25f * e * e * sinf(2 * M) +
+      (13.0f / 12.0f) * e * e * e * sinf(3 * M);
+   Lambdasun = Ec * deg + (float) elongp;
+
+   /*  Moon's position, as for moon_age(). */
+   Ev = 1.2739f * sinf(rad * (2 * (ml - Lambdasun) - MM));
+   Ae = 0.1858f * sinf(M);
+   A3 = 0.37f * sinf(M);
+   MmP = MM + Ev - Ae - A3;
+   mEc = 6.2886f * sinf(rad * MmP);
+   A4 = 0.214f * sinf(rad * 2 * MmP);
+   lP = ml + Ev + mEc - Ae + A4;
+   V = 0.6583f * sinf(rad * 2 * (lP - Lambdasun));
+
+   return (double) (lP + V - Lambdasun);
+}
+
+/* ---------------------------------------------------------------------------
+
+   engine_age
+
+   Notes:
+
+      This routine returns the age of the moon in degrees (not necessarily
+      normalized to 0 -> 360) at the Julian date 'jd', as calculated by the
+      active phase engine (cf. set_phase_engine()).
+
+*/
+double engine_age (double jd)
+{
+   return (*active_engine->age)(jd);
+}
+
+/* ---------------------------------------------------------------------------
+
+   calc_age
+
+   Notes:
+
+      This routine returns the age of the moon in degrees at the Julian date
+      'jd', from the active ephemeris if it covers 'jd' (cf.
+      use_ephemeris()), or else as calculated by the active phase engine.
+      The result is normalized to 0 -> 360 only in the former case.
+
+      If 'pdist' is not NULL, the moon's distance (in km) is stored into
+      '*pdist'.  It always comes from the moontool model -- in the same
+      evaluation as the age if that is the active engine.
+
+*/
+static double calc_age (double jd, double *pdist)
+{
+   double age;
+
+   if (active_eph == NULL || (age = eph_age(active_eph, jd)) < 0.0) {
+      if (pdist != NULL && active_engine->age == moon_age) return moontool_age(jd, pdist);
+      age = engine_age(jd);
+   }
+   if (pdist != NULL) (void) moontool_age(jd, pdist);
+   return age;
+}
+
+/* ---------------------------------------------------------------------------
+
+   grid_phase
+
+   Notes:
+
+      This routine interpolates the phase of the moon at Julian date 'jd'
+      from the grid 'pgrid' (cf. calc_phase_grid()), using a cubic through
+      the 4 nearest samples.  It returns -1 if 'jd' is not covered by the
+      grid.
+
+*/
+double grid_phase (phase_grid_str_typ *pgrid, double jd)
+{
+   double x, t, *a, age;
+   int i;
+
+   x = (jd - pgrid->jd0) / PHASE_GRID_STEP;
+   i = (int) floor(x);
+   if (i < 1 || i > pgrid->npoints - 3) return -1.0;
+
+   t = x - i;
+   a = pgrid->age + i;
+
+   /* Lagrange interpolation through samples i-1, i, i+1, i+2 */
+   age = (-a[-1] * t * (t - 1) * (t - 2) / 6 +
+          a[0] * (t + 1) * (t - 1) * (t - 2) / 2 -
+          a[1] * (t + 1) * t * (t - 2) / 2 +
+          a[2] * (t + 1) * t * (t - 1) / 6);
+
+   return fixangle(age) / 360.0;
+}
+
+/* ---------------------------------------------------------------------------
+
+   near_phase_boundary
+
+   Notes:
+
+      This routine returns TRUE if the interpolated phase 'phase' lies
+      within PHASE_GRID_GUARD of a multiple of PHASE_GRID_QUANTUM, i.e. of a
+      point where the phase as written to the calendar (to 3 decimals) rounds
+      the other way, or where 'lcal' compares it with a fixed value (e.g.
+      0.5), so that the error of the interpolation might make a difference.
+
+*/
+static int near_phase_boundary (double phase)
+{
+   double x = phase / PHASE_GRID_QUANTUM;
+
+   return fabs(x - floor(x + 0.5)) * PHASE_GRID_QUANTUM < PHASE_GRID_GUARD;
+}
+
+/* ---------------------------------------------------------------------------
+
+   calc_phase_dist
+
+   Notes:
+
+      This routine calculates the phase of moon as a fraction.
+
+      This utility routine was borrowed from 'pcal'.
+
+      The argument is the time for which the phase is requested, expressed as
+      the month, day, and year.  It returns the phase of the moon (0.0 ->
+      0.99) with the ordering as New Moon, First Quarter, Full Moon, and Last
+      Quarter.
+
+      If 'pdist' is not NULL, the moon's distance (in km) at the same
+      instant is stored into '*pdist' (cf. calc_age()).
+      
+*/
+double calc_phase_dist (int month, int inday, int year, double *pdist)
+{
+   double pdate, moon_phase;
+   
+   STATS_COUNT(calc_phase_count);
+
+   /* The original code used to normalize the UTC offset to +/- 12 hours.  But
+      it was bug-ridden and also failed to take into account that some parts
+      of the world have offsets from UTC greater than 12 hours!  Therefore,
+      beginning with v2.0.0, we don't attempt to normalize the user-specified
+      UTC timezone offset at all.
+
+      The offset is looked up for each day, since it changes with daylight
+      saving time when a zone name is used (cf. lcaltz.c).
+   */
+
+   /*  need to convert month, day, year into a Julian pdate */
+   pdate = (double) jdn(month, inday, year) + utc_offset_days(time_zone, month, inday, year);
+   
+   /* use the grid of precalculated moon ages if there is one (and the
+      phase it gives is not too close to call) */
+   if (active_grid == NULL || (moon_phase = grid_phase(active_grid, pdate)) < 0.0 ||
+       near_phase_boundary(moon_phase)) {
+      moon_phase = fixangle(calc_age(pdate, pdist)) / 360.0;
+   }
+   else if (pdist != NULL) (void) moontool_age(pdate, pdist);
+   if (moon_phase < 0.0) moon_phase += 1.0;
+
+   /* fprintf(stderr, "Moon phase on %04d-%02d-%02d: %.5lf\n", year, month, inday, moon_phase); */
+
+   return (moon_phase);
+}
+
+/* ---------------------------------------------------------------------------
+
+   calc_phase
+
+   Notes:
+
+      This routine calculates the phase of the moon as above, without the
+      distance.
+
+*/
+double calc_phase (int month, int inday, int year)
+{
+   return calc_phase_dist(month, inday, year, NULL);
+}
+
+/* ---------------------------------------------------------------------------
+
+   calc_moon_info
+
+   Notes:
+
+      This routine calculates the phase of the moon for an arbitrary instant,
+      expressed as a (fractional) Julian date, UT.  Unlike 'calc_phase()',
+      no time zone adjustment is applied.
+
+      It fills in the phase (0.0 -> 0.99, as for 'calc_phase()'), the
+      illuminated fraction of the disc (0.0 -> 1.0), the age of the moon
+      in days since the last new moon, and its distance and apparent
+      diameter.
+
+      Use 'UNIX_TO_JD()' (cf. lcaldefs.h) to convert a Unix time to a Julian
+      date.
+
+*/
+void calc_moon_info (double jd, moon_info_str_typ *pinfo)
+{
+   double age, dist;
+
+   age = fixangle(calc_age(jd, &dist));
+
+   pinfo->phase = age / 360.0;
+   pinfo->illum = (1 - dcos(age)) / 2;
+   pinfo->age = synmonth * pinfo->phase;
+   pinfo->dist = dist;
+   pinfo->diam = moon_diameter(dist);
+
+   return;
+}
+
+/* ---------------------------------------------------------------------------
+
+   calc_phase_grid
+
+   Notes:
+
+      This routine samples the moon's age every PHASE_GRID_STEP days over
+      'nmonths' months beginning with 'month'/'year', plus a margin of more
+      than a day at either end to allow for any UTC offset.
+
+      Once the grid is activated (cf. use_phase_grid()), calc_phase() merely
+      interpolates it, so that calendars for any number of time zones can be
+      generated for little more than the cost of calculating the grid.  With
+      samples every half day, the interpolated phase is within 1E-6 of that
+      calculated directly (cf. PHASE_GRID_GUARD), and calc_phase() recalculates
+      any phase too close to call (cf. near_phase_boundary()), so that the
+      calendars are exactly the same as without the grid.
+
+      It returns FALSE if there is not enough memory.
+
+*/
+int calc_phase_grid (phase_grid_str_typ *pgrid, int month, int year, int nmonths)
+{
+   double jd_last, age, prev = 0.0;
+   int i, last_month, last_year;
+
+   /* the grid runs from 2 days before the 1st of 'month' to 2 days after
+      the end of the last month */
+   last_month = (month - 1 + nmonths) % 12 + 1;
+   last_year = year + (month - 1 + nmonths) / 12;
+
+   pgrid->jd0 = (double) jdn(month, 1, year) - 2.0;
+   jd_last = (double) jdn(last_month, 1, last_year) + 2.0;
+   pgrid->npoints = (int) ceil((jd_last - pgrid->jd0) / PHASE_GRID_STEP) + 1;
+
+   if ((pgrid->age = (double *) malloc(pgrid->npoints * sizeof(double))) == NULL) {
+      return FALSE;
+   }
+
+   /* keep the age continuous (i.e. don't wrap at 360 degrees) so that it
+      can be interpolated */
+   for (i = 0; i < pgrid->npoints; i++) {
+      age = calc_age(pgrid->jd0 + i * PHASE_GRID_STEP, NULL);
+      if (i > 0) age = prev + fixangle(age - prev + 180.0) - 180.0;
+      pgrid->age[i] = prev = age;
+   }
+
+   return TRUE;
+}
+
+/* ---------------------------------------------------------------------------
+
+   use_phase_grid
+
+   Notes:
+
+      This routine makes calc_phase() interpolate the grid 'pgrid' (cf.
+      calc_phase_grid()) rather than calculate the phase directly.  A NULL
+      'pgrid' reverts to direct calculation.
+
+*/
+void use_phase_grid (phase_grid_str_typ *pgrid)
+{
+   active_grid = pgrid;
+   return;
+}
+
+/* ---------------------------------------------------------------------------
+
+   use_ephemeris
+
+   Notes:
+
+      This routine makes calc_phase(), calc_moon_info(), and calc_phase_grid()
+      evaluate the Chebyshev ephemeris 'peph' (cf. lcaleph.c) rather than
+      calculate the moon's age directly.  A NULL 'peph' reverts to direct
+      calculation.
+
+*/
+void use_ephemeris (ephemeris_str_typ *peph)
+{
+   active_eph = peph;
+   return;
+}
+
+/* ---------------------------------------------------------------------------
+
+   set_phase_engine
+
+   Notes:
+
+      This routine selects the phase engine 'name' (cf. PHASE_ENGINES) for
+      all subsequent calculations of the moon's age.
+
+      It returns FALSE if there is no such engine.
+
+*/
+int set_phase_engine (char *name)
+{
+   phase_engine_str_typ *pe;
+
+   for (pe = engines; pe->name; pe++) {
+      if (strcmp(pe->name, name) == 0) {
+         active_engine = pe;
+         return TRUE;
+      }
+   }
+   return FALSE;
+}
+
+/* ---------------------------------------------------------------------------
+
+   phase_engine_name
+
+   Notes:
+
+      This routine returns the name of the active phase engine.
+
+*/
+char * phase_engine_name (void)
+{
+   return active_engine->name;
+}